@@ -0,0 +1,156 @@
+/*
+ * Copyright (c) 2017 Mellanox Technologies. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the names of the copyright holders nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * Alternatively, this software may be distributed under the terms of the
+ * GNU General Public License ("GPL") version 2 as published by the Free
+ * Software Foundation.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include "bitstream.h"
+
+/*
+ * The bulk of a copy moves 64 bits per step: an unaligned little endian
+ * load from the source, one shift to line it up with the destination and
+ * an unaligned store. memcpy() of a constant 8 bytes compiles to a plain
+ * load/store on targets that allow unaligned access.
+ */
+
+static inline uint64_t load64(const unsigned char *p)
+{
+	uint64_t v;
+
+	memcpy(&v, p, sizeof(v));
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+	v = __builtin_bswap64(v);
+#endif
+	return v;
+}
+
+static inline void store64(unsigned char *p, uint64_t v)
+{
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+	v = __builtin_bswap64(v);
+#endif
+	memcpy(p, &v, sizeof(v));
+}
+
+/* read up to 8 bits at bit position pos, only touching bytes in range */
+static inline unsigned int get_bits8(const unsigned char *src,
+				     unsigned long pos, unsigned int bits)
+{
+	unsigned int shift = pos % 8;
+	unsigned int v;
+
+	src += pos / 8;
+	v = src[0] >> shift;
+	if (shift + bits > 8)
+		v |= src[1] << (8 - shift);
+	return v & ((1u << bits) - 1);
+}
+
+/* write bits (<= 8) bits within the byte holding bit position pos */
+static inline void put_bits8(unsigned char *dst, unsigned long pos,
+			     unsigned int v, unsigned int bits)
+{
+	unsigned int shift = pos % 8;
+	unsigned int mask = ((1u << bits) - 1) << shift;
+
+	dst += pos / 8;
+	*dst = (*dst & ~mask) | ((v << shift) & mask);
+}
+
+void bitstream_copy(void *dst, unsigned long dst_pos,
+		    const void *src, unsigned long src_pos,
+		    unsigned long bits)
+{
+	unsigned char *d = dst;
+	const unsigned char *s = src;
+	unsigned int shift;
+	unsigned int n;
+	uint64_t w;
+
+	/* bring the destination to a byte boundary */
+	if (bits && (dst_pos % 8)) {
+		n = 8 - dst_pos % 8;
+		if (n > bits)
+			n = bits;
+		put_bits8(d, dst_pos, get_bits8(s, src_pos, n), n);
+		dst_pos += n;
+		src_pos += n;
+		bits -= n;
+	}
+
+	d += dst_pos / 8;
+	s += src_pos / 8;
+	shift = src_pos % 8;
+
+	if (shift == 0) {
+		/* both streams byte aligned: whole bytes are a plain copy */
+		memcpy(d, s, bits / 8);
+		d += bits / 8;
+		s += bits / 8;
+	} else {
+		/*
+		 * 64 source bits at bit offset shift span 9 bytes. The ninth
+		 * byte is in range as long as 64 or more bits are left.
+		 */
+		for (; bits >= 64; bits -= 64, d += 8, s += 8) {
+			w = load64(s) >> shift;
+			w |= (uint64_t)s[8] << (64 - shift);
+			store64(d, w);
+		}
+		for (; bits >= 8; bits -= 8, d++, s++)
+			*d = (s[0] >> shift) | (s[1] << (8 - shift));
+	}
+
+	if (bits % 8)
+		put_bits8(d, 0, get_bits8(s, shift, bits % 8), bits % 8);
+}
+
+void bitstream_fill(void *dst, unsigned long dst_pos, unsigned long bits,
+		    int value)
+{
+	unsigned char *d = dst;
+	unsigned int v = value ? 0xff : 0;
+	unsigned int n;
+
+	if (bits && (dst_pos % 8)) {
+		n = 8 - dst_pos % 8;
+		if (n > bits)
+			n = bits;
+		put_bits8(d, dst_pos, v, n);
+		dst_pos += n;
+		bits -= n;
+	}
+
+	d += dst_pos / 8;
+	memset(d, v, bits / 8);
+	if (bits % 8)
+		put_bits8(d + bits / 8, 0, v, bits % 8);
+}
@@ -0,0 +1,115 @@
+/*
+ * Copyright (c) 2017 Mellanox Technologies. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the names of the copyright holders nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * Alternatively, this software may be distributed under the terms of the
+ * GNU General Public License ("GPL") version 2 as published by the Free
+ * Software Foundation.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include "jtag_backend.h"
+#include "jtag_wait.h"
+
+/*
+ * The Aspeed JTAG driver. Every op is one ioctl on the device, the driver
+ * shifts in software mode and waits are slept on the host.
+ */
+static int g_aspeed_fd = -1;
+
+static int aspeed_open(const char *path)
+{
+	g_aspeed_fd = open(path, O_RDWR);
+	return g_aspeed_fd < 0 ? -1 : 0;
+}
+
+static void aspeed_close(void)
+{
+	close(g_aspeed_fd);
+	g_aspeed_fd = -1;
+}
+
+static int aspeed_set_freq(unsigned int hz)
+{
+	return ioctl(g_aspeed_fd, JTAG_SIOCFREQ, &hz) ? -1 : 0;
+}
+
+static int aspeed_get_freq(unsigned int *hz)
+{
+	return ioctl(g_aspeed_fd, JTAG_GIOCFREQ, hz) ? -1 : 0;
+}
+
+static int aspeed_shift(struct jtag_xfer *xfer)
+{
+	xfer->mode = JTAG_XFER_SW_MODE;
+	return ioctl(g_aspeed_fd, JTAG_IOCXFER, xfer) ? -1 : 0;
+}
+
+static int aspeed_runtest(int reset, int endstate, unsigned int tck)
+{
+	struct jtag_run_test_idle runtest;
+
+	memset(&runtest, 0, sizeof(runtest));
+	runtest.mode = JTAG_XFER_SW_MODE;
+	runtest.reset = reset;
+	runtest.endstate = endstate;
+	runtest.tck = tck;
+	return ioctl(g_aspeed_fd, JTAG_IOCRUNTEST, &runtest) ? -1 : 0;
+}
+
+static int aspeed_run_test(int endstate, unsigned int tck)
+{
+	return aspeed_runtest(0, endstate, tck);
+}
+
+static int aspeed_reset(int endstate)
+{
+	return aspeed_runtest(1, endstate, 0);
+}
+
+static int aspeed_wait(unsigned long usec)
+{
+	jtag_wait_us(usec);
+	return 0;
+}
+
+const jtag_backend_t jtag_backend_aspeed = {
+	.name		= "aspeed",
+	.caps		= JTAG_BACKEND_CAP_FREQ,
+	.open		= aspeed_open,
+	.close		= aspeed_close,
+	.set_freq	= aspeed_set_freq,
+	.get_freq	= aspeed_get_freq,
+	.shift_ir	= aspeed_shift,
+	.shift_dr	= aspeed_shift,
+	.run_test	= aspeed_run_test,
+	.wait		= aspeed_wait,
+	.reset		= aspeed_reset,
+};
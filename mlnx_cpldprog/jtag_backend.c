@@ -0,0 +1,367 @@
+/*
+ * Copyright (c) 2017 Mellanox Technologies. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the names of the copyright holders nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * Alternatively, this software may be distributed under the terms of the
+ * GNU General Public License ("GPL") version 2 as published by the Free
+ * Software Foundation.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include "jtag_backend.h"
+
+/* -prog sim[:<devices>] selects the simulated chain */
+#define JTAG_BACKEND_SIM_PREFIX	"sim"
+
+/* TDI copies in the batch arena are aligned to this */
+#define JTAG_BACKEND_BATCH_ALIGN	8
+
+static const jtag_backend_t *g_backend = &jtag_backend_aspeed;
+static int g_backend_open;
+
+/* ops queued with -batch and the TDI of the queued scans */
+static struct {
+	jtag_backend_op_t *ops;
+	unsigned int max;		/* 0 without -batch */
+	unsigned int ignored;		/* -batch of a backend without batches */
+	unsigned int count;
+	char *arena;
+	unsigned long used;
+
+	/* printed with -d */
+	unsigned long batches;
+	unsigned long long batched;	/* ops submitted in batches */
+	unsigned long long syscalls;	/* backend calls that took them */
+	unsigned long long batch_ns;	/* host time of the batches */
+	unsigned long long direct;	/* ops not queued */
+	unsigned long long direct_ns;
+	unsigned long flush_read;	/* before a scan that reads TDO */
+	unsigned long flush_full;
+	unsigned long flush_other;
+} g_batch;
+
+static unsigned long long jtag_backend_now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int jtag_backend_op(jtag_backend_op_t *op)
+{
+	switch (op->op) {
+	case JTAG_BACKEND_OP_XFER:
+		if (op->xfer.type == JTAG_SIR_XFER)
+			return g_backend->shift_ir(&op->xfer);
+		return g_backend->shift_dr(&op->xfer);
+	case JTAG_BACKEND_OP_RUNTEST:
+		return g_backend->run_test(op->endstate, op->tck);
+	case JTAG_BACKEND_OP_WAIT:
+		return g_backend->wait(op->usec);
+	default:
+		return -1;
+	}
+}
+
+/*
+ * Run count ops in order, in one call when the backend takes batches and
+ * one by one from the prepared ops otherwise. Stops at the first op that
+ * fails. Returns the number of backend calls in *calls.
+ */
+static int jtag_backend_submit(jtag_backend_op_t *ops, unsigned int count,
+			       unsigned long long *calls)
+{
+	unsigned int i;
+	int rc = 0;
+
+	if (g_backend->batch_submit) {
+		*calls += 1;
+		return g_backend->batch_submit(ops, count);
+	}
+
+	for (i = 0; i < count && !rc; i++)
+		rc = jtag_backend_op(&ops[i]);
+	*calls += i;
+	return rc;
+}
+
+/* Submit the queued ops, reason counts why. */
+static int jtag_backend_flush_queue(unsigned long *reason)
+{
+	unsigned long long start;
+	int rc;
+
+	if (!g_batch.count)
+		return 0;
+
+	start = jtag_backend_now_ns();
+	rc = jtag_backend_submit(g_batch.ops, g_batch.count, &g_batch.syscalls);
+	g_batch.batch_ns += jtag_backend_now_ns() - start;
+	g_batch.batched += g_batch.count;
+	g_batch.batches++;
+	(*reason)++;
+	g_batch.count = 0;
+	g_batch.used = 0;
+	return rc ? -1 : 0;
+}
+
+int jtag_backend_flush(void)
+{
+	return jtag_backend_flush_queue(&g_batch.flush_other);
+}
+
+/*
+ * The next free op of the queue with room for size bytes of TDI, after
+ * submitting the queue if it is full. NULL if the queue failed.
+ */
+static jtag_backend_op_t *jtag_backend_queue(unsigned long size)
+{
+	if ((g_batch.count == g_batch.max ||
+	     g_batch.used + size > JTAG_BACKEND_BATCH_BYTES) &&
+	    jtag_backend_flush_queue(&g_batch.flush_full))
+		return NULL;
+	return &g_batch.ops[g_batch.count++];
+}
+
+/* An op that is not queued, timed for the estimate of the time batches save. */
+static int jtag_backend_direct(jtag_backend_op_t *op)
+{
+	unsigned long long start;
+	int rc;
+
+	if (!g_batch.max)
+		return jtag_backend_op(op);
+
+	start = jtag_backend_now_ns();
+	rc = jtag_backend_op(op);
+	g_batch.direct_ns += jtag_backend_now_ns() - start;
+	g_batch.direct++;
+	return rc;
+}
+
+/*
+ * Queue up to ops ops with -batch, 0 submits every op on its own. The
+ * queue is flushed first. A backend without JTAG_BACKEND_CAP_BATCH would
+ * only get the queued ops one by one after the copies, so nothing is
+ * queued for it.
+ */
+int jtag_backend_set_batch(unsigned int ops)
+{
+	int rc = jtag_backend_flush();
+
+	free(g_batch.ops);
+	free(g_batch.arena);
+	g_batch.ops = NULL;
+	g_batch.arena = NULL;
+	g_batch.max = 0;
+	g_batch.ignored = 0;
+	if (!ops)
+		return rc;
+	if (!(g_backend->caps & JTAG_BACKEND_CAP_BATCH)) {
+		g_batch.ignored = ops;
+		return rc;
+	}
+
+	g_batch.ops = calloc(ops, sizeof(*g_batch.ops));
+	g_batch.arena = malloc(JTAG_BACKEND_BATCH_BYTES);
+	if (!g_batch.ops || !g_batch.arena) {
+		free(g_batch.ops);
+		free(g_batch.arena);
+		g_batch.ops = NULL;
+		g_batch.arena = NULL;
+		return -1;
+	}
+	g_batch.max = ops;
+	return rc;
+}
+
+/*
+ * Open the backend -prog names: "sim", optionally followed by ":" and the
+ * devices of the chain, or the path of the JTAG device of the driver.
+ */
+int jtag_backend_open(const char *path)
+{
+	size_t len = strlen(JTAG_BACKEND_SIM_PREFIX);
+
+	if (!strncmp(path, JTAG_BACKEND_SIM_PREFIX, len) &&
+	    (path[len] == '\0' || path[len] == ':')) {
+		g_backend = &jtag_backend_sim;
+		path += path[len] ? len + 1 : len;
+	} else {
+		g_backend = &jtag_backend_aspeed;
+	}
+
+	if (g_backend->open(path))
+		return -1;
+	g_backend_open = 1;
+	return 0;
+}
+
+int jtag_backend_active(void)
+{
+	return g_backend_open;
+}
+
+void jtag_backend_close(void)
+{
+	if (!g_backend_open)
+		return;
+	jtag_backend_set_batch(0);
+	g_backend->close();
+	g_backend = &jtag_backend_aspeed;
+	g_backend_open = 0;
+}
+
+unsigned int jtag_backend_caps(void)
+{
+	return g_backend->caps;
+}
+
+int jtag_backend_set_freq(unsigned int hz)
+{
+	if (jtag_backend_flush())
+		return -1;
+	return g_backend->set_freq(hz);
+}
+
+int jtag_backend_get_freq(unsigned int *hz)
+{
+	if (jtag_backend_flush())
+		return -1;
+	return g_backend->get_freq(hz);
+}
+
+/*
+ * A write only scan is queued with a copy of its TDI, a scan that reads
+ * TDO submits the queue and is shifted on its own, the caller checks the
+ * TDO right after.
+ */
+int jtag_backend_xfer(struct jtag_xfer *xfer)
+{
+	unsigned long size = (xfer->length + 7) / 8;
+	unsigned long room = (size + JTAG_BACKEND_BATCH_ALIGN - 1) & ~(JTAG_BACKEND_BATCH_ALIGN - 1UL);
+	jtag_backend_op_t *op;
+	jtag_backend_op_t direct;
+
+	if (g_batch.max && xfer->direction == JTAG_WRITE_XFER && room <= JTAG_BACKEND_BATCH_BYTES) {
+		op = jtag_backend_queue(room);
+		if (!op)
+			return -1;
+		op->op = JTAG_BACKEND_OP_XFER;
+		op->xfer = *xfer;
+		memcpy(g_batch.arena + g_batch.used, (void *)(uintptr_t)xfer->tdio, size);
+		op->xfer.tdio = (__u64)(uintptr_t)(g_batch.arena + g_batch.used);
+		g_batch.used += room;
+		return 0;
+	}
+
+	if (jtag_backend_flush_queue(xfer->direction == JTAG_READ_XFER ?
+				     &g_batch.flush_read : &g_batch.flush_other))
+		return -1;
+	direct.op = JTAG_BACKEND_OP_XFER;
+	direct.xfer = *xfer;
+	if (jtag_backend_direct(&direct))
+		return -1;
+	*xfer = direct.xfer;
+	return 0;
+}
+
+int jtag_backend_run_test(int endstate, unsigned int tck)
+{
+	jtag_backend_op_t direct;
+	jtag_backend_op_t *op = &direct;
+
+	if (g_batch.max) {
+		op = jtag_backend_queue(0);
+		if (!op)
+			return -1;
+	}
+	op->op = JTAG_BACKEND_OP_RUNTEST;
+	op->endstate = endstate;
+	op->tck = tck;
+	return op == &direct ? jtag_backend_direct(op) : 0;
+}
+
+/* A wait in the queue runs after the ops queued before it. */
+int jtag_backend_wait(unsigned long usec)
+{
+	jtag_backend_op_t direct;
+	jtag_backend_op_t *op = &direct;
+
+	if (!usec)
+		return 0;
+	if (g_batch.max) {
+		op = jtag_backend_queue(0);
+		if (!op)
+			return -1;
+	}
+	op->op = JTAG_BACKEND_OP_WAIT;
+	op->usec = usec;
+	return op == &direct ? jtag_backend_direct(op) : 0;
+}
+
+int jtag_backend_reset(int endstate)
+{
+	if (jtag_backend_flush())
+		return -1;
+	return g_backend->reset(endstate);
+}
+
+/* Run count ops in order after the queue, stops at the first that fails. */
+int jtag_backend_batch(jtag_backend_op_t *ops, unsigned int count)
+{
+	unsigned long long calls = 0;
+
+	if (jtag_backend_flush())
+		return -1;
+	return jtag_backend_submit(ops, count, &calls);
+}
+
+void jtag_backend_print_stats(void)
+{
+	double direct_us = g_batch.direct ? g_batch.direct_ns / 1e3 / g_batch.direct : 0;
+
+	if (g_batch.ignored)
+		printf("Batches: none, the %s backend has no batch submission, -batch %u has no effect\n",
+				g_backend->name, g_batch.ignored);
+	if (g_batch.max) {
+		printf("Batches: %lu of %llu ops, %.1f ops per backend call, ops not batched: %llu\n",
+				g_batch.batches, g_batch.batched,
+				g_batch.syscalls ? (double)g_batch.batched / g_batch.syscalls : 0,
+				g_batch.direct);
+		printf("  flushed for TDO: %lu, full: %lu, other: %lu, backend calls saved %llu, ~%.3f s\n",
+				g_batch.flush_read, g_batch.flush_full, g_batch.flush_other,
+				g_batch.batched - g_batch.syscalls,
+				(g_batch.batched - g_batch.syscalls) * direct_us / 1e6);
+	}
+	if (g_backend->print_stats)
+		g_backend->print_stats();
+}
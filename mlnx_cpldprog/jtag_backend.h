@@ -0,0 +1,114 @@
+/*
+ * Copyright (c) 2017 Mellanox Technologies. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the names of the copyright holders nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * Alternatively, this software may be distributed under the terms of the
+ * GNU General Public License ("GPL") version 2 as published by the Free
+ * Software Foundation.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __JTAG_BACKEND_H__
+#define __JTAG_BACKEND_H__
+
+#include <uapi/linux/jtag.h>
+
+/*
+ * Transport of direct programming. Every access to the JTAG hardware goes
+ * through the selected backend: the Aspeed JTAG driver, or a simulated
+ * chain in the process for benchmarks and regression runs without a BMC.
+ * Scans are described with the struct jtag_xfer of the driver, endstates
+ * are its enum jtag_endstate.
+ */
+
+/* capabilities */
+#define JTAG_BACKEND_CAP_FREQ	0x01	/* the TCK frequency can be set */
+#define JTAG_BACKEND_CAP_BATCH	0x02	/* batch_submit() runs several ops in one call */
+#define JTAG_BACKEND_CAP_SIM	0x04	/* waits are simulated, not slept */
+
+/* batch_submit() ops */
+#define JTAG_BACKEND_OP_XFER	0
+#define JTAG_BACKEND_OP_RUNTEST	1
+#define JTAG_BACKEND_OP_WAIT	2
+
+typedef struct {
+	int op;
+	struct jtag_xfer xfer;	/* JTAG_BACKEND_OP_XFER */
+	int endstate;		/* JTAG_BACKEND_OP_RUNTEST */
+	unsigned int tck;
+	unsigned long usec;	/* JTAG_BACKEND_OP_WAIT */
+} jtag_backend_op_t;
+
+/*
+ * All ops return 0 or -1. run_test() moves the TAP to endstate and clocks
+ * tck TCKs there, reset() goes through Test-Logic-Reset to endstate.
+ * batch_submit() and print_stats() may be NULL.
+ */
+typedef struct {
+	const char *name;
+	unsigned int caps;
+	int (*open)(const char *path);
+	void (*close)(void);
+	int (*set_freq)(unsigned int hz);
+	int (*get_freq)(unsigned int *hz);
+	int (*shift_ir)(struct jtag_xfer *xfer);
+	int (*shift_dr)(struct jtag_xfer *xfer);
+	int (*run_test)(int endstate, unsigned int tck);
+	int (*wait)(unsigned long usec);
+	int (*reset)(int endstate);
+	int (*batch_submit)(jtag_backend_op_t *ops, unsigned int count);
+	void (*print_stats)(void);
+} jtag_backend_t;
+
+/*
+ * -batch <ops>: up to that many scans, RUNTESTs and waits that the host
+ * does not wait on are queued and submitted together with batch_submit().
+ * Backends without JTAG_BACKEND_CAP_BATCH ignore it. The TDI of queued scans is copied to an arena
+ * of JTAG_BACKEND_BATCH_BYTES. The queue is flushed before a scan whose
+ * TDO is read, before any other op and when it is full. An op of the queue
+ * that fails is reported by the op that flushes it.
+ */
+#define JTAG_BACKEND_BATCH_MAX_OPS	4096
+#define JTAG_BACKEND_BATCH_BYTES	(64 * 1024)
+
+extern const jtag_backend_t jtag_backend_aspeed;
+extern const jtag_backend_t jtag_backend_sim;
+
+int jtag_backend_open(const char *path);
+int jtag_backend_active(void);
+void jtag_backend_close(void);
+unsigned int jtag_backend_caps(void);
+int jtag_backend_set_freq(unsigned int hz);
+int jtag_backend_get_freq(unsigned int *hz);
+int jtag_backend_xfer(struct jtag_xfer *xfer);
+int jtag_backend_run_test(int endstate, unsigned int tck);
+int jtag_backend_wait(unsigned long usec);
+int jtag_backend_reset(int endstate);
+int jtag_backend_batch(jtag_backend_op_t *ops, unsigned int count);
+int jtag_backend_set_batch(unsigned int ops);
+int jtag_backend_flush(void);
+void jtag_backend_print_stats(void);
+
+#endif /*__JTAG_BACKEND_H__*/
@@ -0,0 +1,1034 @@
+/*
+ * Copyright (c) 2017 Mellanox Technologies. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the names of the copyright holders nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * Alternatively, this software may be distributed under the terms of the
+ * GNU General Public License ("GPL") version 2 as published by the Free
+ * Software Foundation.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Microbenchmarks for the direct programming back end. They are built with
+ * "make bench" and are not part of mlnx_cpldprog:
+ *	./jtag_bench [passes]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <sys/ioctl.h>
+#include <uapi/linux/jtag.h>
+#include "utilities.h"
+#include "vmopcode.h"
+#include "bitstream.h"
+#include "jtag_verify.h"
+#include "jtag_handlers.h"
+#include "jtag_tap.h"
+#include "jtag_backend.h"
+#include "jtag_sim.h"
+#include "jtag_poll.h"
+#include "jtag_wait.h"
+
+#define BENCH_DEF_PASSES	20
+#define BENCH_CHECK_ROUNDS	200000
+#define BENCH_CHECK_MAX_BITS	700
+#define BENCH_SIM_ROWS		16
+
+/* keeps the compiler from dropping results that are otherwise unused */
+static volatile int bench_sink;
+
+/* what the player links against in mlnx_cpldprog */
+int g_iSVFLineIndex;
+
+void print_progress(unsigned long pos, unsigned long total)
+{
+}
+
+/*
+ * Simulated JTAG driver: every device of the chain is in BYPASS with a
+ * zero length register, so TDO returns what was shifted in on TDI. Like
+ * the real driver it copies the data in and back out of its own buffer.
+ */
+static struct {
+	char *data;
+	unsigned long size;
+	unsigned long xfers;
+	unsigned long long bits;
+} sim;
+
+int ioctl(int fd, unsigned long request, ...)
+{
+	struct jtag_xfer *xfer;
+	unsigned long size;
+	va_list ap;
+	char *tdio;
+
+	va_start(ap, request);
+	xfer = va_arg(ap, struct jtag_xfer *);
+	va_end(ap);
+
+	if (request != JTAG_IOCXFER)
+		return 0;
+
+	size = (xfer->length + 7) / 8;
+	if (size > sim.size) {
+		free(sim.data);
+		sim.data = malloc(size);
+		sim.size = sim.data ? size : 0;
+		if (!sim.data)
+			return -1;
+	}
+	tdio = (char *)(uintptr_t)xfer->tdio;
+	memcpy(sim.data, tdio, size);
+	memcpy(tdio, sim.data, size);
+	sim.xfers++;
+	sim.bits += xfer->length;
+	return 0;
+}
+
+static double bench_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/*
+ * Bit by bit splicing as it was done in jtag_handlers.c before
+ * bitstream_copy(): one branch and a read-modify-write of a byte per bit.
+ */
+static void legacy_put_bitbuffer(char *buf, unsigned int *buf_pos,
+				 const char *data, unsigned int bit_size)
+{
+	unsigned char data_bit_offset = 0;
+	unsigned int byte_offset;
+	unsigned char bit_offset;
+	unsigned int bit_pos;
+
+	byte_offset = *buf_pos / 8;
+	bit_offset = *buf_pos % 8;
+	for (bit_pos = 0; bit_pos < bit_size; bit_pos++) {
+		buf[byte_offset] &= ~(1 << bit_offset);
+		buf[byte_offset] |= *data & (1 << data_bit_offset) ? (1 << bit_offset) : 0;
+		bit_offset++;
+		if (bit_offset == 8) {
+			bit_offset = 0;
+			byte_offset++;
+		}
+
+		data_bit_offset++;
+		if (data_bit_offset == 8) {
+			data_bit_offset = 0;
+			data++;
+		}
+		(*buf_pos)++;
+	}
+}
+
+static void legacy_extract_bitbuffer(char *in_buf, int inbuf_len,
+				     int head_len, char *data, int data_len,
+				     int tail_len)
+{
+	unsigned int bit_pos = head_len;
+	unsigned int bit_offset = head_len % 8;
+	unsigned char data_bit_offset = 0;
+
+	(void)data_len;
+	in_buf += head_len / 8;
+	while (bit_pos < (unsigned int)(inbuf_len - tail_len)) {
+		*data &= ~(1 << data_bit_offset);
+		*data |= *in_buf & (1 << bit_offset) ? (1 << data_bit_offset) : 0;
+		data_bit_offset++;
+		if (data_bit_offset == 8) {
+			data_bit_offset = 0;
+			data++;
+		}
+		bit_offset++;
+		if (bit_offset == 8) {
+			bit_offset = 0;
+			in_buf++;
+		}
+		bit_pos++;
+	}
+}
+
+static void fill_random(char *buf, unsigned int size)
+{
+	unsigned int i;
+
+	for (i = 0; i < size; i++)
+		buf[i] = rand();
+}
+
+/*
+ * Splice random header/data/trailer streams into a shift buffer and back
+ * out with both implementations. The buffers are exactly as large as the
+ * streams, so reads past the end show up under valgrind or ASan.
+ */
+static int check_bitstream(void)
+{
+	unsigned int head, data, tail, total, pos_a, pos_b, i;
+	char *h, *d, *t, *a, *b, *xa, *xb;
+	int rc = OK;
+
+	srand(1);
+	for (i = 0; i < BENCH_CHECK_ROUNDS && rc == OK; i++) {
+		head = rand() % 70;
+		data = rand() % BENCH_CHECK_MAX_BITS + 1;
+		tail = rand() % 70;
+		total = head + data + tail;
+
+		h = malloc(head / 8 + 1);
+		d = malloc((data + 7) / 8);
+		t = malloc(tail / 8 + 1);
+		a = malloc((total + 7) / 8);
+		b = malloc((total + 7) / 8);
+		xa = malloc((data + 7) / 8);
+		xb = malloc((data + 7) / 8);
+		if (!h || !d || !t || !a || !b || !xa || !xb) {
+			rc = OUT_OF_MEMORY;
+			goto next;
+		}
+		fill_random(h, head / 8 + 1);
+		fill_random(d, (data + 7) / 8);
+		fill_random(t, tail / 8 + 1);
+		/* bits outside of the written ranges must survive */
+		fill_random(a, (total + 7) / 8);
+		memcpy(b, a, (total + 7) / 8);
+		fill_random(xa, (data + 7) / 8);
+		memcpy(xb, xa, (data + 7) / 8);
+
+		pos_a = 0;
+		legacy_put_bitbuffer(a, &pos_a, h, head);
+		legacy_put_bitbuffer(a, &pos_a, d, data);
+		legacy_put_bitbuffer(a, &pos_a, t, tail);
+		pos_b = 0;
+		bitstream_copy(b, pos_b, h, 0, head);
+		pos_b += head;
+		bitstream_copy(b, pos_b, d, 0, data);
+		pos_b += data;
+		bitstream_copy(b, pos_b, t, 0, tail);
+		pos_b += tail;
+
+		legacy_extract_bitbuffer(a, total, head, xa, data, tail);
+		bitstream_copy(xb, 0, b, head, data);
+
+		if (pos_a != pos_b || memcmp(a, b, (total + 7) / 8) ||
+		    memcmp(xa, xb, (data + 7) / 8)) {
+			fprintf(stderr, "bitstream: mismatch, head %u data %u tail %u\n",
+				head, data, tail);
+			rc = FILE_ERROR;
+		}
+
+		/* bitstream_fill() against the bit loop it replaces */
+		memcpy(b, a, (total + 7) / 8);
+		for (pos_a = head; pos_a < head + data; pos_a++)
+			a[pos_a / 8] |= 1 << (pos_a % 8);
+		bitstream_fill(b, head, data, 1);
+		if (memcmp(a, b, (total + 7) / 8)) {
+			fprintf(stderr, "bitstream: fill mismatch, pos %u bits %u\n",
+				head, data);
+			rc = FILE_ERROR;
+		}
+next:
+		free(h);
+		free(d);
+		free(t);
+		free(a);
+		free(b);
+		free(xa);
+		free(xb);
+	}
+
+	if (rc == OK)
+		printf("bitstream: %d random splices match the bit loop\n",
+		       BENCH_CHECK_ROUNDS);
+	return rc;
+}
+
+/*
+ * Time merge + extract of one SDR row as the player does it, once with a
+ * one bit header (single BYPASS device ahead, unaligned) and once without.
+ */
+static int bench_bitstream(unsigned int bits, unsigned int head, int passes)
+{
+	unsigned int total = head + bits + 1;
+	double start, legacy, words;
+	char *data, *buf, *out;
+	unsigned int pos;
+	char bypass = 0;
+	int pass;
+
+	data = malloc((bits + 7) / 8);
+	buf = malloc((total + 7) / 8);
+	out = malloc((bits + 7) / 8);
+	if (!data || !buf || !out) {
+		free(data);
+		free(buf);
+		free(out);
+		return OUT_OF_MEMORY;
+	}
+	fill_random(data, (bits + 7) / 8);
+
+	start = bench_now();
+	for (pass = 0; pass < passes; pass++) {
+		pos = 0;
+		legacy_put_bitbuffer(buf, &pos, &bypass, head);
+		legacy_put_bitbuffer(buf, &pos, data, bits);
+		legacy_put_bitbuffer(buf, &pos, &bypass, 1);
+		legacy_extract_bitbuffer(buf, total, head, out, bits, 1);
+		bench_sink += out[0];
+	}
+	legacy = bench_now() - start;
+
+	start = bench_now();
+	for (pass = 0; pass < passes; pass++) {
+		bitstream_copy(buf, 0, &bypass, 0, head);
+		bitstream_copy(buf, head, data, 0, bits);
+		bitstream_copy(buf, head + bits, &bypass, 0, 1);
+		bitstream_copy(out, 0, buf, head, bits);
+		bench_sink += out[0];
+	}
+	words = bench_now() - start;
+
+	printf("merge+extract: %u bits, header %u, %d passes\n", bits, head, passes);
+	printf("  bit loop:       %10.3f s %12.0f Mbit/s\n",
+	       legacy, bits * (double)passes / legacy / 1e6);
+	printf("  bitstream:      %10.3f s %12.0f Mbit/s (x%.1f)\n",
+	       words, bits * (double)passes / words / 1e6, legacy / words);
+
+	free(data);
+	free(buf);
+	free(out);
+	return OK;
+}
+
+/*
+ * TDO check as it was done before jtag_verify(): TDO and MASK are loaded
+ * 32 bits at a time through a long and every bit is tested on its own.
+ */
+static int legacy_char2int(const char **data_p, int bit_size)
+{
+	long int data_o;
+	int size;
+
+	if (bit_size > 32)
+		return 0;
+
+	size = (bit_size + 7) / 8;
+	memcpy(&data_o, *data_p, size);
+	(*data_p) += size;
+	return data_o;
+}
+
+static int legacy_check_tdo(const char *tdo_real, const char *tdo_p,
+			    const char *mask_p, int bit_size)
+{
+	const int *tdo_data = (const int *)tdo_real;
+	int bit_remaining, bit_pos = 0;
+	int TDO_expected, MASK_data;
+	char CurBit;
+	int ret = 0;
+	int i;
+
+	while (bit_pos < bit_size) {
+		bit_remaining = bit_size - bit_pos;
+		if (bit_remaining > 32) {
+			bit_remaining = 32;
+			bit_pos += 32;
+		} else {
+			bit_pos += bit_remaining;
+		}
+
+		MASK_data = 0xffffffff;
+		if (mask_p)
+			MASK_data = legacy_char2int(&mask_p, bit_remaining);
+		TDO_expected = legacy_char2int(&tdo_p, bit_remaining);
+
+		for (i = 0; i < bit_remaining; i++) {
+			CurBit = *tdo_data & (1 << i) ? 1 : 0;
+			if (MASK_data & (1 << i)) {
+				if (CurBit != (TDO_expected & (1 << i) ? 1 : 0))
+					ret = -1;
+			}
+		}
+		tdo_data++;
+	}
+	return ret;
+}
+
+/* first checked bit that differs, one bit at a time */
+static long reference_verify(const char *a, const char *e, const char *m,
+			     unsigned long bits)
+{
+	unsigned long i;
+
+	for (i = 0; i < bits; i++) {
+		if (m && !(m[i / 8] & (1 << (i % 8))))
+			continue;
+		if ((a[i / 8] ^ e[i / 8]) & (1 << (i % 8)))
+			return i;
+	}
+	return -1;
+}
+
+/*
+ * Compare jtag_verify() with the bit loop on random scans, with and without
+ * MASK, matching or with a single flipped bit. Buffers are exactly as long
+ * as the scan so an overread shows up under ASan.
+ */
+static int check_verify(void)
+{
+	unsigned long bits, bytes, flip;
+	char *a, *e, *m;
+	long got, want;
+	int rc = OK;
+	int i;
+
+	srand(2);
+	for (i = 0; i < BENCH_CHECK_ROUNDS && rc == OK; i++) {
+		bits = rand() % 2048 + 1;
+		bytes = (bits + 7) / 8;
+		a = malloc(bytes);
+		e = malloc(bytes);
+		m = malloc(bytes);
+		if (!a || !e || !m) {
+			rc = OUT_OF_MEMORY;
+			goto next;
+		}
+		fill_random(e, bytes);
+		memcpy(a, e, bytes);
+		fill_random(m, bytes);
+		if (i % 4) {
+			flip = rand() % bits;
+			a[flip / 8] ^= 1 << (flip % 8);
+		}
+		/* bits past the end of the scan are never checked */
+		if (bits % 8)
+			a[bytes - 1] ^= 0xff << (bits % 8);
+
+		want = reference_verify(a, e, (i % 3) ? m : NULL, bits);
+		got = jtag_verify(a, e, (i % 3) ? m : NULL, bits);
+		if (got != want) {
+			fprintf(stderr, "verify: %lu bits, got bit %ld instead of %ld\n",
+				bits, got, want);
+			rc = FILE_ERROR;
+		}
+next:
+		free(a);
+		free(e);
+		free(m);
+	}
+
+	if (rc == OK)
+		printf("verify: %d random scans match the bit loop\n",
+		       BENCH_CHECK_ROUNDS);
+	return rc;
+}
+
+/*
+ * Masks with no, all or a few bits set: jtag_verify_span() has to find
+ * the same class and range of checked bits as a loop over the bits.
+ */
+static int check_verify_span(void)
+{
+	unsigned long bits, bytes, bit, begin, end, lo, hi;
+	int got, want, set, n;
+	char *m;
+	int rc = OK;
+	int i;
+
+	srand(3);
+	for (i = 0; i < BENCH_CHECK_ROUNDS && rc == OK; i++) {
+		bits = rand() % 2048 + 1;
+		bytes = (bits + 7) / 8;
+		m = malloc(bytes);
+		if (!m)
+			return OUT_OF_MEMORY;
+		memset(m, (i % 3) == 1 ? 0xff : 0, bytes);
+		if ((i % 3) == 2) {
+			for (n = rand() % 4; n > 0; n--) {
+				bit = rand() % bits;
+				m[bit / 8] |= 1 << (bit % 8);
+			}
+		}
+		/* bits past the end of the scan are never checked */
+		if (bits % 8)
+			m[bytes - 1] ^= 0xff << (bits % 8);
+
+		lo = bits;
+		hi = 0;
+		set = 0;
+		for (bit = 0; bit < bits; bit++) {
+			if (!(m[bit / 8] & (1 << (bit % 8))))
+				continue;
+			if (bit < lo)
+				lo = bit;
+			hi = bit + 1;
+			set++;
+		}
+		if (!set) {
+			want = JTAG_VERIFY_NONE;
+			lo = 0;
+			hi = bits;
+		} else if (set == bits) {
+			want = JTAG_VERIFY_FULL;
+		} else {
+			want = JTAG_VERIFY_PARTIAL;
+		}
+
+		got = jtag_verify_span(m, bits, &begin, &end);
+		if (got != want || begin != lo || end != hi) {
+			fprintf(stderr, "verify span: %lu bits, got %d [%lu,%lu) instead of %d [%lu,%lu)\n",
+				bits, got, begin, end, want, lo, hi);
+			rc = FILE_ERROR;
+		}
+		free(m);
+	}
+
+	if (rc == OK)
+		printf("verify span: %d random masks match the bit loop\n",
+		       BENCH_CHECK_ROUNDS);
+	return rc;
+}
+
+/* Time a passing check of one masked verify row, the common case. */
+/*
+ * The shortest paths of the TAP tracker against every TMS sequence of up
+ * to 8 bits, and five TMS high reaching Test-Logic-Reset from anywhere.
+ */
+static int check_tap(void)
+{
+	int best[TAP_STATES][TAP_STATES];
+	int from, to, len, seq, bit, state;
+	int rc = OK;
+
+	jtag_tap_init();
+	for (from = 0; from < TAP_STATES; from++) {
+		for (to = 0; to < TAP_STATES; to++)
+			best[from][to] = -1;
+		for (len = 0; len <= 8; len++) {
+			for (seq = 0; seq < (1 << len); seq++) {
+				state = from;
+				for (bit = 0; bit < len; bit++)
+					state = jtag_tap_next(state, seq & (1 << bit));
+				if (best[from][state] < 0)
+					best[from][state] = len;
+			}
+		}
+
+		state = from;
+		for (bit = 0; bit < 5; bit++)
+			state = jtag_tap_next(state, 1);
+		if (state != TAP_RESET) {
+			fprintf(stderr, "tap: five TMS high from %d end in %d\n", from, state);
+			rc = FILE_ERROR;
+		}
+		for (to = 0; to < TAP_STATES; to++) {
+			if (best[from][to] != jtag_tap_path(from, to)) {
+				fprintf(stderr, "tap: path %d -> %d is %d TCK instead of %d\n",
+					from, to, jtag_tap_path(from, to), best[from][to]);
+				rc = FILE_ERROR;
+			}
+		}
+	}
+
+	if (rc == OK)
+		printf("tap: shortest paths between all %d states match the TMS sequences\n",
+		       TAP_STATES);
+	return rc;
+}
+
+/* one instruction to both devices of the simulated chain */
+static int sim_both_ir(unsigned char ir)
+{
+	char tdi[2] = { ir, ir };
+
+	return jtag_player_sir(16, tdi, NULL, NULL);
+}
+
+/*
+ * Two generic devices of the sim backend behind the player: read both
+ * IDCODEs, a wrong one must fail, then erase, write rows to both flash
+ * arrays and read them back with TDO checks.
+ */
+static int check_sim(void)
+{
+	unsigned int bytes = 2 * ((jtag_sim_generic.row_bits + 7) / 8);
+	char *rows, *zero, *mask;
+	char tdi[8], tdo[8];
+	int rc = OK;
+	int i;
+
+	rows = malloc(BENCH_SIM_ROWS * bytes);
+	zero = calloc(1, bytes);
+	mask = malloc(bytes);
+	if (!rows || !zero || !mask) {
+		rc = OUT_OF_MEMORY;
+		goto out;
+	}
+	fill_random(rows, BENCH_SIM_ROWS * bytes);
+	memset(mask, 0xff, bytes);
+
+	if (jtag_backend_open("sim:generic,generic")) {
+		rc = FILE_ERROR;
+		goto out;
+	}
+	jtag_handlers_init();
+
+	memset(tdi, 0, sizeof(tdi));
+	for (i = 0; i < 8; i++)
+		tdo[i] = jtag_sim_generic.idcode >> (8 * (i % 4));
+	if (sim_both_ir(SIM_IDCODE_PUB) || jtag_player_sdr(64, tdi, tdo, mask)) {
+		fprintf(stderr, "sim: IDCODEs do not read back\n");
+		rc = FILE_ERROR;
+	}
+	tdo[7] ^= 0x10;
+	if (rc == OK && !jtag_player_sdr(64, tdi, tdo, mask)) {
+		fprintf(stderr, "sim: a wrong IDCODE passes the TDO check\n");
+		rc = FILE_ERROR;
+	}
+
+	if (rc == OK && (sim_both_ir(SIM_ISC_ERASE) || jtag_player_sdr(16, zero, NULL, NULL) ||
+			 sim_both_ir(SIM_LSC_INIT_ADDRESS) || jtag_player_sdr(16, zero, NULL, NULL) ||
+			 sim_both_ir(SIM_LSC_PROG_INCR_NV)))
+		rc = FILE_ERROR;
+	for (i = 0; i < BENCH_SIM_ROWS && rc == OK; i++) {
+		if (jtag_player_sdr(bytes * 8, rows + i * bytes, NULL, NULL) ||
+		    jtag_player_runtest(IDLE, 2, 0))
+			rc = FILE_ERROR;
+	}
+	if (rc == OK && (sim_both_ir(SIM_LSC_INIT_ADDRESS) || jtag_player_sdr(16, zero, NULL, NULL) ||
+			 sim_both_ir(SIM_LSC_READ_INCR_NV)))
+		rc = FILE_ERROR;
+	for (i = 0; i < BENCH_SIM_ROWS && rc == OK; i++) {
+		if (jtag_player_sdr(bytes * 8, zero, rows + i * bytes, mask)) {
+			fprintf(stderr, "sim: flash row %d does not read back\n", i);
+			rc = FILE_ERROR;
+		}
+	}
+
+	if (rc == OK)
+		printf("sim: IDCODEs and %d flash rows of two devices read back, %.6f s simulated\n",
+		       BENCH_SIM_ROWS, jtag_sim_now_ns() / 1e9);
+	jtag_backend_close();
+	jtag_handlers_init();
+out:
+	free(rows);
+	free(zero);
+	free(mask);
+	return rc;
+}
+
+/*
+ * The MachXO2 model: erase and program keep it busy for their latencies,
+ * a row written while it is busy is refused, sets the Fail bit and reads
+ * back erased.
+ */
+static int check_sim_xo2(void)
+{
+	char row[16], zero[16], mask[16];
+	char one = 1, nul = 0, cfg = 0x04;
+	char status[4], status_mask[4] = { 0x00, 0x23, 0x00, 0x00 };
+	char op[1];
+	int rc = OK;
+
+	fill_random(row, sizeof(row));
+	memset(zero, 0, sizeof(zero));
+	memset(mask, 0xff, sizeof(mask));
+	if (jtag_backend_open("sim:machxo2/erase=1000/prog=1000"))
+		return FILE_ERROR;
+	jtag_handlers_init();
+
+	/* ISC_ENABLE, erase CFG, busy right after it and not 1 ms later */
+	op[0] = 0xC6;
+	if (jtag_player_sir(8, op, NULL, NULL) || jtag_player_sdr(8, zero, NULL, NULL))
+		rc = FILE_ERROR;
+	op[0] = SIM_ISC_ERASE;
+	if (rc == OK && (jtag_player_sir(8, op, NULL, NULL) || jtag_player_sdr(8, &cfg, NULL, NULL)))
+		rc = FILE_ERROR;
+	op[0] = 0xF0;
+	if (rc == OK && (jtag_player_sir(8, op, NULL, NULL) ||
+			 jtag_player_sdr(1, &nul, &one, mask) ||
+			 jtag_player_runtest(IDLE, 0, 1000) ||
+			 jtag_player_sdr(1, &nul, &nul, mask))) {
+		fprintf(stderr, "sim: machxo2 is not busy for the erase latency\n");
+		rc = FILE_ERROR;
+	}
+
+	/* two rows with the program latency waited out, a third one without */
+	op[0] = SIM_LSC_INIT_ADDRESS;
+	if (rc == OK && (jtag_player_sir(8, op, NULL, NULL) || jtag_player_sdr(8, &cfg, NULL, NULL)))
+		rc = FILE_ERROR;
+	op[0] = SIM_LSC_PROG_INCR_NV;
+	if (rc == OK && (jtag_player_sir(8, op, NULL, NULL) ||
+			 jtag_player_sdr(128, row, NULL, NULL) ||
+			 jtag_player_runtest(IDLE, 0, 1000) ||
+			 jtag_player_sdr(128, row, NULL, NULL) ||
+			 jtag_player_sdr(128, row, NULL, NULL)))
+		rc = FILE_ERROR;
+	op[0] = 0x3C;
+	memset(status, 0, sizeof(status));
+	status[1] = 0x22;	/* ISC enabled, Fail, not DONE */
+	if (rc == OK && (jtag_player_sir(8, op, NULL, NULL) ||
+			 jtag_player_sdr(32, zero, status, status_mask))) {
+		fprintf(stderr, "sim: machxo2 status does not show the refused row\n");
+		rc = FILE_ERROR;
+	}
+
+	op[0] = SIM_LSC_INIT_ADDRESS;
+	if (rc == OK && (jtag_player_sir(8, op, NULL, NULL) || jtag_player_sdr(8, &cfg, NULL, NULL) ||
+			 jtag_player_runtest(IDLE, 0, 1000)))
+		rc = FILE_ERROR;
+	op[0] = SIM_LSC_READ_INCR_NV;
+	if (rc == OK && (jtag_player_sir(8, op, NULL, NULL) ||
+			 jtag_player_sdr(128, zero, row, mask) ||
+			 jtag_player_sdr(128, zero, row, mask) ||
+			 jtag_player_sdr(128, zero, zero, mask))) {
+		fprintf(stderr, "sim: machxo2 rows do not read back\n");
+		rc = FILE_ERROR;
+	}
+
+	if (rc == OK)
+		printf("sim: machxo2 busy for erase and program, refused row reads back erased\n");
+	jtag_backend_close();
+	jtag_handlers_init();
+	return rc;
+}
+
+/*
+ * Status polling on the MachXO2 model: a 2 s erase wait before the
+ * LSC_CHECK_BUSY check ends soon after the 100 ms erase, a loop of 10 ms
+ * waits and busy checks passes after about 10 runs, one of 5 runs fails.
+ */
+static int check_poll(void)
+{
+	char one = 1, nul = 0, cfg = 0x04;
+	char op[1];
+	unsigned long long start;
+	int line = 0;
+	int rc = OK;
+
+	if (jtag_backend_open("sim:machxo2/erase=100000"))
+		return FILE_ERROR;
+	jtag_handlers_init();
+	jtag_poll_enable(1);
+
+	op[0] = 0xC6;
+	if (jtag_player_sir(8, op, NULL, NULL) || jtag_player_sdr(8, &nul, NULL, NULL))
+		rc = FILE_ERROR;
+	start = jtag_sim_now_ns();
+	op[0] = SIM_ISC_ERASE;
+	if (rc == OK && (jtag_player_sir(8, op, NULL, NULL) || jtag_player_sdr(8, &cfg, NULL, NULL) ||
+			 jtag_player_runtest(IDLE, 2, 2000000)))
+		rc = FILE_ERROR;
+	op[0] = 0xF0;
+	if (rc == OK && (jtag_player_sir(8, op, NULL, NULL) ||
+			 jtag_player_sdr(1, &nul, &nul, &one) || jtag_poll_flush() ||
+			 jtag_sim_now_ns() - start > 200000000ULL)) {
+		fprintf(stderr, "poll: the erase wait is not cut short\n");
+		rc = FILE_ERROR;
+	}
+	jtag_poll_enable(0);
+
+	op[0] = SIM_ISC_ERASE;
+	if (rc == OK && (jtag_player_sir(8, op, NULL, NULL) || jtag_player_sdr(8, &cfg, NULL, NULL)))
+		rc = FILE_ERROR;
+	op[0] = 0xF0;
+	if (rc == OK && (jtag_poll_loop(100) || jtag_poll_loop_runtest(IDLE, 2, 10000) ||
+			 jtag_poll_loop_scan(SIR, 8, op, NULL, NULL, 1) ||
+			 jtag_poll_loop_scan(SDR, 1, &nul, &nul, &one, 2) ||
+			 jtag_poll_loop_run(&line))) {
+		fprintf(stderr, "poll: the loop does not pass after the erase\n");
+		rc = FILE_ERROR;
+	}
+	op[0] = SIM_ISC_ERASE;
+	if (rc == OK && (jtag_player_sir(8, op, NULL, NULL) || jtag_player_sdr(8, &cfg, NULL, NULL)))
+		rc = FILE_ERROR;
+	op[0] = 0xF0;
+	if (rc == OK && (jtag_poll_loop(5) || jtag_poll_loop_runtest(IDLE, 2, 10000) ||
+			 jtag_poll_loop_scan(SIR, 8, op, NULL, NULL, 1) ||
+			 jtag_poll_loop_scan(SDR, 1, &nul, &nul, &one, 2) ||
+			 jtag_poll_loop_run(&line) != 1 || line != 2)) {
+		fprintf(stderr, "poll: a loop shorter than the erase passes\n");
+		rc = FILE_ERROR;
+	}
+
+	if (rc == OK)
+		printf("poll: erase wait cut to %.3f s, loops pass and fail with the busy bit\n",
+		       (jtag_sim_now_ns() - start) / 1e9);
+	jtag_backend_close();
+	jtag_handlers_init();
+	return rc;
+}
+
+/*
+ * A RUNTEST wait that is not a whole number of milliseconds: 1.9 ms is
+ * carried as 1900 us, not as the 1 ms of its VME encoding, and clocked
+ * out as at least 1900 TCKs at 1 MHz.
+ */
+static int check_runtest_usec(void)
+{
+	unsigned long usec = jtag_wait_sec_to_us(1.90E-03);
+	unsigned long long tck;
+	int rc = OK;
+
+	if (usec != 1900 || jtag_wait_sec_to_us(1.00E-03) != 1000 ||
+	    jtag_wait_sec_to_us(2.5E-06) != 3) {
+		fprintf(stderr, "runtest: SEC values are not rounded up to whole us\n");
+		return FILE_ERROR;
+	}
+	if (jtag_backend_open("sim:generic"))
+		return FILE_ERROR;
+	jtag_handlers_init();
+
+	if (jtag_player_set_frequency(1000000) || jtag_player_runtest(IDLE, 0, 0))
+		rc = FILE_ERROR;
+	tck = jtag_sim_tck();
+	if (rc == OK && jtag_player_runtest(IDLE, 2, usec))
+		rc = FILE_ERROR;
+	tck = jtag_sim_tck() - tck;
+	if (rc == OK && tck < 1900) {
+		fprintf(stderr, "runtest: a 1.9 ms wait is clocked as %llu TCKs at 1 MHz\n", tck);
+		rc = FILE_ERROR;
+	}
+
+	if (rc == OK)
+		printf("runtest: a 1.9 ms wait is clocked as %llu TCKs at 1 MHz\n", tck);
+	jtag_backend_close();
+	jtag_handlers_init();
+	return rc;
+}
+
+static int bench_verify(unsigned int bits, int passes)
+{
+	unsigned int bytes = (bits + 31) / 32 * 4;
+	double start, legacy, words;
+	char *a, *e, *m;
+	int pass;
+
+	a = malloc(bytes);
+	e = malloc(bytes);
+	m = malloc(bytes);
+	if (!a || !e || !m) {
+		free(a);
+		free(e);
+		free(m);
+		return OUT_OF_MEMORY;
+	}
+	fill_random(e, bytes);
+	memcpy(a, e, bytes);
+	memset(m, 0xff, bytes);
+
+	start = bench_now();
+	for (pass = 0; pass < passes; pass++)
+		bench_sink += legacy_check_tdo(a, e, m, bits);
+	legacy = bench_now() - start;
+
+	start = bench_now();
+	for (pass = 0; pass < passes; pass++)
+		bench_sink += jtag_verify(a, e, m, bits);
+	words = bench_now() - start;
+
+	printf("verify: %u bits with MASK, %d passes\n", bits, passes);
+	printf("  bit loop:       %10.3f s %12.0f Mbit/s\n",
+	       legacy, bits * (double)passes / legacy / 1e6);
+	printf("  jtag_verify:    %10.3f s %12.0f Mbit/s (x%.1f)\n",
+	       words, bits * (double)passes / words / 1e6, legacy / words);
+
+	free(a);
+	free(e);
+	free(m);
+	return OK;
+}
+
+/*
+ * Shift SDRs with TDO and MASK through the player and the simulated driver,
+ * without padding (shifted in place) and behind a one bit HDR/TDR (spliced
+ * into the shift buffer). Every scan must pass its TDO check.
+ */
+static int bench_player(unsigned long bits, int padded, int passes)
+{
+	unsigned long bytes = (bits + 7) / 8;
+	char *tdi, *tdo, *mask;
+	double start, elapsed;
+	int rc = OK;
+	int pass;
+
+	tdi = malloc(bytes);
+	tdo = malloc(bytes);
+	mask = malloc(bytes);
+	if (!tdi || !tdo || !mask) {
+		rc = OUT_OF_MEMORY;
+		goto out;
+	}
+	fill_random(tdi, bytes);
+	memcpy(tdo, tdi, bytes);
+	memset(mask, 0xff, bytes);
+
+	jtag_handlers_init();
+	if (padded && (jtag_player_set_trailer(HDR, 1, NULL) ||
+		       jtag_player_set_trailer(TDR, 1, NULL))) {
+		rc = OUT_OF_MEMORY;
+		goto out;
+	}
+
+	sim.xfers = 0;
+	sim.bits = 0;
+	start = bench_now();
+	for (pass = 0; pass < passes && rc == OK; pass++) {
+		if (jtag_player_sdr(bits, tdi, tdo, mask)) {
+			fprintf(stderr, "player: TDO mismatch on a %lu bit scan\n", bits);
+			rc = FILE_ERROR;
+		}
+	}
+	elapsed = bench_now() - start;
+
+	if (rc == OK)
+		printf("  %8lu bits %-9s %10.6f s/scan %8.0f Mbit/s\n", bits,
+		       padded ? "padded" : "in place", elapsed / passes,
+		       sim.bits / elapsed / 1e6);
+
+	jtag_player_set_trailer(HDR, 0, NULL);
+	jtag_player_set_trailer(TDR, 0, NULL);
+out:
+	free(tdi);
+	free(tdo);
+	free(mask);
+	return rc;
+}
+
+static int bench_players(int passes)
+{
+	static const unsigned long sizes[] = { 64 * 1024, 1024 * 1024, 16 * 1024 * 1024 };
+	unsigned int i;
+	int rc = OK;
+
+	printf("player: SDR with TDO and MASK through a simulated driver, %d passes\n",
+	       passes);
+	for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]) && rc == OK; i++) {
+		rc = bench_player(sizes[i], 0, passes);
+		if (rc == OK)
+			rc = bench_player(sizes[i], 1, passes);
+	}
+	return rc;
+}
+
+/*
+ * The row loop of a Lattice SVF, SIR once and then SDR + RUNTEST per row,
+ * into the simulated chain with every op submitted on its own and in
+ * batches of JTAG_BACKEND_BATCH_MAX_OPS.
+ */
+static int bench_batch(int passes)
+{
+	static const unsigned int batches[] = { 0, JTAG_BACKEND_BATCH_MAX_OPS };
+	unsigned int rows = jtag_sim_generic.rows;
+	unsigned int bytes = (jtag_sim_generic.row_bits + 7) / 8;
+	double start, elapsed;
+	char op = SIM_LSC_PROG_INCR_NV;
+	unsigned int i, row;
+	char *data;
+	int rc = OK;
+	int pass;
+
+	data = malloc(rows * bytes);
+	if (!data)
+		return OUT_OF_MEMORY;
+	fill_random(data, rows * bytes);
+
+	printf("batch: %u row SDR + RUNTEST loop into the simulated chain, %d passes\n",
+	       rows, passes);
+	for (i = 0; i < sizeof(batches) / sizeof(batches[0]) && rc == OK; i++) {
+		if (jtag_backend_open("sim") || jtag_backend_set_batch(batches[i])) {
+			rc = FILE_ERROR;
+			break;
+		}
+		jtag_handlers_init();
+		start = bench_now();
+		for (pass = 0; pass < passes && rc == OK; pass++) {
+			if (jtag_player_sir(8, &op, NULL, NULL))
+				rc = FILE_ERROR;
+			for (row = 0; row < rows && rc == OK; row++) {
+				if (jtag_player_sdr(jtag_sim_generic.row_bits, data + row * bytes, NULL, NULL) ||
+				    jtag_player_runtest(IDLE, 2, 0))
+					rc = FILE_ERROR;
+			}
+			if (jtag_backend_flush())
+				rc = FILE_ERROR;
+		}
+		elapsed = bench_now() - start;
+		if (rc == OK)
+			printf("  batch %4u %10.6f s/pass %10.0f rows/s\n", batches[i],
+			       elapsed / passes, rows * (double)passes / elapsed);
+		jtag_backend_close();
+		jtag_handlers_init();
+	}
+
+	free(data);
+	return rc;
+}
+
+int main(int argc, char *argv[])
+{
+	int passes = BENCH_DEF_PASSES;
+	int rc;
+
+	if (argc > 1)
+		passes = atoi(argv[1]);
+	if (passes <= 0)
+		passes = BENCH_DEF_PASSES;
+
+	rc = check_bitstream();
+	if (rc == OK)
+		rc = bench_bitstream(600000, 1, passes);
+	if (rc == OK)
+		rc = bench_bitstream(600000, 0, passes);
+	if (rc == OK)
+		rc = check_verify();
+	if (rc == OK)
+		rc = check_verify_span();
+	if (rc == OK)
+		rc = check_tap();
+	if (rc == OK)
+		rc = check_sim();
+	if (rc == OK)
+		rc = check_sim_xo2();
+	if (rc == OK)
+		rc = check_poll();
+	if (rc == OK)
+		rc = check_runtest_usec();
+	if (rc == OK)
+		rc = bench_verify(600000, passes);
+	if (rc == OK)
+		rc = bench_players(passes);
+	if (rc == OK)
+		rc = bench_batch(passes);
+	return rc;
+}
@@ -0,0 +1,191 @@
+/*
+ * Copyright (c) 2017 Mellanox Technologies. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the names of the copyright holders nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * Alternatively, this software may be distributed under the terms of the
+ * GNU General Public License ("GPL") version 2 as published by the Free
+ * Software Foundation.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <uapi/linux/jtag.h>
+#include "utilities.h"
+#include "bitstream.h"
+#include "jtag_clock.h"
+#include "jtag_wait.h"
+#include "jtag_backend.h"
+
+/* TCK frequencies tried, in Hz */
+static const unsigned long g_clock_steps[] = {
+	20000, 50000, 100000, 250000, 500000, 1000000, 2000000, 4000000,
+	8000000, 12500000, 16000000, 20000000, 25000000, 33000000, 50000000,
+};
+#define JTAG_CLOCK_STEPS	(sizeof(g_clock_steps) / sizeof(g_clock_steps[0]))
+
+/*
+ * One read back of the chain: the IDCODE bits after a TAP reset, the
+ * instruction capture bits while all IRs are loaded with BYPASS, and a
+ * pattern shifted through the BYPASS registers.
+ */
+#define PROBE_IDCODE_BITS	64
+#define PROBE_IR_BITS		256
+#define PROBE_PATTERN_BITS	128
+#define PROBE_DELAY_MAX		64	/* devices in the chain */
+#define PROBE_DR_BITS		(PROBE_PATTERN_BITS + PROBE_DELAY_MAX)
+
+typedef struct {
+	unsigned char idcode[PROBE_IDCODE_BITS / 8];
+	unsigned char ir[PROBE_IR_BITS / 8];
+	unsigned char dr[PROBE_DR_BITS / 8];
+} jtag_clock_probe_t;
+
+static const unsigned char g_probe_pattern[PROBE_PATTERN_BITS / 8] = {
+	0xa5, 0x3c, 0x96, 0x0f, 0xe1, 0x5a, 0xc3, 0x69,
+	0x0f, 0xf0, 0x55, 0xaa, 0x33, 0xcc, 0x81, 0x7e,
+};
+
+static void jtag_clock_reset(void)
+{
+	jtag_backend_reset(JTAG_STATE_IDLE);
+}
+
+static int jtag_clock_shift(__u8 type, unsigned char *tdio, unsigned int bits)
+{
+	struct jtag_xfer xfer;
+
+	memset(&xfer, 0, sizeof(xfer));
+	xfer.mode = JTAG_XFER_SW_MODE;
+	xfer.type = type;
+	xfer.direction = JTAG_READ_XFER;
+	xfer.endstate = JTAG_STATE_IDLE;
+	xfer.length = bits;
+	xfer.tdio = (__u64)(uintptr_t)tdio;
+	return jtag_backend_xfer(&xfer);
+}
+
+static int jtag_clock_probe(jtag_clock_probe_t *probe)
+{
+	jtag_clock_reset();
+
+	memset(probe, 0, sizeof(*probe));
+	memset(probe->ir, 0xff, sizeof(probe->ir));
+	memcpy(probe->dr, g_probe_pattern, sizeof(g_probe_pattern));
+	if (jtag_clock_shift(JTAG_SDR_XFER, probe->idcode, PROBE_IDCODE_BITS) ||
+	    jtag_clock_shift(JTAG_SIR_XFER, probe->ir, PROBE_IR_BITS) ||
+	    jtag_clock_shift(JTAG_SDR_XFER, probe->dr, PROBE_DR_BITS))
+		return -1;
+
+	jtag_clock_reset();
+	return 0;
+}
+
+/*
+ * The pattern has to come out of the BYPASS registers delayed by one bit
+ * per device, otherwise nothing answers and any frequency would pass.
+ */
+static int jtag_clock_chain_ok(const jtag_clock_probe_t *probe)
+{
+	unsigned char out[PROBE_PATTERN_BITS / 8];
+	unsigned int delay;
+
+	for (delay = 1; delay <= PROBE_DELAY_MAX; delay++) {
+		bitstream_copy(out, 0, probe->dr, delay, PROBE_PATTERN_BITS);
+		if (!memcmp(out, g_probe_pattern, sizeof(out)))
+			return 1;
+	}
+	return 0;
+}
+
+static int jtag_clock_set(unsigned long hz)
+{
+	return jtag_backend_set_freq(hz);
+}
+
+/*
+ * Find the TCK frequency for -clock auto. The driver is left at the
+ * frequency returned, or at the slowest step if the chain does not read
+ * back. Returns the frequency in Hz, or FILE_ERROR in that case.
+ */
+long jtag_clock_auto(void)
+{
+	jtag_clock_probe_t base, probe;
+	unsigned long best = 0;
+	unsigned long hz;
+	unsigned int step, n;
+
+	if (jtag_clock_set(g_clock_steps[0]) || jtag_clock_probe(&base) ||
+	    !jtag_clock_chain_ok(&base)) {
+		printf("Auto clock: the chain does not read back at %lu Hz\n", g_clock_steps[0]);
+		return FILE_ERROR;
+	}
+
+	for (step = 0; step < JTAG_CLOCK_STEPS; step++) {
+		if (jtag_clock_set(g_clock_steps[step]))
+			break;
+		for (n = 0; n < JTAG_CLOCK_AUTO_READS; n++) {
+			if (jtag_clock_probe(&probe) || memcmp(&probe, &base, sizeof(base)))
+				break;
+		}
+		if (n < JTAG_CLOCK_AUTO_READS)
+			break;
+		best = g_clock_steps[step];
+	}
+
+	hz = best * JTAG_CLOCK_AUTO_MARGIN / 100;
+	if (hz < g_clock_steps[0])
+		hz = g_clock_steps[0];
+	printf("Auto clock: reads back reliably up to %lu Hz, using %lu Hz\n", best, hz);
+	jtag_clock_set(hz);
+	return hz;
+}
+
+/*
+ * Wait until the chain answers: reset the TAP and shift IDCODE and BYPASS
+ * until the pattern comes back through the BYPASS registers. Returns 0
+ * as soon as it does, or -1 after JTAG_READY_TIMEOUT_MS.
+ */
+int jtag_clock_ready(void)
+{
+	jtag_clock_probe_t probe;
+	struct timespec start, now;
+	long ms;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (;;) {
+		if (!jtag_clock_probe(&probe) && jtag_clock_chain_ok(&probe))
+			return 0;
+
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		ms = (now.tv_sec - start.tv_sec) * 1000 +
+		     (now.tv_nsec - start.tv_nsec) / 1000000;
+		if (ms >= JTAG_READY_TIMEOUT_MS)
+			return -1;
+		jtag_wait_us(JTAG_READY_POLL_MS * 1000);
+	}
+}
@@ -35,14 +35,22 @@
 #include <stdlib.h>
 #include <ctype.h>
 #include <string.h>
+#include <stdint.h>
 #include <malloc.h>
 #include <fcntl.h>
 #include <time.h>
-#include <sys/ioctl.h>
 #include <uapi/linux/jtag.h>
 #include "vmopcode.h"
 #include "utilities.h"
 #include "jtag_handlers.h"
+#include "svf_keywords.h"
+#include "jtag_plan.h"
+#include "bitstream.h"
+#include "jtag_verify.h"
+#include "jtag_vqueue.h"
+#include "jtag_tap.h"
+#include "jtag_backend.h"
+#include "jtag_poll.h"
 
 #define JTAG_DEBUG	0
 
@@ -53,128 +61,53 @@
 #define SIR_DATA_TR	4
 #define SDR_DATA_TR	5
 
-typedef struct {
-	char cmd;
-	enum jtag_data_state_e{
-		JTAG_IDLE,
-		JTAG_CMD,
-		JTAG_TOKEN,
-		JTAG_BYTE,
-		JTAG_ERR
-	} state;
-
-	unsigned int bit_size;
-	char *tdi;
-	char *tdo;
-	char *mask;
-
-	char *wr_data_p;
-	unsigned int data_pos;
-	char size_shift;
-} jtag_handler_data_t;
-
-typedef struct {
-	enum runtest_state_e{
-		RUNTEST_IDLE,
-		RUNTEST_VAL,
-		RUNTEST_ERR,
-	} state;
-	char cmd;
-	int data;
-	char data_shift;
-
-	char new_state;
-	int  wait;
-	int  tck;
-	char end_state;
-} runtest_handler_data_t;
-
 typedef struct {
 	unsigned int bit_size;
 	unsigned int mask_bit_size;
-	char *tdi;
-	char *tdo;
-	char *mask;
+	const char *tdi;
+	const char *tdo;
+	const char *mask;
 } jtag_transaction_t;
 
-typedef struct {
-	jtag_handler_data_t sir_sdr_data;
-	runtest_handler_data_t runtest_data;
-} write_handler_data_t;
-
-extern int g_JTAGFile;
 extern char g_direct_prog;
 
-write_handler_data_t g_write_handler_data;
+/*
+ * HIR/HDR/TIR/TDR own a copy of their data, SIR/SDR point at the buffers
+ * of the caller for the duration of a jtag_player_sir/sdr() call.
+ */
 jtag_transaction_t g_transaction_data[6];
 
-static char g_bitbuf[1024];
+/* cache line size, buffers are aligned to it and grow in multiples of it */
+#define JTAG_BUF_ALIGN	64
+
+typedef struct {
+	char *data;
+	unsigned int size;	/* bytes allocated */
+} jtag_buf_t;
+
+/* shift buffer of the current scan and the TDO data extracted from it */
+static jtag_buf_t g_bitbuf;
+static jtag_buf_t g_tdobuf;
+/* expected TDO and MASK of the current scan laid out like g_bitbuf, for -plan */
+static jtag_buf_t g_plan_tdo;
+static jtag_buf_t g_plan_mask;
 static unsigned int g_bitbuf_pos = 0;
 
-#if (JTAG_DEBUG != 0)
-extern char g_debug;
+/* how the scans of this run were shifted, printed with -d */
+static struct {
+	unsigned long in_place;	/* straight from the TDI buffer of the caller */
+	unsigned long merged;	/* spliced with header/trailer bits into g_bitbuf */
+	unsigned long verify[3];	/* by JTAG_VERIFY_NONE/FULL/PARTIAL */
+	unsigned long runtests;	/* JTAG_IOCRUNTEST calls */
+	unsigned long tck_waits;	/* waits clocked out as TCKs */
+	unsigned long long bits;
+} g_player_stats;
 
-char *write_handler_cmd_str[] = {"WRITE_HANDLER_INIT_CMD",
-				"WRITE_HANDLER_BYTE_CMD",
-				"WRITE_HANDLER_SEND_CMD"};
+/* TCK frequency of the driver in Hz, 0 if not known */
+static unsigned long g_player_freq;
 
-static struct scanToken
-{
-	char * text;
-	int token;
-} scanTokens[] =
-{
-	/*********************************************************************
-	*
-	* Supported SVF keywords.
-	*
-	*********************************************************************/
-
-	{ ";", ENDDATA },
-	{ "SIR", SIR }, { "SDR", SDR },
-	{ "TDI", TDI }, { "TDO", TDO }, { "MASK", MASK },
-	{ "STATE", STATE },
-	{ "TCK", TCK, }, { "WAIT", WAIT },
-	{ "XSDR", XSDR }, { "XTDI", XTDI }, { "XTDO", XTDO },
-	{ "ENDDR", ENDDR },
-	{ "ENDIR", ENDIR },
-	{ "HIR", HIR }, { "TIR", TIR }, { "HDR", HDR }, { "TDR", TDR },
-	{ "MEM", MEM },
-	{ "RUNTEST", RUNTEST },
-	{ "ENDSTATE", ENDSTATE },
-	{ "TRST", TRST },
-	{ "FREQUENCY", FREQUENCY },
-	{ "SEC", SEC },
-	{ "SMASK", SMASK },
-	{ "MAXIMUM", MAX },
-	{"ON", ON},{"OFF", OFF},{"ISPEN",ispEN}, {"HIGH", HIGH},{"LOW", LOW},
-	{ "SETFLOW", SETFLOW }, { "RESETFLOW", RESETFLOW },
-	{ "REPEAT", REPEAT }, { "ENDLOOP", ENDLOOP },
-	{ "(", LEFTPAREN },
-	{ "CRC", CRC },
-	{ "CMASK", CMASK },
-	{ "RMASK", RMASK },
-	{ "READ", READ },
-	{ "DMASK", DMASK },
-	{ "VUES",  VUES },
-	{ "LCOUNT", LCOUNT },
-	{ "LDELAY", LDELAY },
-	{ "LSDR", LSDR },
-	{ "LVDS", LVDS },
-	{ "LOOP", LOOP }
-};
-
-static int ScanTokenMax = sizeof( scanTokens ) / sizeof( scanTokens[ 0 ] );
-
-char * get_token_str(char token){
-	int i;
-	for (i=0; i<ScanTokenMax; i++){
-		if (scanTokens[i].token ==  token){
-			return scanTokens[i].text;
-		}
-	}
-	return "Unknown Token";
-}
+#if (JTAG_DEBUG != 0)
+extern char g_debug;
 
 void jtag_print_xfer(jtag_transaction_t * data_p, int more_data){
 	int i;
@@ -218,647 +151,482 @@ void jtag_print_xfer_raw(struct jtag_xfer * xfer){
 }
 #endif
 
-static int char2int(char ** data_p, int bit_size){
-	long int data_o;
-	int size;
+/*
+ * Make room for bit_size bits, rounded up to whole cache lines. The buffers
+ * are refilled for every scan, so the old contents are not preserved when a
+ * buffer grows. They only grow, so after the largest scan of a file no more
+ * allocations are done.
+ */
+static int jtag_buf_reserve(jtag_buf_t *buf, unsigned int bit_size)
+{
+	unsigned int size = (bit_size + JTAG_BUF_ALIGN * 8 - 1) / 8;
+	void *data;
 
-	if (bit_size > 32)
-			return 0;
+	size -= size % JTAG_BUF_ALIGN;
+	if (size <= buf->size)
+		return 0;
 
-	size = (bit_size+7) / 8;
-	memcpy(&data_o, *data_p, size);
-	(*data_p)+=size;
-	return data_o;
+	if (size < buf->size * 2)
+		size = buf->size * 2;
+	if (posix_memalign(&data, JTAG_BUF_ALIGN, size))
+		return -1;
+	free(buf->data);
+	buf->data = data;
+	buf->size = size;
+	return 0;
 }
 
-static void put_bitbuffer(char *data, unsigned int bit_size){
-	unsigned char data_bit_offset = 0;
-	unsigned char byte_offset;
-	unsigned char bit_offset;
-	unsigned int bit_pos;
-
-	byte_offset = g_bitbuf_pos / 8;
-	bit_offset = g_bitbuf_pos % 8;
-	for (bit_pos = 0; bit_pos < bit_size; bit_pos++) {
-		g_bitbuf[byte_offset] &= ~(1<<bit_offset);
-		g_bitbuf[byte_offset] |= *data & (1<<data_bit_offset) ? (1<<bit_offset) : 0;
-		bit_offset++;
-		if (bit_offset == 8){
-			bit_offset = 0;
-			byte_offset ++;
-		}
-
-		data_bit_offset++;
-		if (data_bit_offset == 8){
-			data_bit_offset = 0;
-			data++;
-		}
-		g_bitbuf_pos++;
-	}
+static void put_bitbuffer(char *buf, unsigned int *buf_pos, const char *data, unsigned int bit_size){
+	/* a missing stream shifts zeros, the buffer is cleared by the caller */
+	if (data)
+		bitstream_copy(buf, *buf_pos, data, 0, bit_size);
+	*buf_pos += bit_size;
 }
 
-static void merge_bitbuffer(char *head, int head_len,
-							char *data, int data_len,
-							char *tail, int tail_len)
+static int merge_bitbuffer(const char *head, int head_len,
+							const char *data, int data_len,
+							const char *tail, int tail_len)
 {
+	if (jtag_buf_reserve(&g_bitbuf, head_len + data_len + tail_len))
+		return -1;
+
 	g_bitbuf_pos = 0;
-	memset(g_bitbuf, 0, sizeof(g_bitbuf));
+	memset(g_bitbuf.data, 0, (head_len + data_len + tail_len + 7) / 8);
 
-	put_bitbuffer(head, head_len);
-	put_bitbuffer(data, data_len);
-	put_bitbuffer(tail, tail_len);
+	put_bitbuffer(g_bitbuf.data, &g_bitbuf_pos, head, head_len);
+	put_bitbuffer(g_bitbuf.data, &g_bitbuf_pos, data, data_len);
+	put_bitbuffer(g_bitbuf.data, &g_bitbuf_pos, tail, tail_len);
+	return 0;
 }
 
-static void extract_bitbuffer(char *in_buf, int inbuf_len,
-							int head_len,
-							char *data, int data_len,
-							int tail_len)
+/*
+ * Hand a merged scan to the plan being compiled instead of the driver. The
+ * expected TDO and the MASK are laid out like the shift buffer: header and
+ * trailer bits are not checked, without a MASK all data bits are.
+ */
+static int jtag_plan_xfer(struct jtag_xfer *xfer, unsigned int head_len,
+						jtag_transaction_t *data_tr, int verify)
 {
-	unsigned int  bit_pos = 0;
-	unsigned char bit_offset;	/* bit pos in input data*/
-	unsigned char byte_offset;	/* byte pos in input data*/
-	unsigned char data_bit_offset; /*bit pos in output_data*/
-
-	/* HxR */
-	bit_pos += head_len;
-	bit_offset = head_len;
-	byte_offset = bit_offset/8;
-	bit_offset %= 8;
-	data_bit_offset = 0;
-	in_buf += byte_offset;
-
-	/* SxR */
-	while (bit_pos < (inbuf_len - tail_len)) {
-		*data &= ~(1<<data_bit_offset);
-		*data |= *in_buf & (1<<bit_offset) ? (1<<data_bit_offset) : 0;
-		data_bit_offset++;
-		if (data_bit_offset == 8){
-			data_bit_offset = 0;
-			data++;
-		}
-		bit_offset++;
-		if (bit_offset == 8){
-			bit_offset = 0;
-			in_buf++;
+	char *tdo = NULL;
+	char *mask = NULL;
+	unsigned int pos;
+
+	if (verify != JTAG_VERIFY_NONE) {
+		if (jtag_buf_reserve(&g_plan_tdo, xfer->length) ||
+			jtag_buf_reserve(&g_plan_mask, xfer->length))
+			return -1;
+		tdo = g_plan_tdo.data;
+		mask = g_plan_mask.data;
+		memset(tdo, 0, (xfer->length + 7) / 8);
+		memset(mask, 0, (xfer->length + 7) / 8);
+
+		pos = head_len;
+		put_bitbuffer(tdo, &pos, data_tr->tdo, data_tr->bit_size);
+		if ((data_tr->mask) && (data_tr->mask_bit_size == data_tr->bit_size)) {
+			pos = head_len;
+			put_bitbuffer(mask, &pos, data_tr->mask, data_tr->bit_size);
+		} else {
+			bitstream_fill(mask, head_len, data_tr->bit_size, 1);
 		}
-		bit_pos++;
 	}
+
+	return jtag_plan_add_scan((xfer->type == JTAG_SIR_XFER) ? JPLAN_OP_SIR : JPLAN_OP_SDR,
+							xfer->endstate, xfer->length, g_bitbuf.data, tdo, mask);
 }
 
-static int jtag_sir_xfer(void)
+/*
+ * Shift one SIR or SDR, or one chunk of it, with its header and trailer.
+ * The header goes with the first chunk and the trailer with the last one,
+ * the TAP is parked in PAUSE-IR/DR between chunks and left in the ENDIR
+ * or ENDDR state after the last one. Without header and trailer bits the
+ * chunk is shifted straight from the TDI buffer of the caller and its TDO
+ * is checked in place, otherwise the streams are spliced into g_bitbuf
+ * and the TDO is extracted from it.
+ *
+ * A scan whose MASK checks nothing is shifted write only. For a partial
+ * MASK only the range of bytes holding checked bits is extracted and
+ * compared.
+ */
+static int jtag_scan_xfer(__u8 type, jtag_transaction_t *head,
+						jtag_transaction_t *data_tr, jtag_transaction_t *tail,
+						int flags)
 {
 	struct jtag_xfer xfer;
-	int tdo_data_buf[16];	/*buffer to store received tdo data*/
-	int bit_remaining;
-	int TDO_expected;
-	int *tdo_data;
-	int MASK_data;
-	char CurBit;
-	char *mask_p;
-	char *tdo_p;
-	int ret = 0;
-	int i;
+	unsigned int head_len = (flags & JTAG_CHUNK_FIRST) ? head->bit_size : 0;
+	unsigned int tail_len = (flags & JTAG_CHUNK_LAST) ? tail->bit_size : 0;
+	unsigned long begin = 0;
+	unsigned long end = data_tr->bit_size;
+	int verify = JTAG_VERIFY_NONE;
+	const char *mask = NULL;
+	char *tdo_real;
+	int in_place;
+	int tap_end;
 
-	memset(&xfer, 0 ,sizeof(xfer));
 #if (JTAG_DEBUG != 0)
 	if (g_debug > 0) {
-		printf("JTAG SIR_CMD\n");
-		jtag_print_xfer(&g_transaction_data[HIR_TRAILER], 0);
-		jtag_print_xfer(&g_transaction_data[SIR_DATA_TR], 0);
-		jtag_print_xfer(&g_transaction_data[TIR_TRAILER], 0);
+		printf("JTAG %s_CMD\n", (type == JTAG_SIR_XFER) ? "SIR" : "SDR");
+		jtag_print_xfer(head, 0);
+		jtag_print_xfer(data_tr, 0);
+		jtag_print_xfer(tail, 0);
 	}
 #endif
+	memset(&xfer, 0 ,sizeof(xfer));
 
-	merge_bitbuffer(g_transaction_data[HIR_TRAILER].tdi, g_transaction_data[HIR_TRAILER].bit_size,
-						g_transaction_data[SIR_DATA_TR].tdi, g_transaction_data[SIR_DATA_TR].bit_size,
-						g_transaction_data[TIR_TRAILER].tdi, g_transaction_data[TIR_TRAILER].bit_size);
-
-	tdo_p = g_transaction_data[SIR_DATA_TR].tdo;
-	mask_p = g_transaction_data[SIR_DATA_TR].mask;
+	if (data_tr->tdo) {
+		verify = JTAG_VERIFY_FULL;
+		if ((data_tr->mask) && (data_tr->mask_bit_size == data_tr->bit_size))
+			verify = jtag_verify_span(data_tr->mask, data_tr->bit_size, &begin, &end);
+		if (verify == JTAG_VERIFY_PARTIAL)
+			mask = data_tr->mask;
+		/* compare from the byte holding the first checked bit */
+		begin -= begin % 8;
+	}
+	g_player_stats.verify[verify]++;
+
+	in_place = !head_len && !tail_len && data_tr->tdi && !jtag_plan_active();
+	if (in_place) {
+		xfer.tdio = (__u64)(uintptr_t)data_tr->tdi;
+		xfer.length = data_tr->bit_size;
+		g_player_stats.in_place++;
+	} else {
+		if (merge_bitbuffer(head->tdi, head_len,
+							data_tr->tdi, data_tr->bit_size,
+							tail->tdi, tail_len))
+			return -1;
+		xfer.tdio = (__u64)(uintptr_t)g_bitbuf.data;
+		xfer.length = g_bitbuf_pos;
+		g_player_stats.merged++;
+	}
+	g_player_stats.bits += xfer.length;
 
 	xfer.mode = JTAG_XFER_SW_MODE;
-	xfer.type = JTAG_SIR_XFER;
-	xfer.tdio = (__u64)g_bitbuf;
-	xfer.length = g_bitbuf_pos;
-
-	if (tdo_p)
+	xfer.type = type;
+	if (verify != JTAG_VERIFY_NONE)
 		xfer.direction = JTAG_READ_XFER;
 	else
 		xfer.direction = JTAG_WRITE_XFER;
+	if (flags & JTAG_CHUNK_LAST)
+		tap_end = jtag_tap_scan_end(type == JTAG_SIR_XFER);
+	else if (type == JTAG_SIR_XFER)
+		tap_end = TAP_IRPAUSE;
+	else
+		tap_end = TAP_DRPAUSE;
+	xfer.endstate = jtag_tap_endstate(tap_end);
+	jtag_tap_scan(type == JTAG_SIR_XFER, tap_end);
 
-	xfer.endstate = JTAG_STATE_IDLE;
+	if (jtag_plan_active())
+		return jtag_plan_xfer(&xfer, head_len, data_tr, verify);
 
 #if (JTAG_DEBUG != 0)
-	if (g_debug > 0) {
-		printf("\n========================\n");
+	if (g_debug > 1) {
+		printf("========================\n");
 		jtag_print_xfer_raw(&xfer);
 	}
-	usleep(25 * 1000);
 #endif
 
-	ioctl(g_JTAGFile, JTAG_IOCXFER, &xfer);
+	if (jtag_backend_xfer(&xfer))
+		return -1;
 
 #if (JTAG_DEBUG != 0)
-	usleep(25 * 1000);
-	if (g_debug > 0) {
+	if (g_debug > 1) {
 		jtag_print_xfer_raw(&xfer);
-		printf("========================\n\n");
+		printf("========================\n");
 	}
 #endif
 
-	/* check tdo */
-	if (tdo_p){
-		tdo_data = tdo_data_buf;
-
-		extract_bitbuffer((char *)(uintptr_t)xfer.tdio, xfer.length,
-						g_transaction_data[HIR_TRAILER].bit_size,
-						(char *)tdo_data,
-						g_transaction_data[SIR_DATA_TR].bit_size,
-						g_transaction_data[TIR_TRAILER].bit_size);
-
-		bit_remaining = g_transaction_data[SIR_DATA_TR].bit_size;
-
-		/*check mask if exists*/
-		MASK_data = 0xffffffff;
-		if ((mask_p) && (g_transaction_data[SIR_DATA_TR].mask_bit_size == g_transaction_data[SIR_DATA_TR].bit_size)){
-			MASK_data = char2int(&mask_p, bit_remaining);
-		}
-
-		TDO_expected = char2int(&tdo_p, bit_remaining);
+	if (verify == JTAG_VERIFY_NONE)
+		return 0;
 
-#if (JTAG_DEBUG != 0)
-		if (g_debug > 1) {
-			printf("SIR Check mask TDO_real 0x%08x MASK 0x%08x TDO_expect 0x%08x\n",
-					*tdo_data, MASK_data, TDO_expected);
-		}
-#endif
-		for (i = 0; i < bit_remaining; i++) {
-			CurBit = *tdo_data & (1 << i) ? 1 : 0;
-
-			if (MASK_data & (1<<i)) {
-				if (CurBit != (TDO_expected & (1 << i) ? 1 : 0)){
-					ret = -1;
-				}
-			}
-		}
+	if (mask)
+		mask += begin / 8;
+	if (in_place) {
+		tdo_real = (char *)data_tr->tdi + begin / 8;
+	} else {
+		if (jtag_buf_reserve(&g_tdobuf, end - begin))
+			return -1;
+		tdo_real = g_tdobuf.data;
+		bitstream_copy(tdo_real, 0, g_bitbuf.data, head_len + begin, end - begin);
 	}
-	return ret;
+	if (jtag_vqueue_active() && !(flags & JTAG_CHUNK_CHECK)) {
+		jtag_vqueue_check(tdo_real, data_tr->tdo + begin / 8, mask, end - begin, begin);
+		return 0;
+	}
+	if (jtag_verify(tdo_real, data_tr->tdo + begin / 8, mask, end - begin) < 0)
+		return 0;
+	return (flags & JTAG_CHUNK_CHECK) ? 1 : -1;
 }
 
-static int jtag_sdr_xfer(void)
+static void jtag_set_scan(jtag_transaction_t *tr, unsigned int bits,
+						const char *tdi, const char *tdo, const char *mask)
 {
-	struct jtag_xfer xfer;
-	int tdo_data_buf[64];	/*buffer to store received tdo data*/
-	int bit_remaining;
-	int TDO_expected;
-	int MASK_data;
-	int *tdo_data;
-	char *mask_p;
-	char *tdo_p;
-	int bit_pos;
-	char CurBit;
-	int ret = 0;
-	int i;
-
-#if (JTAG_DEBUG != 0)
-	if (g_debug > 0) {
-		printf("JTAG SDR_CMD\n");
-		jtag_print_xfer(&g_transaction_data[HDR_TRAILER], 0);
-		jtag_print_xfer(&g_transaction_data[SDR_DATA_TR], 0);
-		jtag_print_xfer(&g_transaction_data[TDR_TRAILER], 0);
-	}
-#endif
-	memset(&xfer, 0 ,sizeof(xfer));
-
-	merge_bitbuffer(g_transaction_data[HDR_TRAILER].tdi, g_transaction_data[HDR_TRAILER].bit_size,
-						g_transaction_data[SDR_DATA_TR].tdi, g_transaction_data[SDR_DATA_TR].bit_size,
-						g_transaction_data[TDR_TRAILER].tdi, g_transaction_data[TDR_TRAILER].bit_size);
-
-	tdo_p = g_transaction_data[SDR_DATA_TR].tdo;
-	mask_p = g_transaction_data[SDR_DATA_TR].mask;
-
-	xfer.mode = JTAG_XFER_SW_MODE;
-	xfer.type = JTAG_SDR_XFER;
-	xfer.tdio = (__u64)g_bitbuf;
-	xfer.length = g_bitbuf_pos;
-
-	if (tdo_p)
-		xfer.direction = JTAG_READ_XFER;
-	else
-		xfer.direction = JTAG_WRITE_XFER;
-	xfer.endstate = JTAG_STATE_IDLE;
-
-#if (JTAG_DEBUG != 0)
-	if (g_debug > 1) {
-		printf("========================\n");
-		jtag_print_xfer_raw(&xfer);
-	}
-#endif
+	tr->bit_size = bits;
+	tr->tdi = tdi;
+	tr->tdo = tdo;
+	tr->mask = mask;
+	tr->mask_bit_size = mask ? bits : 0;
+}
 
-	ioctl(g_JTAGFile, JTAG_IOCXFER, &xfer);
+/*
+ * Typed interface of the direct programming player. Scan data is LSB
+ * first, bit 0 of the first byte is shifted first. The buffers of a scan
+ * are used in place and only need to stay valid during the call. TDO
+ * may be NULL for a write only scan, MASK may be NULL to check all bits.
+ * Returns -1 if the captured TDO does not match. While the verify queue
+ * runs a failure is only recorded, it is reported by the next
+ * jtag_vqueue_sync().
+ *
+ * When no header or trailer is set, TDI is handed to the driver as the
+ * shift buffer and holds the bits shifted out on TDO after the call.
+ */
+int jtag_player_sir(unsigned int bits, char *tdi,
+					const char *tdo, const char *mask)
+{
+	return jtag_player_chunk(SIR, bits, tdi, tdo, mask,
+							JTAG_CHUNK_FIRST | JTAG_CHUNK_LAST);
+}
 
-#if (JTAG_DEBUG != 0)
-	if (g_debug > 1) {
-		jtag_print_xfer_raw(&xfer);
-		printf("========================\n");
-	}
-#endif
-	/* check tdo */
-	if (tdo_p){
-		tdo_data = tdo_data_buf;
-
-		extract_bitbuffer(	xfer.tdio, xfer.length,
-							g_transaction_data[HDR_TRAILER].bit_size,
-							(char *)tdo_data,
-							g_transaction_data[SDR_DATA_TR].bit_size,
-							g_transaction_data[TDR_TRAILER].bit_size);
-
-		bit_pos = 0;
-		while (bit_pos < g_transaction_data[SDR_DATA_TR].bit_size) {
-			bit_remaining = g_transaction_data[SDR_DATA_TR].bit_size - bit_pos;
-			if (bit_remaining > 32) {
-				bit_remaining = 32;
-				bit_pos += 32;
-			} else {
-				bit_pos += bit_remaining;
-			}
-
-			/*check mask if exists*/
-			MASK_data = 0xffffffff;
-			if ((mask_p) && (g_transaction_data[SDR_DATA_TR].mask_bit_size == g_transaction_data[SDR_DATA_TR].bit_size)){
-				MASK_data = char2int(&mask_p, bit_remaining);
-			}
-
-			TDO_expected = char2int(&tdo_p, bit_remaining);
+int jtag_player_sdr(unsigned int bits, char *tdi,
+					const char *tdo, const char *mask)
+{
+	return jtag_player_chunk(SDR, bits, tdi, tdo, mask,
+							JTAG_CHUNK_FIRST | JTAG_CHUNK_LAST);
+}
 
-#if (JTAG_DEBUG != 0)
-			if (g_debug > 0) {
-				printf("SDR Check mask TDO_real 0x%08x MASK 0x%08x TDO_expect 0x%08x\n",
-						*tdo_data, MASK_data, TDO_expected);
-			}
-#endif
+/*
+ * Shift a part of a SIR or SDR. A scan split into chunks starts with a
+ * JTAG_CHUNK_FIRST chunk and ends with a JTAG_CHUNK_LAST one, TDO is
+ * checked for each chunk on its own. With JTAG_CHUNK_CHECK the TDO is
+ * compared before the call returns, also while the verify queue runs.
+ */
+int jtag_player_chunk(unsigned char type, unsigned int bits, char *tdi,
+					const char *tdo, const char *mask, int flags)
+{
+	int ret;
 
-			for (i = 0; i < bit_remaining; i++) {
-				CurBit = *tdo_data & (1 << i) ? 1 : 0;
+	ret = jtag_poll_scan(type, bits, tdi, tdo, mask, flags);
+	if (ret != JTAG_POLL_PASS)
+		return ret;
 
-				if (MASK_data & (1<<i)) {
-					if (CurBit != (TDO_expected & (1 << i) ? 1 : 0))
-						ret = -1;
-				}
-			}
-			tdo_data++;
-		}
+	if (type == SIR) {
+		jtag_set_scan(&g_transaction_data[SIR_DATA_TR], bits, tdi, tdo, mask);
+		ret = jtag_scan_xfer(JTAG_SIR_XFER, &g_transaction_data[HIR_TRAILER],
+							&g_transaction_data[SIR_DATA_TR],
+							&g_transaction_data[TIR_TRAILER], flags);
+		jtag_set_scan(&g_transaction_data[SIR_DATA_TR], 0, NULL, NULL, NULL);
+	} else {
+		jtag_set_scan(&g_transaction_data[SDR_DATA_TR], bits, tdi, tdo, mask);
+		ret = jtag_scan_xfer(JTAG_SDR_XFER, &g_transaction_data[HDR_TRAILER],
+							&g_transaction_data[SDR_DATA_TR],
+							&g_transaction_data[TDR_TRAILER], flags);
+		jtag_set_scan(&g_transaction_data[SDR_DATA_TR], 0, NULL, NULL, NULL);
 	}
 	return ret;
 }
 
-static int jtag_set_transaction_data(jtag_handler_data_t * data_p,
-									unsigned char type)
+/*
+ * Set the HIR, HDR, TIR or TDR bits that pad every following SIR or SDR.
+ * The data is copied, a NULL tdi shifts zeros.
+ */
+int jtag_player_set_trailer(unsigned char type, unsigned int bits, const char *tdi)
 {
-	jtag_transaction_t *transacrtion_data_p = &g_transaction_data[type];
-	unsigned int size;
+	jtag_transaction_t *tr;
+	unsigned int size = (bits + 7) / 8;
+	char *data = NULL;
 
-	if (transacrtion_data_p->tdi){
-		free(transacrtion_data_p->tdi);
-		transacrtion_data_p->tdi = NULL;
-	}
-	if (transacrtion_data_p->tdo){
-		free(transacrtion_data_p->tdo);
-		transacrtion_data_p->tdo = NULL;
+	switch (type) {
+		case HIR:
+			tr = &g_transaction_data[HIR_TRAILER];
+			break;
+		case HDR:
+			tr = &g_transaction_data[HDR_TRAILER];
+			break;
+		case TIR:
+			tr = &g_transaction_data[TIR_TRAILER];
+			break;
+		case TDR:
+			tr = &g_transaction_data[TDR_TRAILER];
+			break;
+		default:
+			return -1;
 	}
 
-	if (data_p->bit_size){
-		size = (data_p->bit_size+7)/8;
+	if (jtag_poll_flush())
+		return -1;
 
-		if(data_p->tdi){
-			transacrtion_data_p->tdi = malloc(size);
-			memcpy(transacrtion_data_p->tdi, data_p->tdi, size);
-		}
-		if (data_p->tdo) {
-			transacrtion_data_p->tdo = malloc(size);
-			memcpy(transacrtion_data_p->tdo, data_p->tdo, size);
-		}
-		if (data_p->mask) {
-			if (transacrtion_data_p->mask)
-				free(transacrtion_data_p->mask);
-			transacrtion_data_p->mask = malloc(size);
-			memcpy(transacrtion_data_p->mask, data_p->mask, size);
-			transacrtion_data_p->mask_bit_size = data_p->bit_size;
-		}
+	if (bits) {
+		data = calloc(1, size);
+		if (!data)
+			return -1;
+		if (tdi)
+			memcpy(data, tdi, size);
 	}
-	transacrtion_data_p->bit_size = data_p->bit_size;
+
+	free((void *)tr->tdi);
+	jtag_set_scan(tr, bits, data, NULL, NULL);
 	return 0;
 }
 
-static int jtag_runtest_xfer(runtest_handler_data_t * data_p)
-{
-	struct jtag_run_test_idle runtest;
-	unsigned short delay;
-	unsigned short loop_index;
-	unsigned short ms_index;
-	unsigned short us_index;
-
-#if (JTAG_DEBUG != 0)
-	if (g_debug > 0) {
-		printf("RUNTEST_CMD\n");
-		if (data_p->new_state != (char)0xff)
-			printf("State:%d\n", data_p->new_state);
-
-		if (data_p->end_state != (char)0xff)
-			printf("End state:%d\n", data_p->end_state);
+/* the most TCKs one JTAG_IOCRUNTEST takes, from the width of its tck field */
+#define JTAG_RUNTEST_TCK_MAX	(~0ULL >> (64 - 8 * sizeof(((struct jtag_run_test_idle *)0)->tck)))
 
-		printf("TCK:%d\n", data_p->tck);
-	}
-#endif
-	if (data_p->tck){
-		runtest.mode = JTAG_XFER_SW_MODE;
-		runtest.endstate = JTAG_STATE_IDLE;
-		runtest.reset = 0;
-		runtest.tck = data_p->tck;
-		ioctl(g_JTAGFile, JTAG_IOCRUNTEST, &runtest);
-	}
+/*
+ * Waits up to JTAG_TCK_WAIT_MAX_US are clocked out as TCKs when the TCK
+ * frequency is known. Longer ones sleep on the host, the driver would keep
+ * the CPU busy for as long as it clocks.
+ */
+#define JTAG_TCK_WAIT_MAX_US	10000
 
-	if (data_p->wait){
-		delay = data_p->wait;
-
-		if ( delay & 0x8000 ) /*Test for unit*/
-		{
-			delay  &= ~0x8000; /*unit in milliseconds*/
-		} else { /*unit in microseconds*/
-			delay  = (unsigned short) (delay/1000); /*convert to milliseconds*/
-			if ( delay <= 0 ) {
-				delay  = 1; /*delay is 1 millisecond minimum*/
-			}
-		}
-#if (JTAG_DEBUG != 0)
-		if (g_debug > 0) {
-			printf("WAIT %d ms\n", delay);
-		}
-#endif
-		/*Users can replace the following section of code by their own*/
-			for( ms_index = 0; ms_index < delay; ms_index++)
-			{
-				/*Loop 1000 times to produce the milliseconds delay*/
-				for (us_index = 0; us_index < 1000; us_index++)
-				{ /*each loop should delay for 1 microsecond or more.*/
-					loop_index = 0;
-					do {
-						/*The NOP fakes the optimizer out so that it doesn't toss out the loop code entirely*/
-						asm("NOP");
-					}while (loop_index++ < ((DELAY_CPU_SCALE/8)+(+ ((DELAY_CPU_SCALE % 8) ? 1 : 0))));
-				}
-			}
+static int jtag_runtest_tck(int endstate, unsigned long long tck)
+{
+	unsigned int burst;
+
+	while (tck) {
+		burst = tck < JTAG_RUNTEST_TCK_MAX ? tck : JTAG_RUNTEST_TCK_MAX;
+		if (jtag_backend_run_test(endstate, burst))
+			return -1;
+		tck -= burst;
+		g_player_stats.runtests++;
 	}
-
 	return 0;
 }
 
-int jtag_cmd_handler(unsigned char cmd, char data)
+/*
+ * Move the TAP to state with a RUNTEST of no TCKs, the driver takes it
+ * there on the shortest path. Nothing is sent when the TAP is already
+ * there, unless it has to go through Test-Logic-Reset.
+ */
+static int jtag_player_move(int state, int reset)
 {
-	jtag_handler_data_t * data_p;
-	int ret = 0;
-
-	if (!g_direct_prog)
+	if (!reset && state == jtag_tap_state())
 		return 0;
 
-	data_p = &g_write_handler_data.sir_sdr_data;
-
-#if (JTAG_DEBUG != 0)
-	if (g_debug > 2) {
-		printf(">jtag_cmd_handler(%s) %x\n", write_handler_cmd_str[cmd], data);
-	}
-#endif
-	if (cmd == WRITE_HANDLER_INIT_CMD){
-		memset(data_p, 0, sizeof(*data_p));
-		data_p->cmd = data; /* SDR, SDR, HIR, HDR, TIR, TDR */
-		return 0;
-	} else if (cmd == WRITE_HANDLER_SEND_CMD){
-		switch (data_p->cmd){
-			case SIR:
-				jtag_set_transaction_data(data_p, SIR_DATA_TR);
-				ret = jtag_sir_xfer();
-				break;
-			case SDR:
-				jtag_set_transaction_data(data_p, SDR_DATA_TR);
-				ret = jtag_sdr_xfer();
-				break;
-			case HIR:
-				jtag_set_transaction_data(data_p, HIR_TRAILER);
-				break;
-			case HDR:
-				jtag_set_transaction_data(data_p, HDR_TRAILER);
-				break;
-			case TIR:
-				jtag_set_transaction_data(data_p, TIR_TRAILER);
-				break;
-			case TDR:
-				jtag_set_transaction_data(data_p, TDR_TRAILER);
-				break;
-			default:
-				ret = -1;
-				goto cleanup;
-		}
-		goto cleanup;
-	}
-
-	switch (data_p->state){
-		case JTAG_IDLE:
-#if (JTAG_DEBUG != 0)
-			if (g_debug > 2) {
-				printf("state:JTAG_IDLE\n");
-			}
-#endif
-			/* wait for opcode data*/
-			if (data == data_p->cmd)
-				data_p->state = JTAG_CMD;
+	jtag_tap_move(state, reset);
+	if (jtag_plan_active())
+		return jtag_plan_add_state(jtag_tap_endstate(state), reset);
 
-			break;
-		case JTAG_CMD:
-#if (JTAG_DEBUG != 0)
-			if (g_debug > 2) {
-				printf("state:JATG_CMD\n");
-			}
-#endif
-			/* receive num bites */
-
-			data_p->bit_size |= (data & 0x007f) << data_p->size_shift;
-			if (data & 0x0080){
-				data_p->size_shift+=7;
-			} else {
-				data_p->state = JTAG_TOKEN;
-			}
-#if (JTAG_DEBUG != 0)
-			if (g_debug > 2) {
-				printf("size:%d\n", data_p->bit_size);
-			}
-#endif
-			break;
-		case JTAG_TOKEN:
-#if (JTAG_DEBUG != 0)
-			if (g_debug > 2) {
-				printf("state:JTAG_TOKEN -> %s\n", get_token_str(data));
-			}
-#endif
-			data_p->state = JTAG_BYTE;
-			data_p->data_pos = 0;
-
-			switch (data){
-				case TDI:
-					data_p->tdi = malloc((data_p->bit_size+7)/8);
-					if (!data_p->tdi)
-						goto cleanup;
-					data_p->wr_data_p = data_p->tdi;
-					break;
-				case TDO:
-					data_p->tdo = malloc((data_p->bit_size+7)/8);
-					if (!data_p->tdo)
-						goto cleanup;
-					data_p->wr_data_p = data_p->tdo;
-					break;
-				case MASK:
-					data_p->mask = malloc((data_p->bit_size+7)/8);
-					if (!data_p->mask)
-						goto cleanup;
-					data_p->wr_data_p = data_p->mask;
-					break;
-				case CONTINUE:
-				case SMASK:
-				case CMASK:
-				case RMASK:
-				case DMASK:
-				case CRC:
-				case READ:
-				case ENDDATA:
-					break;
-				default:
-					data_p->state = JTAG_ERR;
-					ret = -1;
-					break;
-			}
-			break;
-		case JTAG_BYTE:
-			*data_p->wr_data_p++ = reverse_bits(data);
-			data_p->data_pos += 8;
+	if (reset)
+		return jtag_backend_reset(jtag_tap_endstate(state));
+	return jtag_backend_run_test(jtag_tap_endstate(state), 0);
+}
 
-			if (data_p->data_pos >= data_p->bit_size){
-#if (JTAG_DEBUG != 0)
-				if (g_debug > 2) {
-					printf("data_pos:%d size:%d\n", data_p->data_pos, data_p->bit_size);
-				}
-#endif
-				data_p->state = JTAG_TOKEN;
-			}
-			break;
-		case JTAG_ERR:
-			ret = -1;
-			break;
+/*
+ * STATE moves the TAP to an SVF stable state of vmopcode.h, ENDIR and
+ * ENDDR set the one every following SIR or SDR ends in.
+ */
+int jtag_player_state(unsigned char type, int state)
+{
+	if (jtag_poll_flush())
+		return -1;
+
+	switch (type) {
+		case STATE:
+			return jtag_player_move(jtag_tap_stable(state), state == RESET);
+		case ENDIR:
+			jtag_tap_set_end(1, jtag_tap_stable(state));
+			return 0;
+		case ENDDR:
+			jtag_tap_set_end(0, jtag_tap_stable(state));
+			return 0;
 		default:
-			ret = -1;
-			goto cleanup;
-			break;
+			return -1;
 	}
-
-	return ret;
-
-cleanup:
-	data_p->state = JTAG_IDLE;
-	if (data_p->tdi)
-		free(data_p->tdi);
-
-	if (data_p->tdo)
-		free(data_p->tdo);
-
-	if (data_p->mask)
-		free(data_p->mask);
-	memset(data_p, 0 ,sizeof(*data_p));
-	return ret;
 }
 
-int null_handler(unsigned char cmd, char data)
+/*
+ * Set the TCK frequency of the driver. The frequency the driver reports
+ * back is used to time the waits, it may round the one asked for. If the
+ * driver refuses it, it keeps its frequency and waits are slept on the
+ * host.
+ */
+int jtag_player_set_frequency(unsigned long hz)
 {
-	if (!g_direct_prog)
-		return 0;
+	unsigned int freq = hz;
+
+	if (jtag_poll_flush())
+		return -1;
+	if (jtag_plan_active())
+		return jtag_plan_add_freq(hz);
 
+	if (jtag_backend_set_freq(freq)) {
+		printf("Warning: the JTAG driver does not take a TCK of %lu Hz\n", hz);
+		g_player_freq = 0;
+		return 0;
+	}
+	if (jtag_backend_get_freq(&freq) || !freq)
+		freq = hz;
+	g_player_freq = freq;
 	return 0;
 }
 
-int runtest_handler(unsigned char cmd, char data)
+/*
+ * Run tck clocks in the given SVF stable state and wait at least usec
+ * microseconds. The first burst takes the TAP to the state, a RUNTEST
+ * without TCKs moves it on its own. RESET runs the TCKs in Run-Test/Idle
+ * after the reset. The TCKs take time too: with a known frequency a short
+ * wait is folded into the TCK burst, whichever is longer, and only the
+ * part of a long wait not covered by the TCKs is slept.
+ */
+int jtag_player_runtest(int state, unsigned long tck, unsigned long usec)
 {
-	runtest_handler_data_t * data_p;
-	int ret = 0;
-
-	if (!g_direct_prog)
-		return 0;
+	unsigned long long wait_tck;
+	unsigned long long tck_us;
+	int run = jtag_tap_stable(state);
+	int ret;
 
-	data_p = &g_write_handler_data.runtest_data;
 #if (JTAG_DEBUG != 0)
-	if (g_debug > 2) {
-		printf(">runtest_handler(%d) %x\n", cmd, data);
+	if (g_debug > 0) {
+		printf("RUNTEST_CMD\n");
+		printf("State:%d\n", state);
+		printf("TCK:%lu\n", tck);
+		printf("WAIT:%lu us\n", usec);
 	}
 #endif
-	if (cmd == WRITE_HANDLER_INIT_CMD){
-		memset(data_p, 0, sizeof(*data_p));
-		data_p->state = RUNTEST_IDLE;
-		data_p->new_state = 0xff;
-		data_p->end_state = 0xff;
-		return ret;
-	} else if (cmd == WRITE_HANDLER_SEND_CMD){
-		jtag_runtest_xfer(data_p);
+	ret = jtag_poll_runtest(state, tck, usec);
+	if (ret != JTAG_POLL_PASS)
 		return ret;
+
+	if (state == RESET || !tck) {
+		if (jtag_player_move(run, state == RESET))
+			return -1;
+	} else if (run != jtag_tap_state()) {
+		jtag_tap_move(run, 0);
 	}
 
-	switch (data_p->state){
-		case RUNTEST_IDLE:
-			data_p->cmd = data;
-			data_p->data = 0;
-			data_p->data_shift = 0;
-			data_p->state = RUNTEST_VAL;
-			break;
-		case RUNTEST_VAL:
-			data_p->data |= (data & 0x007f) << data_p->data_shift;
-			if (data & 0x0080){
-				data_p->data_shift+=7;
-			} else {
-				data_p->state = RUNTEST_IDLE;
-
-				switch (data_p->cmd){
-					case STATE:
-						if (data_p->new_state == (char)0xff) /*check for ENDSTATE command*/
-							data_p->new_state = data_p->data;
-						else
-							data_p->end_state = data_p->data;
-						break;
-					case TCK:
-						data_p->tck +=data_p->data;
-						break;
-					case WAIT:
-						data_p->wait +=data_p->data;
-						break;
-					default:
-						data_p->state = RUNTEST_ERR;
-						ret = -1;
-						break;
-				}
-			}
-#if JTAG_DEBUG	> 0
-			if (g_debug > 2) {
-				printf("data: %d\n", data_p->data);
-			}
-#endif
-			break;
-		case RUNTEST_ERR:
-			ret = -1;
-			break;
-		default:
-			data_p->state = RUNTEST_ERR;
-			ret = -1;
-			break;
+	if (jtag_plan_active())
+		return jtag_plan_add_runtest(jtag_tap_endstate(run), tck, usec);
+
+	if (g_player_freq && usec <= JTAG_TCK_WAIT_MAX_US) {
+		wait_tck = ((unsigned long long)usec * g_player_freq + 999999) / 1000000;
+		if (wait_tck > tck)
+			g_player_stats.tck_waits++;
+		return jtag_runtest_tck(jtag_tap_endstate(run), wait_tck > tck ? wait_tck : tck);
 	}
 
-	return ret;
+	if (jtag_runtest_tck(jtag_tap_endstate(run), tck))
+		return -1;
+	if (g_player_freq) {
+		tck_us = (unsigned long long)tck * 1000000 / g_player_freq;
+		usec = tck_us < usec ? usec - tck_us : 0;
+	}
+	return jtag_backend_wait(usec);
 }
 
 void jtag_handlers_init(void)
 {
 	memset(&g_transaction_data, 0 ,sizeof(g_transaction_data));
+	memset(&g_player_stats, 0 ,sizeof(g_player_stats));
+	jtag_tap_init();
+}
+
+void jtag_player_print_stats(void)
+{
+	printf("Scans shifted in place: %lu, with header/trailer: %lu, bits: %llu\n",
+			g_player_stats.in_place, g_player_stats.merged, g_player_stats.bits);
+	printf("Scans write only: %lu, fully verified: %lu, partially verified: %lu\n",
+			g_player_stats.verify[JTAG_VERIFY_NONE],
+			g_player_stats.verify[JTAG_VERIFY_FULL],
+			g_player_stats.verify[JTAG_VERIFY_PARTIAL]);
+	printf("RUNTEST bursts: %lu, waits clocked as TCK at %lu Hz: %lu\n",
+			g_player_stats.runtests, g_player_freq, g_player_stats.tck_waits);
+	jtag_tap_print_stats();
 }
@@ -34,17 +34,23 @@
 #ifndef __JTAG_HANDLERS__
 #define __JTAG_HANDLERS__
 
-#define WRITE_HANDLER_INIT_CMD	0
-#define WRITE_HANDLER_BYTE_CMD	1
-#define WRITE_HANDLER_SEND_CMD	2
-
-#define DELAY_CPU_SCALE	150
+/* jtag_player_chunk() flags */
+#define JTAG_CHUNK_FIRST	0x01	/* first chunk of a scan, shift the header */
+#define JTAG_CHUNK_LAST		0x02	/* last chunk, shift the trailer and go to ENDIR/ENDDR */
+#define JTAG_CHUNK_CHECK	0x04	/* compare TDO in the call, a mismatch returns 1 */
 
 void jtag_handlers_init(void);
-int null_handler(unsigned char cmd, char data);
-int frequency_handler(unsigned char cmd, char data);
-int runtest_handler(unsigned char cmd, char data);
-int jtag_cmd_handler(unsigned char cmd, char data);
+int jtag_player_sir(unsigned int bits, char *tdi,
+					const char *tdo, const char *mask);
+int jtag_player_sdr(unsigned int bits, char *tdi,
+					const char *tdo, const char *mask);
+int jtag_player_chunk(unsigned char type, unsigned int bits, char *tdi,
+					const char *tdo, const char *mask, int flags);
+int jtag_player_set_trailer(unsigned char type, unsigned int bits, const char *tdi);
+int jtag_player_state(unsigned char type, int state);
+int jtag_player_runtest(int state, unsigned long tck, unsigned long usec);
+int jtag_player_set_frequency(unsigned long hz);
+void jtag_player_print_stats(void);
 
 #endif /*__JTAG_HANDLERS__*/
 
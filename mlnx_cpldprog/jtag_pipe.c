@@ -0,0 +1,426 @@
+/*
+ * Copyright (c) 2017 Mellanox Technologies. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the names of the copyright holders nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * Alternatively, this software may be distributed under the terms of the
+ * GNU General Public License ("GPL") version 2 as published by the Free
+ * Software Foundation.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include "utilities.h"
+#include "vmopcode.h"
+#include "jtag_handlers.h"
+#include "jtag_vqueue.h"
+#include "jtag_pipe.h"
+
+#define JTAG_PIPE_SCAN		0
+#define JTAG_PIPE_TRAILER	1
+#define JTAG_PIPE_RUNTEST	2
+#define JTAG_PIPE_FREQ		3
+#define JTAG_PIPE_STATE		4
+
+/*
+ * A decoded command owns copies of its data, so the parser may reuse its
+ * buffers as soon as the command is queued. The buffers of a slot only
+ * grow, like the shift buffers of the player.
+ */
+typedef struct {
+	int op;
+	unsigned char type;	/* SIR/SDR, HIR/HDR/TIR/TDR or STATE/ENDIR/ENDDR */
+	unsigned int bits;
+	int line;
+	char *tdi;
+	char *tdo;
+	char *mask;
+	unsigned int size;	/* bytes allocated for each buffer */
+	int has_tdi;
+	int has_tdo;
+	int has_mask;
+	int state;
+	unsigned long tck;	/* RUNTEST TCK count or FREQ Hz */
+	unsigned long usec;
+} jtag_pipe_cmd_t;
+
+/*
+ * head is only written by the parser and tail only by the transport, a
+ * slot belongs to the parser from tail + depth on. A side that has to
+ * wait sleeps on cond, the other side only takes the lock to wake it up.
+ */
+static struct {
+	jtag_pipe_cmd_t *cmd;
+	unsigned int depth;
+	unsigned long head;	/* commands queued */
+	unsigned long tail;	/* commands handed to the player */
+	int stop;
+	int error;		/* first error of the transport, sticky */
+	int waiters;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	pthread_t thread;
+	int active;
+
+	/* printed with -d */
+	double start;
+	double wall;
+	double parser_wait;	/* on a full ring or a drain */
+	double transport_wait;	/* on an empty ring */
+	unsigned long full_waits;
+	unsigned long empty_waits;
+	unsigned long max_fill;
+} g_pipe;
+
+static double jtag_pipe_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static unsigned long jtag_pipe_load(unsigned long *index)
+{
+	return __atomic_load_n(index, __ATOMIC_SEQ_CST);
+}
+
+static int jtag_pipe_not_full(void)
+{
+	return g_pipe.head - jtag_pipe_load(&g_pipe.tail) < g_pipe.depth;
+}
+
+static int jtag_pipe_empty(void)
+{
+	return jtag_pipe_load(&g_pipe.tail) == g_pipe.head;
+}
+
+static int jtag_pipe_not_empty(void)
+{
+	return jtag_pipe_load(&g_pipe.head) != g_pipe.tail ||
+	       __atomic_load_n(&g_pipe.stop, __ATOMIC_SEQ_CST);
+}
+
+/*
+ * Sleep until ready() holds. The other side publishes its index before it
+ * looks at waiters, and waiters is raised before ready() is checked under
+ * the lock, so a wake up cannot be missed.
+ */
+static void jtag_pipe_wait(int (*ready)(void), unsigned long *waits, double *time)
+{
+	double t0;
+
+	if (ready())
+		return;
+
+	t0 = jtag_pipe_now();
+	pthread_mutex_lock(&g_pipe.lock);
+	__atomic_add_fetch(&g_pipe.waiters, 1, __ATOMIC_SEQ_CST);
+	while (!ready())
+		pthread_cond_wait(&g_pipe.cond, &g_pipe.lock);
+	__atomic_sub_fetch(&g_pipe.waiters, 1, __ATOMIC_SEQ_CST);
+	pthread_mutex_unlock(&g_pipe.lock);
+	(*waits)++;
+	*time += jtag_pipe_now() - t0;
+}
+
+static void jtag_pipe_wake(void)
+{
+	if (__atomic_load_n(&g_pipe.waiters, __ATOMIC_SEQ_CST)) {
+		pthread_mutex_lock(&g_pipe.lock);
+		pthread_cond_broadcast(&g_pipe.cond);
+		pthread_mutex_unlock(&g_pipe.lock);
+	}
+}
+
+static int jtag_pipe_exec(jtag_pipe_cmd_t *cmd)
+{
+	switch (cmd->op) {
+	case JTAG_PIPE_SCAN:
+		jtag_vqueue_set_line(cmd->line);
+		return jtag_player_chunk(cmd->type, cmd->bits,
+					 cmd->has_tdi ? cmd->tdi : NULL,
+					 cmd->has_tdo ? cmd->tdo : NULL,
+					 cmd->has_mask ? cmd->mask : NULL,
+					 JTAG_CHUNK_FIRST | JTAG_CHUNK_LAST);
+	case JTAG_PIPE_TRAILER:
+		return jtag_player_set_trailer(cmd->type, cmd->bits,
+					       cmd->has_tdi ? cmd->tdi : NULL);
+	case JTAG_PIPE_FREQ:
+		return jtag_player_set_frequency(cmd->tck);
+	case JTAG_PIPE_STATE:
+		return jtag_player_state(cmd->type, cmd->state);
+	default:
+		return jtag_player_runtest(cmd->state, cmd->tck, cmd->usec);
+	}
+}
+
+static void *jtag_pipe_transport(void *arg)
+{
+	unsigned long empty_waits = 0;
+	double wait = 0;
+	int error = 0;
+
+	for (;;) {
+		jtag_pipe_wait(jtag_pipe_not_empty, &empty_waits, &wait);
+		if (jtag_pipe_load(&g_pipe.head) == g_pipe.tail)
+			break;
+
+		/* after a failed command the rest is dropped, not sent to the device */
+		if (!error && jtag_pipe_exec(&g_pipe.cmd[g_pipe.tail % g_pipe.depth])) {
+			error = -1;
+			__atomic_store_n(&g_pipe.error, error, __ATOMIC_SEQ_CST);
+		}
+		__atomic_store_n(&g_pipe.tail, g_pipe.tail + 1, __ATOMIC_SEQ_CST);
+		jtag_pipe_wake();
+	}
+
+	g_pipe.empty_waits = empty_waits;
+	g_pipe.transport_wait = wait;
+	return NULL;
+}
+
+int jtag_pipe_start(unsigned int depth)
+{
+	memset(&g_pipe, 0, sizeof(g_pipe));
+	g_pipe.cmd = calloc(depth, sizeof(*g_pipe.cmd));
+	if (!g_pipe.cmd)
+		return OUT_OF_MEMORY;
+	g_pipe.depth = depth;
+
+	pthread_mutex_init(&g_pipe.lock, NULL);
+	pthread_cond_init(&g_pipe.cond, NULL);
+	if (pthread_create(&g_pipe.thread, NULL, jtag_pipe_transport, NULL)) {
+		pthread_cond_destroy(&g_pipe.cond);
+		pthread_mutex_destroy(&g_pipe.lock);
+		free(g_pipe.cmd);
+		return OUT_OF_MEMORY;
+	}
+	g_pipe.start = jtag_pipe_now();
+	g_pipe.active = 1;
+	return OK;
+}
+
+int jtag_pipe_active(void)
+{
+	return g_pipe.active;
+}
+
+static void jtag_pipe_copy(char *buf, int *has, const char *data, unsigned int bytes)
+{
+	*has = data != NULL;
+	if (data)
+		memcpy(buf, data, bytes);
+}
+
+/*
+ * Take the next free slot for a command of bits bits, waiting while the
+ * ring is full. Returns NULL if out of memory.
+ */
+static jtag_pipe_cmd_t *jtag_pipe_slot(int op, unsigned int bits)
+{
+	jtag_pipe_cmd_t *cmd;
+	unsigned int size = (bits + 7) / 8;
+
+	jtag_pipe_wait(jtag_pipe_not_full, &g_pipe.full_waits, &g_pipe.parser_wait);
+
+	cmd = &g_pipe.cmd[g_pipe.head % g_pipe.depth];
+	if (size > cmd->size) {
+		free(cmd->tdi);
+		free(cmd->tdo);
+		free(cmd->mask);
+		cmd->tdi = malloc(size);
+		cmd->tdo = malloc(size);
+		cmd->mask = malloc(size);
+		if (!cmd->tdi || !cmd->tdo || !cmd->mask) {
+			cmd->size = 0;
+			return NULL;
+		}
+		cmd->size = size;
+	}
+	cmd->op = op;
+	cmd->bits = bits;
+	return cmd;
+}
+
+/* Hand the command in the slot taken last to the transport. */
+static int jtag_pipe_push(void)
+{
+	unsigned long fill;
+
+	__atomic_store_n(&g_pipe.head, g_pipe.head + 1, __ATOMIC_SEQ_CST);
+	jtag_pipe_wake();
+
+	fill = g_pipe.head - jtag_pipe_load(&g_pipe.tail);
+	if (fill > g_pipe.max_fill)
+		g_pipe.max_fill = fill;
+	return __atomic_load_n(&g_pipe.error, __ATOMIC_SEQ_CST);
+}
+
+/*
+ * Queue a SIR or SDR, see jtag_player_sir(). The TDI of the caller is
+ * copied, so unlike with the player it is not overwritten by the TDO.
+ * Returns -1 if this or an earlier command failed.
+ */
+int jtag_pipe_scan(unsigned char type, unsigned int bits, char *tdi,
+		   const char *tdo, const char *mask, int line)
+{
+	jtag_pipe_cmd_t *cmd;
+	unsigned int bytes = (bits + 7) / 8;
+
+	if (!g_pipe.active) {
+		jtag_vqueue_set_line(line);
+		if (type == SIR)
+			return jtag_player_sir(bits, tdi, tdo, mask);
+		return jtag_player_sdr(bits, tdi, tdo, mask);
+	}
+
+	cmd = jtag_pipe_slot(JTAG_PIPE_SCAN, bits);
+	if (!cmd)
+		return -1;
+	cmd->type = type;
+	cmd->line = line;
+	jtag_pipe_copy(cmd->tdi, &cmd->has_tdi, tdi, bytes);
+	jtag_pipe_copy(cmd->tdo, &cmd->has_tdo, tdo, bytes);
+	jtag_pipe_copy(cmd->mask, &cmd->has_mask, tdo ? mask : NULL, bytes);
+	return jtag_pipe_push();
+}
+
+int jtag_pipe_set_trailer(unsigned char type, unsigned int bits, const char *tdi)
+{
+	jtag_pipe_cmd_t *cmd;
+
+	if (!g_pipe.active)
+		return jtag_player_set_trailer(type, bits, tdi);
+
+	cmd = jtag_pipe_slot(JTAG_PIPE_TRAILER, bits);
+	if (!cmd)
+		return -1;
+	cmd->type = type;
+	jtag_pipe_copy(cmd->tdi, &cmd->has_tdi, tdi, (bits + 7) / 8);
+	return jtag_pipe_push();
+}
+
+int jtag_pipe_state(unsigned char type, int state)
+{
+	jtag_pipe_cmd_t *cmd;
+
+	if (!g_pipe.active)
+		return jtag_player_state(type, state);
+
+	cmd = jtag_pipe_slot(JTAG_PIPE_STATE, 0);
+	if (!cmd)
+		return -1;
+	cmd->type = type;
+	cmd->state = state;
+	return jtag_pipe_push();
+}
+
+int jtag_pipe_runtest(int state, unsigned long tck, unsigned long usec)
+{
+	jtag_pipe_cmd_t *cmd;
+
+	if (!g_pipe.active)
+		return jtag_player_runtest(state, tck, usec);
+
+	cmd = jtag_pipe_slot(JTAG_PIPE_RUNTEST, 0);
+	if (!cmd)
+		return -1;
+	cmd->state = state;
+	cmd->tck = tck;
+	cmd->usec = usec;
+	return jtag_pipe_push();
+}
+
+int jtag_pipe_set_frequency(unsigned long hz)
+{
+	jtag_pipe_cmd_t *cmd;
+
+	if (!g_pipe.active)
+		return jtag_player_set_frequency(hz);
+
+	cmd = jtag_pipe_slot(JTAG_PIPE_FREQ, 0);
+	if (!cmd)
+		return -1;
+	cmd->tck = hz;
+	return jtag_pipe_push();
+}
+
+/*
+ * Wait until the transport has handed every queued command to the player,
+ * before the caller uses the player itself. Returns -1 if one failed.
+ */
+int jtag_pipe_drain(void)
+{
+	unsigned long drains = 0;
+
+	if (!g_pipe.active)
+		return 0;
+
+	jtag_pipe_wait(jtag_pipe_empty, &drains, &g_pipe.parser_wait);
+	return __atomic_load_n(&g_pipe.error, __ATOMIC_SEQ_CST);
+}
+
+/* Run the queued commands, none after a failed one, and stop the transport thread. */
+void jtag_pipe_stop(void)
+{
+	unsigned int i;
+
+	if (!g_pipe.active)
+		return;
+
+	__atomic_store_n(&g_pipe.stop, 1, __ATOMIC_SEQ_CST);
+	jtag_pipe_wake();
+	pthread_join(g_pipe.thread, NULL);
+	g_pipe.wall = jtag_pipe_now() - g_pipe.start;
+
+	pthread_cond_destroy(&g_pipe.cond);
+	pthread_mutex_destroy(&g_pipe.lock);
+	for (i = 0; i < g_pipe.depth; i++) {
+		free(g_pipe.cmd[i].tdi);
+		free(g_pipe.cmd[i].tdo);
+		free(g_pipe.cmd[i].mask);
+	}
+	free(g_pipe.cmd);
+	g_pipe.cmd = NULL;
+	g_pipe.active = 0;
+}
+
+/* How busy each stage was, the parser is waiting on a full ring or a drain. */
+void jtag_pipe_print_stats(void)
+{
+	if (!g_pipe.depth || g_pipe.wall <= 0)
+		return;
+
+	printf("Pipeline depth %u, commands: %lu, max fill: %lu\n",
+			g_pipe.depth, g_pipe.head, g_pipe.max_fill);
+	printf("  parser busy %5.1f%%, waited %lu times on a full ring\n",
+			100 * (1 - g_pipe.parser_wait / g_pipe.wall), g_pipe.full_waits);
+	printf("  transport busy %5.1f%%, waited %lu times on an empty ring\n",
+			100 * (1 - g_pipe.transport_wait / g_pipe.wall), g_pipe.empty_waits);
+}
@@ -0,0 +1,58 @@
+/*
+ * Copyright (c) 2017 Mellanox Technologies. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the names of the copyright holders nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * Alternatively, this software may be distributed under the terms of the
+ * GNU General Public License ("GPL") version 2 as published by the Free
+ * Software Foundation.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __JTAG_PIPE_H__
+#define __JTAG_PIPE_H__
+
+/*
+ * Pipeline between the SVF parser and the JTAG transport. The parser
+ * copies each decoded command into a bounded single producer, single
+ * consumer ring and goes on parsing, a transport thread hands the commands
+ * to the player. The parser only waits when the ring is full.
+ *
+ * Without jtag_pipe_start() the calls go straight to the player.
+ */
+#define JTAG_PIPE_MAX_DEPTH	1024
+
+int jtag_pipe_start(unsigned int depth);
+int jtag_pipe_active(void);
+int jtag_pipe_scan(unsigned char type, unsigned int bits, char *tdi,
+		   const char *tdo, const char *mask, int line);
+int jtag_pipe_set_trailer(unsigned char type, unsigned int bits, const char *tdi);
+int jtag_pipe_state(unsigned char type, int state);
+int jtag_pipe_runtest(int state, unsigned long tck, unsigned long usec);
+int jtag_pipe_set_frequency(unsigned long hz);
+int jtag_pipe_drain(void);
+void jtag_pipe_stop(void);
+void jtag_pipe_print_stats(void);
+
+#endif /*__JTAG_PIPE_H__*/
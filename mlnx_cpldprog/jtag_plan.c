@@ -0,0 +1,636 @@
+/*
+ * Copyright (c) 2017 Mellanox Technologies. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the names of the copyright holders nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * Alternatively, this software may be distributed under the terms of the
+ * GNU General Public License ("GPL") version 2 as published by the Free
+ * Software Foundation.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <uapi/linux/jtag.h>
+#include "utilities.h"
+#include "jtag_handlers.h"
+#include "jtag_plan.h"
+#include "jtag_verify.h"
+#include "jtag_backend.h"
+
+#define FNV_OFFSET_BASIS	0xcbf29ce484222325ULL
+#define FNV_PRIME		0x100000001b3ULL
+
+extern int g_iSVFLineIndex;
+void print_progress(unsigned long pos, unsigned long total);
+
+/* plan being compiled */
+static FILE *g_plan_file;
+static jplan_header_t g_plan_hdr;
+
+static uint64_t jtag_plan_hash(uint64_t hash, const void *data, size_t len)
+{
+	const unsigned char *p = data;
+
+	while (len--) {
+		hash ^= *p++;
+		hash *= FNV_PRIME;
+	}
+	return hash;
+}
+
+static int jtag_plan_write(const void *data, size_t len)
+{
+	if (fwrite(data, 1, len, g_plan_file) != len)
+		return FILE_ERROR;
+	g_plan_hdr.hash = jtag_plan_hash(g_plan_hdr.hash, data, len);
+	g_plan_hdr.data_size += len;
+	return OK;
+}
+
+static unsigned long jtag_plan_scan_payload(unsigned int bits, int flags)
+{
+	unsigned long len = (bits + 7) / 8;
+
+	if (flags & JPLAN_F_VERIFY)
+		len *= 3;
+	return (len + JPLAN_ALIGN - 1) & ~(unsigned long)(JPLAN_ALIGN - 1);
+}
+
+/* Bytes after the record, for REPEAT its jplan_repeat_t must follow it. */
+static unsigned long jtag_plan_payload(const jplan_record_t *rec)
+{
+	const jplan_repeat_t *repeat;
+	unsigned long len;
+
+	switch (rec->op) {
+	case JPLAN_OP_SIR:
+	case JPLAN_OP_SDR:
+		return jtag_plan_scan_payload(rec->bits, rec->flags);
+	case JPLAN_OP_REPEAT:
+		repeat = (const jplan_repeat_t *)(rec + 1);
+		len = sizeof(*repeat) + repeat->count * jtag_plan_scan_payload(rec->bits, rec->flags);
+		if (rec->flags & JPLAN_F_SIR)
+			len += jtag_plan_scan_payload(repeat->sir_bits, 0);
+		return len;
+	default:
+		return 0;
+	}
+}
+
+/*
+ * Records are held back while they may still be part of a run that is
+ * compiled into a REPEAT, with their payload as it is written to the file.
+ */
+typedef struct {
+	jplan_record_t rec;
+	unsigned long data;	/* offset of the payload in g_plan_run.buf */
+} jplan_pending_t;
+
+static struct {
+	jplan_pending_t *recs;
+	unsigned long count;
+	unsigned long max;
+	unsigned char *buf;
+	unsigned long used;
+	unsigned long size;
+	unsigned long units;	/* repetitions of the first unit found so far */
+
+	/* printed when the plan is closed */
+	unsigned long repeats;
+	unsigned long long rows;
+} g_plan_run;
+
+static int jtag_plan_write_pending(unsigned long i)
+{
+	jplan_pending_t *pend = &g_plan_run.recs[i];
+	int rc;
+
+	rc = jtag_plan_write(&pend->rec, sizeof(pend->rec));
+	if (!rc)
+		rc = jtag_plan_write(g_plan_run.buf + pend->data, jtag_plan_payload(&pend->rec));
+	if (!rc)
+		g_plan_hdr.num_records++;
+	return rc;
+}
+
+/* Forget the first n pending records, they are in the file. */
+static void jtag_plan_drop(unsigned long n)
+{
+	unsigned long shift = n < g_plan_run.count ? g_plan_run.recs[n].data : g_plan_run.used;
+	unsigned long i;
+
+	for (i = n; i < g_plan_run.count; i++) {
+		g_plan_run.recs[i - n] = g_plan_run.recs[i];
+		g_plan_run.recs[i - n].data -= shift;
+	}
+	memmove(g_plan_run.buf, g_plan_run.buf + shift, g_plan_run.used - shift);
+	g_plan_run.used -= shift;
+	g_plan_run.count -= n;
+	g_plan_run.units = 0;
+}
+
+/* Records of a unit that starts with the first pending record, 0 if none does. */
+static unsigned int jtag_plan_unit(void)
+{
+	const jplan_pending_t *recs = g_plan_run.recs;
+	unsigned int len;
+
+	if (recs[0].rec.op == JPLAN_OP_SIR && !(recs[0].rec.flags & JPLAN_F_VERIFY))
+		len = 3;
+	else if (recs[0].rec.op == JPLAN_OP_SDR)
+		len = 2;
+	else
+		return 0;
+
+	if (g_plan_run.count > len - 2 && recs[len - 2].rec.op != JPLAN_OP_SDR)
+		return 0;
+	if (g_plan_run.count > len - 1 && recs[len - 1].rec.op != JPLAN_OP_RUNTEST)
+		return 0;
+	return len;
+}
+
+/*
+ * Does pending record i repeat record j of the first unit, in unit
+ * number i / len? The SIR is shifted from a template, its TDI must be the
+ * same every time. The SDR lines must be evenly spaced, for the errors
+ * of a row to be reported at its line.
+ */
+static int jtag_plan_repeats(unsigned long i, unsigned int len)
+{
+	const jplan_pending_t *recs = g_plan_run.recs;
+	const jplan_record_t *a = &recs[i % len].rec;
+	const jplan_record_t *b = &recs[i].rec;
+	unsigned long step;
+
+	if (a->op != b->op || a->endstate != b->endstate || a->flags != b->flags ||
+	    a->bits != b->bits || a->usec != b->usec)
+		return 0;
+	if (a->op == JPLAN_OP_SIR)
+		return !memcmp(g_plan_run.buf + recs[i % len].data, g_plan_run.buf + recs[i].data,
+			       jtag_plan_payload(a));
+	if (a->op == JPLAN_OP_SDR && i >= 2 * len) {
+		step = recs[len + i % len].rec.line - a->line;
+		return b->line == a->line + i / len * step;
+	}
+	return 1;
+}
+
+/* Write the first n units of len records as one REPEAT. */
+static int jtag_plan_write_repeat(unsigned int len, unsigned long n)
+{
+	const jplan_pending_t *recs = g_plan_run.recs;
+	const jplan_pending_t *sdr = &recs[len - 2];
+	const jplan_record_t *runtest = &recs[len - 1].rec;
+	unsigned long row = jtag_plan_scan_payload(sdr->rec.bits, sdr->rec.flags);
+	jplan_repeat_t repeat;
+	jplan_record_t rec;
+	unsigned long i;
+	int rc;
+
+	rec = sdr->rec;
+	rec.op = JPLAN_OP_REPEAT;
+	rec.usec = runtest->usec;
+	memset(&repeat, 0, sizeof(repeat));
+	repeat.count = n;
+	repeat.tck = runtest->bits;
+	repeat.run_endstate = runtest->endstate;
+	repeat.line_step = recs[len + len - 2].rec.line - sdr->rec.line;
+	if (len == 3) {
+		rec.flags |= JPLAN_F_SIR;
+		repeat.sir_endstate = recs[0].rec.endstate;
+		repeat.sir_bits = recs[0].rec.bits;
+	}
+
+	rc = jtag_plan_write(&rec, sizeof(rec));
+	if (!rc)
+		rc = jtag_plan_write(&repeat, sizeof(repeat));
+	if (!rc && len == 3)
+		rc = jtag_plan_write(g_plan_run.buf + recs[0].data, jtag_plan_payload(&recs[0].rec));
+	for (i = 0; i < n && !rc; i++)
+		rc = jtag_plan_write(g_plan_run.buf + recs[i * len + len - 2].data, row);
+	if (rc)
+		return rc;
+
+	g_plan_hdr.num_records++;
+	g_plan_run.repeats++;
+	g_plan_run.rows += n;
+	return OK;
+}
+
+/*
+ * Write out the pending records that can no longer become part of a run,
+ * and runs that have ended. With final everything is written.
+ */
+static int jtag_plan_match(int final)
+{
+	unsigned long i;
+	unsigned int len;
+	int rc;
+
+	while (g_plan_run.count) {
+		len = jtag_plan_unit();
+		if (len && g_plan_run.count < len && !final)
+			return OK;
+		if (len && g_plan_run.count >= len) {
+			if (!g_plan_run.units)
+				g_plan_run.units = 1;
+			for (i = g_plan_run.units * len; i < g_plan_run.count; i++) {
+				if (!jtag_plan_repeats(i, len))
+					break;
+				if (i % len == len - 1)
+					g_plan_run.units = i / len + 1;
+			}
+			/* all of it repeats so far, the run may go on */
+			if (i == g_plan_run.count && !final)
+				return OK;
+			if (g_plan_run.units >= JPLAN_REPEAT_MIN) {
+				rc = jtag_plan_write_repeat(len, g_plan_run.units);
+				if (rc)
+					return rc;
+				jtag_plan_drop(g_plan_run.units * len);
+				continue;
+			}
+		}
+		rc = jtag_plan_write_pending(0);
+		if (rc)
+			return rc;
+		jtag_plan_drop(1);
+	}
+	return OK;
+}
+
+/* Hold a record and its payload back, payload parts may be NULL. */
+static int jtag_plan_add(const jplan_record_t *rec, const char *tdi, const char *tdo,
+			 const char *mask)
+{
+	unsigned long bytes = (rec->bits + 7) / 8;
+	unsigned long payload = jtag_plan_payload(rec);
+	jplan_pending_t *pend;
+	unsigned char *data;
+	void *grow;
+
+	if (g_plan_run.count == g_plan_run.max) {
+		grow = realloc(g_plan_run.recs, (g_plan_run.max * 2 + 64) * sizeof(*g_plan_run.recs));
+		if (!grow)
+			return OUT_OF_MEMORY;
+		g_plan_run.recs = grow;
+		g_plan_run.max = g_plan_run.max * 2 + 64;
+	}
+	if (g_plan_run.used + payload > g_plan_run.size) {
+		grow = realloc(g_plan_run.buf, (g_plan_run.used + payload) * 2);
+		if (!grow)
+			return OUT_OF_MEMORY;
+		g_plan_run.buf = grow;
+		g_plan_run.size = (g_plan_run.used + payload) * 2;
+	}
+
+	pend = &g_plan_run.recs[g_plan_run.count++];
+	pend->rec = *rec;
+	pend->data = g_plan_run.used;
+	data = g_plan_run.buf + g_plan_run.used;
+	memset(data, 0, payload);
+	if (tdi)
+		memcpy(data, tdi, bytes);
+	if (tdo) {
+		memcpy(data + bytes, tdo, bytes);
+		memcpy(data + 2 * bytes, mask, bytes);
+	}
+	g_plan_run.used += payload;
+	return jtag_plan_match(0);
+}
+
+/*
+ * Start compiling a plan. While the plan is open the JTAG handlers hand
+ * their transfers to jtag_plan_add_*() instead of the driver.
+ */
+int jtag_plan_create(const char *path)
+{
+	g_plan_file = fopen(path, "wb");
+	if (!g_plan_file)
+		return FILE_NOT_FOUND;
+
+	memset(&g_plan_hdr, 0, sizeof(g_plan_hdr));
+	memcpy(g_plan_hdr.magic, JPLAN_MAGIC, sizeof(g_plan_hdr.magic));
+	g_plan_hdr.version = JPLAN_VERSION;
+	g_plan_hdr.header_size = sizeof(g_plan_hdr);
+	g_plan_hdr.hash = FNV_OFFSET_BASIS;
+
+	/* the header is written again with the totals when the plan is closed */
+	if (fwrite(&g_plan_hdr, 1, sizeof(g_plan_hdr), g_plan_file) != sizeof(g_plan_hdr)) {
+		fclose(g_plan_file);
+		g_plan_file = NULL;
+		return FILE_ERROR;
+	}
+	return OK;
+}
+
+int jtag_plan_active(void)
+{
+	return g_plan_file != NULL;
+}
+
+/*
+ * Append a scan. tdi, tdo and mask hold bits bits each, tdo and mask are
+ * either both present or both NULL.
+ */
+int jtag_plan_add_scan(int op, int endstate, unsigned int bits,
+		       const char *tdi, const char *tdo, const char *mask)
+{
+	jplan_record_t rec;
+
+	memset(&rec, 0, sizeof(rec));
+	rec.op = op;
+	rec.endstate = endstate;
+	rec.flags = tdo ? JPLAN_F_VERIFY : 0;
+	rec.line = g_iSVFLineIndex;
+	rec.bits = bits;
+
+	if (bits > g_plan_hdr.max_bits)
+		g_plan_hdr.max_bits = bits;
+	return jtag_plan_add(&rec, tdi, tdo, mask);
+}
+
+int jtag_plan_add_runtest(int endstate, unsigned int tck, unsigned long usec)
+{
+	jplan_record_t rec;
+
+	memset(&rec, 0, sizeof(rec));
+	rec.op = JPLAN_OP_RUNTEST;
+	rec.endstate = endstate;
+	rec.line = g_iSVFLineIndex;
+	rec.bits = tck;
+	rec.usec = usec;
+	return jtag_plan_add(&rec, NULL, NULL, NULL);
+}
+
+int jtag_plan_add_freq(unsigned long hz)
+{
+	jplan_record_t rec;
+
+	memset(&rec, 0, sizeof(rec));
+	rec.op = JPLAN_OP_FREQ;
+	rec.line = g_iSVFLineIndex;
+	rec.bits = hz;
+	return jtag_plan_add(&rec, NULL, NULL, NULL);
+}
+
+int jtag_plan_add_state(int endstate, int reset)
+{
+	jplan_record_t rec;
+
+	memset(&rec, 0, sizeof(rec));
+	rec.op = JPLAN_OP_STATE;
+	rec.endstate = endstate;
+	rec.flags = reset ? JPLAN_F_RESET : 0;
+	rec.line = g_iSVFLineIndex;
+	return jtag_plan_add(&rec, NULL, NULL, NULL);
+}
+
+/* Write the pending records and the final header and close the plan. */
+int jtag_plan_close(void)
+{
+	int rc;
+
+	if (!g_plan_file)
+		return OK;
+
+	rc = jtag_plan_match(1);
+	if (fseek(g_plan_file, 0, SEEK_SET) ||
+	    fwrite(&g_plan_hdr, 1, sizeof(g_plan_hdr), g_plan_file) != sizeof(g_plan_hdr))
+		rc = FILE_ERROR;
+	if (fclose(g_plan_file))
+		rc = FILE_ERROR;
+	g_plan_file = NULL;
+
+	if (!rc) {
+		printf("Plan: %llu records, %llu bytes, hash %016llx\n",
+		       (unsigned long long)g_plan_hdr.num_records,
+		       (unsigned long long)g_plan_hdr.data_size,
+		       (unsigned long long)g_plan_hdr.hash);
+		if (g_plan_run.repeats)
+			printf("Plan: %lu repeats of %llu rows\n",
+			       g_plan_run.repeats, g_plan_run.rows);
+	}
+	free(g_plan_run.recs);
+	free(g_plan_run.buf);
+	memset(&g_plan_run, 0, sizeof(g_plan_run));
+	return rc;
+}
+
+static int jtag_plan_check(const unsigned char *map, unsigned long size)
+{
+	const jplan_header_t *hdr = (const jplan_header_t *)map;
+
+	if (size < sizeof(*hdr) ||
+	    memcmp(hdr->magic, JPLAN_MAGIC, sizeof(hdr->magic)) ||
+	    hdr->version < 1 || hdr->version > JPLAN_VERSION ||
+	    hdr->header_size != sizeof(*hdr) ||
+	    hdr->data_size != size - sizeof(*hdr))
+		return FILE_NOT_VALID;
+
+	if (jtag_plan_hash(FNV_OFFSET_BASIS, map + sizeof(*hdr), hdr->data_size) != hdr->hash)
+		return FILE_NOT_VALID;
+	return OK;
+}
+
+/*
+ * Play a REPEAT at p, its jplan_repeat_t. The xfers are set up once, the
+ * SIR template is copied to its own buffer before each row because the
+ * driver stores the captured bits in the shift buffer.
+ */
+static int jtag_plan_play_repeat(const jplan_record_t *rec, unsigned char *p,
+				 const unsigned char *map, unsigned long size)
+{
+	const jplan_repeat_t *repeat = (const jplan_repeat_t *)p;
+	unsigned long bytes = (rec->bits + 7) / 8;
+	unsigned long row = jtag_plan_scan_payload(rec->bits, rec->flags);
+	unsigned long sir_bytes = (repeat->sir_bits + 7) / 8;
+	struct jtag_xfer sir, sdr;
+	unsigned char *template = NULL;
+	unsigned char *sir_buf = NULL;
+	unsigned long i;
+	int rc = OK;
+
+	p += sizeof(*repeat);
+	if (rec->flags & JPLAN_F_SIR) {
+		template = p;
+		p += jtag_plan_scan_payload(repeat->sir_bits, 0);
+		sir_buf = malloc(sir_bytes ? sir_bytes : 1);
+		if (!sir_buf)
+			return OUT_OF_MEMORY;
+		memset(&sir, 0, sizeof(sir));
+		sir.mode = JTAG_XFER_SW_MODE;
+		sir.type = JTAG_SIR_XFER;
+		sir.direction = JTAG_WRITE_XFER;
+		sir.endstate = repeat->sir_endstate;
+	}
+	memset(&sdr, 0, sizeof(sdr));
+	sdr.mode = JTAG_XFER_SW_MODE;
+	sdr.type = JTAG_SDR_XFER;
+	sdr.direction = (rec->flags & JPLAN_F_VERIFY) ? JTAG_READ_XFER : JTAG_WRITE_XFER;
+	sdr.endstate = rec->endstate;
+
+	for (i = 0; i < repeat->count && rc == OK; i++, p += row) {
+		g_iSVFLineIndex = rec->line + i * repeat->line_step;
+		if (sir_buf) {
+			memcpy(sir_buf, template, sir_bytes);
+			sir.length = repeat->sir_bits;
+			sir.tdio = (__u64)(uintptr_t)sir_buf;
+			if (jtag_backend_xfer(&sir)) {
+				rc = FILE_ERROR;
+				break;
+			}
+		}
+		sdr.length = rec->bits;
+		sdr.tdio = (__u64)(uintptr_t)p;
+		if (jtag_backend_xfer(&sdr))
+			rc = FILE_ERROR;
+		else if ((rec->flags & JPLAN_F_VERIFY) &&
+			 jtag_verify(p, p + bytes, p + 2 * bytes, rec->bits) >= 0)
+			rc = -1;
+		if (rc == OK && repeat->tck && jtag_backend_run_test(repeat->run_endstate, repeat->tck))
+			rc = FILE_ERROR;
+		if (rc == OK && rec->usec && jtag_backend_wait(rec->usec))
+			rc = FILE_ERROR;
+		print_progress(p - map, size);
+	}
+
+	free(sir_buf);
+	return rc;
+}
+
+/*
+ * Replay a compiled plan on the JTAG device. The plan is mapped private
+ * and writable: the driver stores captured TDO in place of the TDI, the
+ * pages it writes to are copied on write and the file is not modified.
+ */
+int jtag_plan_play(const char *path)
+{
+	const jplan_header_t *hdr;
+	struct jtag_xfer xfer;
+	jplan_record_t *rec;
+	unsigned char *map, *p, *end;
+	unsigned long bytes, payload;
+	unsigned long long n;
+	struct stat st;
+	int rc = OK;
+	int fd;
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return FILE_NOT_FOUND;
+	if (fstat(fd, &st) < 0 || st.st_size < (off_t)sizeof(*hdr)) {
+		close(fd);
+		return FILE_NOT_VALID;
+	}
+	map = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED)
+		return FILE_NOT_VALID;
+
+	rc = jtag_plan_check(map, st.st_size);
+	if (rc) {
+		munmap(map, st.st_size);
+		return rc;
+	}
+
+	hdr = (const jplan_header_t *)map;
+	p = map + hdr->header_size;
+	end = p + hdr->data_size;
+	for (n = 0; n < hdr->num_records && rc == OK; n++) {
+		if ((unsigned long)(end - p) < sizeof(*rec)) {
+			rc = FILE_NOT_VALID;
+			break;
+		}
+		rec = (jplan_record_t *)p;
+		p += sizeof(*rec);
+		if (rec->op == JPLAN_OP_REPEAT && (unsigned long)(end - p) < sizeof(jplan_repeat_t)) {
+			rc = FILE_NOT_VALID;
+			break;
+		}
+		payload = jtag_plan_payload(rec);
+		if ((unsigned long)(end - p) < payload) {
+			rc = FILE_NOT_VALID;
+			break;
+		}
+		g_iSVFLineIndex = rec->line;
+
+		switch (rec->op) {
+		case JPLAN_OP_SIR:
+		case JPLAN_OP_SDR:
+			bytes = (rec->bits + 7) / 8;
+			memset(&xfer, 0, sizeof(xfer));
+			xfer.mode = JTAG_XFER_SW_MODE;
+			xfer.type = rec->op == JPLAN_OP_SIR ? JTAG_SIR_XFER : JTAG_SDR_XFER;
+			xfer.direction = (rec->flags & JPLAN_F_VERIFY) ? JTAG_READ_XFER : JTAG_WRITE_XFER;
+			xfer.endstate = rec->endstate;
+			xfer.length = rec->bits;
+			xfer.tdio = (__u64)(uintptr_t)p;
+			if (jtag_backend_xfer(&xfer))
+				rc = FILE_ERROR;
+			else if ((rec->flags & JPLAN_F_VERIFY) &&
+			    jtag_verify(p, p + bytes, p + 2 * bytes, rec->bits) >= 0)
+				rc = -1;
+			break;
+		case JPLAN_OP_RUNTEST:
+			if (rec->bits && jtag_backend_run_test(rec->endstate, rec->bits))
+				rc = FILE_ERROR;
+			else if (rec->usec && jtag_backend_wait(rec->usec))
+				rc = FILE_ERROR;
+			break;
+		case JPLAN_OP_STATE:
+			if (rec->flags & JPLAN_F_RESET) {
+				if (jtag_backend_reset(rec->endstate))
+					rc = FILE_ERROR;
+			} else if (jtag_backend_run_test(rec->endstate, 0)) {
+				rc = FILE_ERROR;
+			}
+			break;
+		case JPLAN_OP_FREQ:
+			if (jtag_backend_set_freq(rec->bits))
+				rc = FILE_ERROR;
+			break;
+		case JPLAN_OP_REPEAT:
+			rc = jtag_plan_play_repeat(rec, p, map, st.st_size);
+			break;
+		default:
+			rc = FILE_NOT_VALID;
+			break;
+		}
+		p += payload;
+		print_progress(p - map, st.st_size);
+	}
+	printf("\n");
+
+	munmap(map, st.st_size);
+	return rc;
+}
@@ -0,0 +1,126 @@
+/*
+ * Copyright (c) 2017 Mellanox Technologies. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the names of the copyright holders nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * Alternatively, this software may be distributed under the terms of the
+ * GNU General Public License ("GPL") version 2 as published by the Free
+ * Software Foundation.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef __JTAG_PLAN_H__
+#define __JTAG_PLAN_H__
+
+#include <stdint.h>
+
+/*
+ * A JTAG execution plan (.jplan) is the sequence of driver transfers that
+ * direct programming of a set of SVF files performs, compiled once with
+ * -plan and replayed with -play. Scans are stored exactly as they are
+ * handed to the driver, with the header and trailer bits of the chain
+ * already merged in and TDO/MASK aligned to the same bit positions, so
+ * the replay does no parsing or bit shuffling at all.
+ *
+ * The file is a jplan_header_t followed by num_records records. Each
+ * record is a jplan_record_t; scans are followed by the TDI bytes and,
+ * with JPLAN_F_VERIFY, by the expected TDO and the MASK bytes, padded to
+ * JPLAN_ALIGN. All fields are in host byte order, the build host and the
+ * BMC are both little endian.
+ *
+ * Runs of at least JPLAN_REPEAT_MIN repetitions of the same SDR and
+ * RUNTEST, optionally after the same SIR, as vendor SVFs program and read
+ * flash rows with, are compiled into one JPLAN_OP_REPEAT record: the
+ * record of the SDR, a jplan_repeat_t, the TDI of the SIR if there is one
+ * and then the table of the TDI (and TDO and MASK) of each row, every
+ * entry padded to JPLAN_ALIGN. The plan is played the same either way.
+ */
+
+#define JPLAN_MAGIC		"JPLAN\0\r\n"
+#define JPLAN_VERSION		2	/* 2 adds JPLAN_OP_REPEAT */
+#define JPLAN_ALIGN		8
+
+/* record opcodes */
+#define JPLAN_OP_SIR		1
+#define JPLAN_OP_SDR		2
+#define JPLAN_OP_RUNTEST	3
+#define JPLAN_OP_FREQ		4
+#define JPLAN_OP_STATE		5	/* move the TAP to endstate */
+#define JPLAN_OP_REPEAT		6	/* [SIR] SDR RUNTEST over a table of rows */
+
+/* record flags */
+#define JPLAN_F_VERIFY		0x01	/* TDO and MASK follow the TDI */
+#define JPLAN_F_RESET		0x02	/* STATE through Test-Logic-Reset */
+#define JPLAN_F_SIR		0x04	/* REPEAT shifts the SIR before each row */
+
+#define JPLAN_REPEAT_MIN	4
+
+typedef struct {
+	char magic[8];
+	uint32_t version;
+	uint32_t header_size;
+	uint64_t num_records;
+	uint64_t data_size;	/* bytes of records after the header */
+	uint64_t hash;		/* FNV-1a of the records */
+	uint32_t max_bits;	/* longest scan */
+	uint32_t reserved[5];
+} jplan_header_t;
+
+typedef struct {
+	uint8_t op;
+	uint8_t endstate;	/* enum jtag_endstate */
+	uint8_t flags;
+	uint8_t reserved;
+	uint32_t line;		/* SVF line the record was compiled from */
+	uint32_t bits;		/* scan length, RUNTEST TCK count or FREQ Hz */
+	uint32_t usec;		/* RUNTEST wait */
+} jplan_record_t;
+
+/*
+ * Follows a JPLAN_OP_REPEAT record, whose bits, endstate and JPLAN_F_VERIFY
+ * are those of the SDR of every row and usec the wait of the RUNTEST.
+ */
+typedef struct {
+	uint32_t count;		/* rows */
+	uint32_t tck;		/* RUNTEST */
+	uint8_t run_endstate;
+	uint8_t sir_endstate;
+	uint8_t reserved[2];
+	uint32_t sir_bits;
+	uint32_t line_step;	/* SVF lines from the SDR of a row to the next */
+	uint32_t reserved2;
+} jplan_repeat_t;
+
+int jtag_plan_create(const char *path);
+int jtag_plan_active(void);
+int jtag_plan_add_scan(int op, int endstate, unsigned int bits,
+		       const char *tdi, const char *tdo, const char *mask);
+int jtag_plan_add_runtest(int endstate, unsigned int tck, unsigned long usec);
+int jtag_plan_add_freq(unsigned long hz);
+int jtag_plan_add_state(int endstate, int reset);
+int jtag_plan_close(void);
+int jtag_plan_play(const char *path);
+
+#endif /*__JTAG_PLAN_H__*/
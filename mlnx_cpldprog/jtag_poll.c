@@ -0,0 +1,530 @@
+/*
+ * Copyright (c) 2017 Mellanox Technologies. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the names of the copyright holders nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * Alternatively, this software may be distributed under the terms of the
+ * GNU General Public License ("GPL") version 2 as published by the Free
+ * Software Foundation.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "vmopcode.h"
+#include "jtag_handlers.h"
+#include "jtag_plan.h"
+#include "jtag_poll.h"
+
+/*
+ * Status registers the busy bit of a device is read from: the SIR that
+ * selects the register and the length of the SDR that reads it.
+ */
+typedef struct {
+	const char *name;
+	unsigned int ir_bits;
+	unsigned int ir;
+	unsigned int dr_bits;
+	unsigned int busy_bit;
+} jtag_poll_rule_t;
+
+static const jtag_poll_rule_t g_poll_rules[] = {
+	/* Lattice MachXO2, MachXO3, ECP5: 1 while the flash is busy */
+	{ "LSC_CHECK_BUSY",	8, 0xF0, 1, 0 },
+	/* Lattice MachXO2, MachXO3, ECP5: Busy bit of the status register */
+	{ "LSC_READ_STATUS",	8, 0x3C, 32, 12 },
+};
+
+#define JTAG_POLL_RULES	(sizeof(g_poll_rules) / sizeof(g_poll_rules[0]))
+
+/*
+ * Instructions that finish programming a device. The deferred TDO checks
+ * must pass before one is shifted, so that a device whose verify failed
+ * is not switched to the new pattern. The same opcode of another device
+ * only costs an early checkpoint.
+ */
+typedef struct {
+	const char *name;
+	unsigned int ir_bits;
+	unsigned int ir;
+} jtag_poll_checkpoint_t;
+
+static const jtag_poll_checkpoint_t g_poll_checkpoints[] = {
+	/* Lattice MachXO2, MachXO3, ECP5: leave programming mode */
+	{ "ISC_DISABLE",	8, 0x26 },
+	/* Lattice MachXO2, MachXO3, ECP5: set the DONE bit */
+	{ "ISC_PROGRAM_DONE",	8, 0x5E },
+};
+
+#define JTAG_POLL_CHECKPOINTS	(sizeof(g_poll_checkpoints) / sizeof(g_poll_checkpoints[0]))
+
+enum {
+	JTAG_LOOP_RUNTEST,
+	JTAG_LOOP_STATE,
+	JTAG_LOOP_SCAN,
+};
+
+/* a command of a loop body, the scan data is copied */
+typedef struct {
+	int op;
+	int state;
+	unsigned long tck;
+	unsigned long usec;
+	unsigned char type;
+	unsigned int bits;
+	char *tdi;
+	char *tdo;
+	char *mask;
+	int line;
+} jtag_loop_op_t;
+
+static struct {
+	unsigned long count;
+	jtag_loop_op_t *ops;
+	unsigned int num_ops;
+	unsigned int max_ops;
+	char *shift;			/* the TDI of a scan, shifted in place */
+	unsigned int shift_size;
+} g_loop;
+
+static struct {
+	int enabled;
+	int replay;		/* the commands come from here, pass them on */
+	/* the RUNTEST and the SIR held back until the next command */
+	int held_runtest;
+	int state;
+	unsigned long tck;
+	unsigned long usec;
+	const jtag_poll_rule_t *rule;
+	unsigned char ir[4];
+} g_poll;
+
+/* printed with -d */
+static struct {
+	unsigned long loops;
+	unsigned long iterations;
+	unsigned long failed;
+	unsigned long waits;
+	unsigned long reads;
+	unsigned long full;
+	unsigned long long waited;	/* us */
+	unsigned long long skipped;	/* us */
+} g_poll_stats;
+
+static void jtag_poll_loop_free(void)
+{
+	unsigned int i;
+
+	for (i = 0; i < g_loop.num_ops; i++) {
+		free(g_loop.ops[i].tdi);
+		free(g_loop.ops[i].tdo);
+		free(g_loop.ops[i].mask);
+	}
+	g_loop.num_ops = 0;
+}
+
+/*
+ * Start recording a loop body that runs up to count times. A loop that
+ * is still open is dropped.
+ */
+int jtag_poll_loop(unsigned long count)
+{
+	jtag_poll_loop_free();
+	g_loop.count = count ? count : 1;
+	return 0;
+}
+
+static jtag_loop_op_t *jtag_poll_loop_add(int op)
+{
+	jtag_loop_op_t *ops;
+	unsigned int max_ops;
+
+	if (g_loop.num_ops == g_loop.max_ops) {
+		max_ops = g_loop.max_ops ? 2 * g_loop.max_ops : 8;
+		ops = realloc(g_loop.ops, max_ops * sizeof(*ops));
+		if (!ops)
+			return NULL;
+		g_loop.ops = ops;
+		g_loop.max_ops = max_ops;
+	}
+	ops = &g_loop.ops[g_loop.num_ops++];
+	memset(ops, 0, sizeof(*ops));
+	ops->op = op;
+	return ops;
+}
+
+static int jtag_poll_copy(char **dst, const char *src, unsigned int bits)
+{
+	if (!src)
+		return 0;
+	*dst = malloc((bits + 7) / 8);
+	if (!*dst)
+		return -1;
+	memcpy(*dst, src, (bits + 7) / 8);
+	return 0;
+}
+
+int jtag_poll_loop_runtest(int state, unsigned long tck, unsigned long usec)
+{
+	jtag_loop_op_t *op = jtag_poll_loop_add(JTAG_LOOP_RUNTEST);
+
+	if (!op)
+		return -1;
+	op->state = state;
+	op->tck = tck;
+	op->usec = usec;
+	return 0;
+}
+
+int jtag_poll_loop_state(int state)
+{
+	jtag_loop_op_t *op = jtag_poll_loop_add(JTAG_LOOP_STATE);
+
+	if (!op)
+		return -1;
+	op->state = state;
+	return 0;
+}
+
+int jtag_poll_loop_scan(unsigned char type, unsigned int bits, const char *tdi,
+			const char *tdo, const char *mask, int line)
+{
+	jtag_loop_op_t *op = jtag_poll_loop_add(JTAG_LOOP_SCAN);
+
+	if (!op)
+		return -1;
+	op->type = type;
+	op->bits = bits;
+	op->line = line;
+	if (bits > g_loop.shift_size) {
+		free(g_loop.shift);
+		g_loop.shift = malloc((bits + 7) / 8);
+		if (!g_loop.shift) {
+			g_loop.shift_size = 0;
+			return -1;
+		}
+		g_loop.shift_size = bits;
+	}
+	if (jtag_poll_copy(&op->tdi, tdi, bits) ||
+		jtag_poll_copy(&op->tdo, tdo, bits) ||
+		jtag_poll_copy(&op->mask, mask, bits))
+		return -1;
+	return 0;
+}
+
+/*
+ * Run the loop body once, every wait scaled by times. Returns 1 and the
+ * SVF line of the scan if a TDO check fails, the rest of the body is
+ * skipped then.
+ */
+static int jtag_poll_loop_body(unsigned long times, int *line)
+{
+	int flags = JTAG_CHUNK_FIRST | JTAG_CHUNK_LAST;
+	jtag_loop_op_t *op;
+	char *tdi;
+	unsigned int i;
+	int ret;
+
+	if (!jtag_plan_active())
+		flags |= JTAG_CHUNK_CHECK;
+
+	for (i = 0; i < g_loop.num_ops; i++) {
+		op = &g_loop.ops[i];
+		switch (op->op) {
+		case JTAG_LOOP_RUNTEST:
+			ret = jtag_player_runtest(op->state, op->tck * times, op->usec * times);
+			break;
+		case JTAG_LOOP_STATE:
+			ret = jtag_player_state(STATE, op->state);
+			break;
+		default:
+			tdi = NULL;
+			if (op->tdi) {
+				tdi = g_loop.shift;
+				memcpy(tdi, op->tdi, (op->bits + 7) / 8);
+			}
+			ret = jtag_player_chunk(op->type, op->bits, tdi, op->tdo, op->mask, flags);
+			if (ret > 0)
+				*line = op->line;
+			break;
+		}
+		if (ret)
+			return ret;
+	}
+	return 0;
+}
+
+/*
+ * Run the recorded loop after the commands the player holds. Returns 1
+ * and the SVF line of the last failing scan if the TDO checks of the
+ * body did not pass in count runs, 0 if they passed or no loop is open.
+ *
+ * A plan cannot branch on TDO, it gets the body once with the waits of
+ * all count runs, the worst case the loop stands for.
+ */
+int jtag_poll_loop_run(int *line)
+{
+	unsigned long i;
+	int ret;
+
+	if (jtag_poll_flush())
+		return -1;
+	if (!g_loop.count)
+		return 0;
+
+	g_poll.replay = 1;
+	if (jtag_plan_active()) {
+		ret = jtag_poll_loop_body(g_loop.count, line);
+		i = 1;
+	} else {
+		for (i = 0, ret = 1; (ret > 0) && (i < g_loop.count); i++)
+			ret = jtag_poll_loop_body(1, line);
+	}
+	g_poll.replay = 0;
+
+	g_poll_stats.loops++;
+	g_poll_stats.iterations += i;
+	if (ret > 0)
+		g_poll_stats.failed++;
+	jtag_poll_loop_free();
+	g_loop.count = 0;
+	return ret;
+}
+
+void jtag_poll_enable(int enable)
+{
+	g_poll.enabled = enable;
+}
+
+/* the commands of the player go to the player as they come */
+static int jtag_poll_off(void)
+{
+	return !g_poll.enabled || g_poll.replay || jtag_plan_active();
+}
+
+/*
+ * Shift the held commands as they were given. Before every command of
+ * the player that is not the next one of a status check.
+ */
+int jtag_poll_flush(void)
+{
+	int ret = 0;
+
+	if (!g_poll.held_runtest)
+		return 0;
+
+	g_poll.replay = 1;
+	ret = jtag_player_runtest(g_poll.state, g_poll.tck, g_poll.usec);
+	if (!ret && g_poll.rule)
+		ret = jtag_player_sir(g_poll.rule->ir_bits, (char *)g_poll.ir, NULL, NULL);
+	g_poll.replay = 0;
+
+	g_poll.held_runtest = 0;
+	g_poll.rule = NULL;
+	return ret;
+}
+
+/*
+ * Hold a long RUNTEST back, it may be the wait of a status check.
+ * Returns JTAG_POLL_PASS for the player to run it.
+ */
+int jtag_poll_runtest(int state, unsigned long tck, unsigned long usec)
+{
+	if (jtag_poll_off())
+		return JTAG_POLL_PASS;
+	if (jtag_poll_flush())
+		return -1;
+	if (usec < JTAG_POLL_MIN_US)
+		return JTAG_POLL_PASS;
+
+	g_poll.held_runtest = 1;
+	g_poll.state = state;
+	g_poll.tck = tck;
+	g_poll.usec = usec;
+	return 0;
+}
+
+static unsigned int jtag_poll_value(const char *data, unsigned int bits)
+{
+	unsigned int value = 0;
+	unsigned int i;
+
+	for (i = 0; i < (bits + 7) / 8; i++)
+		value |= (unsigned int)(unsigned char)data[i] << (8 * i);
+	if (bits < 32)
+		value &= (1U << bits) - 1;
+	return value;
+}
+
+/* the SIR after a held RUNTEST selects the status register of a rule */
+static const jtag_poll_rule_t *jtag_poll_match_ir(unsigned int bits, const char *tdi,
+						  const char *tdo)
+{
+	unsigned int i;
+
+	if (!tdi || tdo || bits > 32)
+		return NULL;
+	for (i = 0; i < JTAG_POLL_RULES; i++) {
+		if (g_poll_rules[i].ir_bits == bits &&
+			g_poll_rules[i].ir == jtag_poll_value(tdi, bits))
+			return &g_poll_rules[i];
+	}
+	return NULL;
+}
+
+/* 1 if the SIR shifts one of the instructions of g_poll_checkpoints */
+int jtag_poll_checkpoint(unsigned int bits, const char *tdi)
+{
+	unsigned int i;
+
+	if (!tdi || bits > 32)
+		return 0;
+	for (i = 0; i < JTAG_POLL_CHECKPOINTS; i++) {
+		if (g_poll_checkpoints[i].ir_bits == bits &&
+			g_poll_checkpoints[i].ir == jtag_poll_value(tdi, bits))
+			return 1;
+	}
+	return 0;
+}
+
+/* the SDR reads the status register and checks the busy bit is clear */
+static int jtag_poll_match_dr(const jtag_poll_rule_t *rule, unsigned int bits,
+			      const char *tdo, const char *mask)
+{
+	unsigned int bit = rule->busy_bit;
+
+	if (bits != rule->dr_bits || !tdo)
+		return 0;
+	if (mask && !(mask[bit / 8] & (1 << (bit % 8))))
+		return 0;
+	return !(tdo[bit / 8] & (1 << (bit % 8)));
+}
+
+/*
+ * Read the status register of rule. Returns 1 while the busy bit is set,
+ * 0 once it is clear.
+ */
+static int jtag_poll_read(const jtag_poll_rule_t *rule)
+{
+	char ir[4];
+	char dr[4];
+	char zeros[4];
+	char mask[4];
+	int ret;
+
+	memcpy(ir, g_poll.ir, sizeof(ir));
+	memset(dr, 0, sizeof(dr));
+	memset(zeros, 0, sizeof(zeros));
+	memset(mask, 0, sizeof(mask));
+	mask[rule->busy_bit / 8] = 1 << (rule->busy_bit % 8);
+
+	g_poll_stats.reads++;
+	ret = jtag_player_sir(rule->ir_bits, ir, NULL, NULL);
+	if (ret)
+		return -1;
+	return jtag_player_chunk(SDR, rule->dr_bits, dr, zeros, mask,
+				 JTAG_CHUNK_FIRST | JTAG_CHUNK_LAST | JTAG_CHUNK_CHECK);
+}
+
+/*
+ * Run the TCKs of the held RUNTEST, then wait in slices of it and read
+ * the busy bit after each until it clears or the whole wait is over.
+ */
+static int jtag_poll_wait(const jtag_poll_rule_t *rule)
+{
+	unsigned long slice = g_poll.usec / JTAG_POLL_SLICES;
+	unsigned long waited = 0;
+	unsigned long step;
+	int busy = 1;
+
+	if (jtag_player_runtest(g_poll.state, g_poll.tck, 0))
+		return -1;
+	while (busy > 0 && waited < g_poll.usec) {
+		step = g_poll.usec - waited < slice ? g_poll.usec - waited : slice;
+		if (jtag_player_runtest(g_poll.state, 0, step))
+			return -1;
+		waited += step;
+		busy = jtag_poll_read(rule);
+	}
+	if (busy < 0)
+		return -1;
+
+	g_poll_stats.waits++;
+	g_poll_stats.waited += waited;
+	g_poll_stats.skipped += g_poll.usec - waited;
+	if (busy)
+		g_poll_stats.full++;
+	return 0;
+}
+
+/*
+ * Hold the SIR of a status check after a held RUNTEST and poll when its
+ * SDR follows. Returns JTAG_POLL_PASS for the player to shift the scan.
+ */
+int jtag_poll_scan(unsigned char type, unsigned int bits, char *tdi,
+		   const char *tdo, const char *mask, int flags)
+{
+	const jtag_poll_rule_t *rule = g_poll.rule;
+	int ret;
+
+	if (jtag_poll_off() || !g_poll.held_runtest)
+		return JTAG_POLL_PASS;
+
+	if (flags == (JTAG_CHUNK_FIRST | JTAG_CHUNK_LAST)) {
+		if (type == SIR && !rule) {
+			g_poll.rule = jtag_poll_match_ir(bits, tdi, tdo);
+			if (g_poll.rule) {
+				memset(g_poll.ir, 0, sizeof(g_poll.ir));
+				memcpy(g_poll.ir, tdi, (bits + 7) / 8);
+				return 0;
+			}
+		} else if (type == SDR && rule && jtag_poll_match_dr(rule, bits, tdo, mask)) {
+			g_poll.replay = 1;
+			ret = jtag_poll_wait(rule);
+			if (!ret)
+				ret = jtag_player_sir(rule->ir_bits, (char *)g_poll.ir, NULL, NULL);
+			if (!ret)
+				ret = jtag_player_sdr(bits, tdi, tdo, mask);
+			g_poll.replay = 0;
+			g_poll.held_runtest = 0;
+			g_poll.rule = NULL;
+			return ret;
+		}
+	}
+
+	if (jtag_poll_flush())
+		return -1;
+	return JTAG_POLL_PASS;
+}
+
+void jtag_poll_print_stats(void)
+{
+	printf("Loops: %lu, runs: %lu, failed: %lu\n",
+			g_poll_stats.loops, g_poll_stats.iterations, g_poll_stats.failed);
+	printf("Status polls: %lu waits, %lu reads, waited %llu us, skipped %llu us, "
+			"busy to the end: %lu\n",
+			g_poll_stats.waits, g_poll_stats.reads, g_poll_stats.waited,
+			g_poll_stats.skipped, g_poll_stats.full);
+}
@@ -0,0 +1,76 @@
+/*
+ * Copyright (c) 2017 Mellanox Technologies. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the names of the copyright holders nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * Alternatively, this software may be distributed under the terms of the
+ * GNU General Public License ("GPL") version 2 as published by the Free
+ * Software Foundation.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __JTAG_POLL_H__
+#define __JTAG_POLL_H__
+
+/*
+ * LOOP ... ENDLOOP and LCOUNT, LDELAY, LSDR of direct programming: the
+ * commands of the loop body are recorded as they are parsed and run by
+ * jtag_poll_loop_run() once the loop is closed, up to count times until
+ * every TDO check of the body passes.
+ */
+int jtag_poll_loop(unsigned long count);
+int jtag_poll_loop_runtest(int state, unsigned long tck, unsigned long usec);
+int jtag_poll_loop_state(int state);
+int jtag_poll_loop_scan(unsigned char type, unsigned int bits, const char *tdi,
+			const char *tdo, const char *mask, int line);
+int jtag_poll_loop_run(int *line);
+
+/*
+ * -poll: a RUNTEST of at least JTAG_POLL_MIN_US followed by the SIR and
+ * the SDR of a status check that a rule of a known device describes, one
+ * that expects the busy bit clear, is cut short. The busy bit is read
+ * every 1/JTAG_POLL_SLICES of the wait until it clears, the wait of the
+ * SVF bounds the polling. The status check is then shifted as written.
+ * Shorter waits are clocked out as TCKs and are not worth a poll.
+ */
+#define JTAG_POLL_MIN_US	10000
+#define JTAG_POLL_SLICES	64
+
+/* jtag_poll_runtest() and jtag_poll_scan() leave the command to the player */
+#define JTAG_POLL_PASS		1
+
+void jtag_poll_enable(int enable);
+int jtag_poll_runtest(int state, unsigned long tck, unsigned long usec);
+int jtag_poll_scan(unsigned char type, unsigned int bits, char *tdi,
+		   const char *tdo, const char *mask, int flags);
+int jtag_poll_flush(void);
+void jtag_poll_print_stats(void);
+
+/*
+ * The SIRs that finish programming a known device, the deferred TDO
+ * checks are collected before them.
+ */
+int jtag_poll_checkpoint(unsigned int bits, const char *tdi);
+
+#endif /*__JTAG_POLL_H__*/
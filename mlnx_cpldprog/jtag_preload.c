@@ -0,0 +1,355 @@
+/*
+ * Copyright (c) 2017 Mellanox Technologies. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the names of the copyright holders nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * Alternatively, this software may be distributed under the terms of the
+ * GNU General Public License ("GPL") version 2 as published by the Free
+ * Software Foundation.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Preloadable JTAG driver: runs the unmodified mlnx_cpldprog against the
+ * simulated chain of jtag_sim.c, built with "make bench":
+ *	JTAG_SIM=machxo2 LD_PRELOAD=./jtag_preload.so \
+ *		mlnx_cpldprog -infile cpld.svf -prog /dev/jtag0
+ * open() of /dev/jtag* hands out a descriptor of /dev/null, and the JTAG
+ * ioctls on it go to the simulated chain. Every ioctl costs the time the
+ * driver measured on the BMC takes, spun on the host. The time between two
+ * ioctls, where mlnx_cpldprog sleeps out RUNTEST waits, passes on the
+ * simulated clock as well, so erase and program latencies see the waits.
+ *	JTAG_SIM		devices of the chain as after -prog sim:
+ *	JTAG_SIM_IOCTL_US	per ioctl, default 0
+ *	JTAG_SIM_BIT_NS		per bit shifted or TCK clocked, default 0
+ *	JTAG_SIM_SUMMARY	file the timing summary of the run is appended
+ *				to, default stderr
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <dlfcn.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/ioctl.h>
+#include <uapi/linux/jtag.h>
+#include "jtag_backend.h"
+#include "jtag_sim.h"
+
+#define PRELOAD_DEV_PREFIX	"/dev/jtag"
+#define PRELOAD_NULL_DEV	"/dev/null"
+
+/* ioctls counted in the summary */
+enum {
+	PRELOAD_XFER,
+	PRELOAD_RUNTEST,
+	PRELOAD_SIOCFREQ,
+	PRELOAD_GIOCFREQ,
+	PRELOAD_OTHER,
+	PRELOAD_IOCTLS
+};
+
+static const char *g_preload_names[PRELOAD_IOCTLS] = {
+	"XFER", "RUNTEST", "SIOCFREQ", "GIOCFREQ", "other"
+};
+
+static struct {
+	pthread_mutex_t lock;
+	int fd;				/* -1 while the device is not open */
+	char path[64];
+	const char *spec;
+	unsigned long ioctl_ns;
+	unsigned long bit_ns;
+	struct timespec opened;
+	unsigned long long last_ns;	/* end of the last ioctl */
+
+	unsigned long calls[PRELOAD_IOCTLS];
+	unsigned long long ns[PRELOAD_IOCTLS];	/* host time in the ioctls */
+	unsigned long long bits;
+	unsigned long long tck;
+	unsigned long long injected_ns;
+	unsigned long errors;
+} g_preload = {
+	.lock = PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP,	/* fclose() of the summary may close() */
+	.fd = -1,
+};
+
+static int (*real_open)(const char *path, int flags, ...);
+static int (*real_close)(int fd);
+
+static unsigned long long preload_now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static unsigned long preload_env(const char *name)
+{
+	const char *value = getenv(name);
+
+	return value ? strtoul(value, NULL, 0) : 0;
+}
+
+/* Spin, a sleep would overshoot the few microseconds of an ioctl. */
+static void preload_spin(unsigned long long start, unsigned long long ns)
+{
+	unsigned long long end = start + ns;
+
+	while (preload_now_ns() < end)
+		;
+	g_preload.injected_ns += ns;
+}
+
+static void preload_summary(void)
+{
+	const char *name = getenv("JTAG_SIM_SUMMARY");
+	unsigned long long total = 0;
+	unsigned long calls = 0;
+	jtag_sim_dev_t *dev;
+	struct timespec now;
+	double wall;
+	FILE *out = stderr;
+	int i;
+
+	if (name) {
+		out = fopen(name, "a");
+		if (!out)
+			out = stderr;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	wall = (now.tv_sec - g_preload.opened.tv_sec) +
+	       (now.tv_nsec - g_preload.opened.tv_nsec) / 1e9;
+	for (i = 0; i < PRELOAD_IOCTLS; i++) {
+		calls += g_preload.calls[i];
+		total += g_preload.ns[i];
+	}
+
+	fprintf(out, "jtag_preload: %s on sim:%s, open %.3f s, %lu ioctls in %.3f s, %lu failed\n",
+		g_preload.path, g_preload.spec, wall, calls, total / 1e9, g_preload.errors);
+	for (i = 0; i < PRELOAD_IOCTLS; i++) {
+		if (!g_preload.calls[i])
+			continue;
+		fprintf(out, "  %-8s %10lu calls %10.3f s %8.1f us/call\n", g_preload_names[i],
+			g_preload.calls[i], g_preload.ns[i] / 1e9,
+			g_preload.ns[i] / 1e3 / g_preload.calls[i]);
+	}
+	fprintf(out, "  bits shifted: %llu, TCKs clocked: %llu\n", g_preload.bits, g_preload.tck);
+	fprintf(out, "  injected latency %.3f s (%lu ns per ioctl, %lu ns per bit), simulated time %.3f s\n",
+		g_preload.injected_ns / 1e9, g_preload.ioctl_ns, g_preload.bit_ns,
+		jtag_sim_now_ns() / 1e9);
+	for (i = 0; i < jtag_sim_devices(); i++) {
+		dev = jtag_sim_device(i);
+		fprintf(out, "  %d %s: USERCODE %08X, erases %lu, rows written %lu, read %lu, refused %lu\n",
+			i, dev->model->name, dev->usercode, dev->erases, dev->rows_written,
+			dev->rows_read, dev->busy_cmds);
+	}
+	if (out != stderr)
+		fclose(out);
+}
+
+static int preload_open_dev(const char *path, int flags)
+{
+	int fd;
+
+	pthread_mutex_lock(&g_preload.lock);
+	if (g_preload.fd >= 0) {
+		pthread_mutex_unlock(&g_preload.lock);
+		errno = EBUSY;
+		return -1;
+	}
+
+	g_preload.spec = getenv("JTAG_SIM");
+	if (!g_preload.spec)
+		g_preload.spec = "";
+	fd = real_open(PRELOAD_NULL_DEV, flags);
+	if (fd >= 0 && jtag_backend_sim.open(g_preload.spec)) {
+		real_close(fd);
+		fd = -1;
+		errno = ENODEV;
+	}
+	if (fd >= 0) {
+		memset(g_preload.calls, 0, sizeof(g_preload.calls));
+		memset(g_preload.ns, 0, sizeof(g_preload.ns));
+		g_preload.bits = 0;
+		g_preload.tck = 0;
+		g_preload.injected_ns = 0;
+		g_preload.errors = 0;
+		g_preload.ioctl_ns = preload_env("JTAG_SIM_IOCTL_US") * 1000;
+		g_preload.bit_ns = preload_env("JTAG_SIM_BIT_NS");
+		snprintf(g_preload.path, sizeof(g_preload.path), "%s", path);
+		clock_gettime(CLOCK_MONOTONIC, &g_preload.opened);
+		g_preload.last_ns = preload_now_ns();
+		g_preload.fd = fd;
+	}
+	pthread_mutex_unlock(&g_preload.lock);
+	return fd;
+}
+
+static void preload_close_dev(void)
+{
+	preload_summary();
+	jtag_backend_sim.close();
+	g_preload.fd = -1;
+}
+
+static void preload_init(void)
+{
+	if (!real_open) {
+		real_open = dlsym(RTLD_NEXT, "open");
+		real_close = dlsym(RTLD_NEXT, "close");
+	}
+}
+
+int open(const char *path, int flags, ...)
+{
+	mode_t mode = 0;
+	va_list ap;
+
+	preload_init();
+	if (flags & O_CREAT) {
+		va_start(ap, flags);
+		mode = va_arg(ap, mode_t);
+		va_end(ap);
+	}
+	if (!strncmp(path, PRELOAD_DEV_PREFIX, strlen(PRELOAD_DEV_PREFIX)))
+		return preload_open_dev(path, flags & ~O_CREAT);
+	return real_open(path, flags, mode);
+}
+
+int open64(const char *path, int flags, ...)
+{
+	mode_t mode = 0;
+	va_list ap;
+
+	if (flags & O_CREAT) {
+		va_start(ap, flags);
+		mode = va_arg(ap, mode_t);
+		va_end(ap);
+	}
+	return open(path, flags, mode);
+}
+
+int close(int fd)
+{
+	preload_init();
+	pthread_mutex_lock(&g_preload.lock);
+	if (fd >= 0 && fd == g_preload.fd)
+		preload_close_dev();
+	pthread_mutex_unlock(&g_preload.lock);
+	return real_close(fd);
+}
+
+/* the summary of a run that exits without closing the device */
+static void __attribute__((destructor)) preload_exit(void)
+{
+	pthread_mutex_lock(&g_preload.lock);
+	if (g_preload.fd >= 0)
+		preload_close_dev();
+	pthread_mutex_unlock(&g_preload.lock);
+}
+
+static int preload_ioctl(unsigned long request, void *arg)
+{
+	struct jtag_run_test_idle *runtest;
+	struct jtag_xfer *xfer;
+	unsigned long long start = preload_now_ns();
+	unsigned long long cost = g_preload.ioctl_ns;
+	int type;
+	int rc;
+
+	jtag_backend_sim.wait((start - g_preload.last_ns) / 1000);
+	switch (request) {
+	case JTAG_IOCXFER:
+		type = PRELOAD_XFER;
+		xfer = arg;
+		rc = xfer->type == JTAG_SIR_XFER ? jtag_backend_sim.shift_ir(xfer) :
+						   jtag_backend_sim.shift_dr(xfer);
+		g_preload.bits += xfer->length;
+		cost += (unsigned long long)xfer->length * g_preload.bit_ns;
+		break;
+	case JTAG_IOCRUNTEST:
+		type = PRELOAD_RUNTEST;
+		runtest = arg;
+		if (runtest->reset)
+			rc = jtag_backend_sim.reset(runtest->endstate);
+		else
+			rc = jtag_backend_sim.run_test(runtest->endstate, runtest->tck);
+		g_preload.tck += runtest->tck;
+		cost += (unsigned long long)runtest->tck * g_preload.bit_ns;
+		break;
+	case JTAG_SIOCFREQ:
+		type = PRELOAD_SIOCFREQ;
+		rc = jtag_backend_sim.set_freq(*(unsigned int *)arg);
+		break;
+	case JTAG_GIOCFREQ:
+		type = PRELOAD_GIOCFREQ;
+		rc = jtag_backend_sim.get_freq(arg);
+		break;
+	default:
+		type = PRELOAD_OTHER;
+		rc = -1;
+		break;
+	}
+
+	preload_spin(start, cost);
+	g_preload.calls[type]++;
+	g_preload.last_ns = preload_now_ns();
+	g_preload.ns[type] += g_preload.last_ns - start;
+	if (rc) {
+		g_preload.errors++;
+		errno = EINVAL;
+	}
+	return rc;
+}
+
+int ioctl(int fd, unsigned long request, ...)
+{
+	static int (*real_ioctl)(int fd, unsigned long request, ...);
+	va_list ap;
+	void *arg;
+	int rc;
+
+	va_start(ap, request);
+	arg = va_arg(ap, void *);
+	va_end(ap);
+
+	pthread_mutex_lock(&g_preload.lock);
+	if (fd >= 0 && fd == g_preload.fd) {
+		rc = preload_ioctl(request, arg);
+		pthread_mutex_unlock(&g_preload.lock);
+		return rc;
+	}
+	pthread_mutex_unlock(&g_preload.lock);
+
+	if (!real_ioctl)
+		real_ioctl = dlsym(RTLD_NEXT, "ioctl");
+	return real_ioctl(fd, request, arg);
+}
@@ -0,0 +1,576 @@
+/*
+ * Copyright (c) 2017 Mellanox Technologies. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the names of the copyright holders nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * Alternatively, this software may be distributed under the terms of the
+ * GNU General Public License ("GPL") version 2 as published by the Free
+ * Software Foundation.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include "bitstream.h"
+#include "jtag_backend.h"
+#include "jtag_tap.h"
+#include "jtag_sim.h"
+
+/* the generic device: a MachXO2 IDCODE and its 9212 config rows of 128 bits */
+#define SIM_GENERIC_IDCODE	0x012BB043
+#define SIM_GENERIC_ROWS	9212
+#define SIM_GENERIC_ROW_BITS	128
+
+/* TMS high this often reaches Test-Logic-Reset, then one TCK to Run-Test/Idle */
+#define SIM_RESET_TCK		6
+
+static const jtag_sim_model_t *g_sim_models[] = {
+	&jtag_sim_generic,
+	&jtag_sim_machxo2,
+	&jtag_sim_machxo3,
+};
+#define SIM_MODELS	(sizeof(g_sim_models) / sizeof(g_sim_models[0]))
+
+/*
+ * The chain and the state the driver left its TAPs in, one of enum
+ * jtag_endstate. A scan from the Pause state of its own register goes on
+ * shifting it, the way a scan split into chunks is shifted. Leaving Pause
+ * any other way goes through Update.
+ */
+static struct {
+	jtag_sim_dev_t dev[JTAG_SIM_MAX_DEVICES];
+	int devices;
+	int state;
+	unsigned int freq;
+	unsigned long long now_ns;	/* simulated clock */
+	unsigned char *chain;		/* the registers of all devices and the bits shifted in */
+	unsigned long chain_size;
+
+	/* printed with -d */
+	unsigned long scans;
+	unsigned long runtests;
+	unsigned long resets;
+	unsigned long long bits;
+	unsigned long long tck;
+	unsigned long long wait_ns;
+	struct timespec opened;		/* host time */
+} g_sim;
+
+uint32_t jtag_sim_dr_get(const jtag_sim_dev_t *dev)
+{
+	uint32_t value = 0;
+	unsigned int i;
+
+	for (i = 0; i < 4 && i * 8 < dev->dr_len; i++)
+		value |= (uint32_t)dev->dr[i] << (8 * i);
+	return value;
+}
+
+void jtag_sim_dr_put(jtag_sim_dev_t *dev, uint32_t value)
+{
+	unsigned int i;
+
+	for (i = 0; i < 4 && i * 8 < dev->dr_len; i++)
+		dev->dr[i] = value >> (8 * i);
+}
+
+int jtag_sim_devices(void)
+{
+	return g_sim.devices;
+}
+
+jtag_sim_dev_t *jtag_sim_device(int index)
+{
+	return (index >= 0 && index < g_sim.devices) ? &g_sim.dev[index] : NULL;
+}
+
+unsigned long long jtag_sim_now_ns(void)
+{
+	return g_sim.now_ns;
+}
+
+unsigned long long jtag_sim_tck(void)
+{
+	return g_sim.tck;
+}
+
+int jtag_sim_busy(const jtag_sim_dev_t *dev)
+{
+	return g_sim.now_ns < dev->busy_ns;
+}
+
+void jtag_sim_set_busy(jtag_sim_dev_t *dev, unsigned long usec)
+{
+	dev->busy_ns = g_sim.now_ns + usec * 1000ULL;
+}
+
+static void sim_clock(unsigned long long tck)
+{
+	g_sim.tck += tck;
+	g_sim.now_ns += tck * 1000000000ULL / g_sim.freq;
+}
+
+static int sim_tap(int state)
+{
+	switch (state) {
+	case JTAG_STATE_PAUSEIR:
+		return TAP_IRPAUSE;
+	case JTAG_STATE_PAUSEDR:
+		return TAP_DRPAUSE;
+	default:
+		return TAP_IDLE;
+	}
+}
+
+static void sim_capture(int ir)
+{
+	jtag_sim_dev_t *dev;
+	int i;
+
+	for (i = 0; i < g_sim.devices; i++) {
+		dev = &g_sim.dev[i];
+		if (ir) {
+			/* IEEE 1149.1: the two bits next to TDO capture 01 */
+			memset(dev->ir_reg, 0, sizeof(dev->ir_reg));
+			dev->ir_reg[0] = 0x01;
+			continue;
+		}
+		dev->dr_len = dev->model->dr_len(dev);
+		if (dev->dr_len > dev->dr_max)
+			dev->dr_len = dev->dr_max;
+		memset(dev->dr, 0, (dev->dr_len + 7) / 8);
+		dev->model->capture_dr(dev);
+	}
+}
+
+static void sim_update(int ir)
+{
+	jtag_sim_dev_t *dev;
+	int i;
+
+	for (i = 0; i < g_sim.devices; i++) {
+		dev = &g_sim.dev[i];
+		if (!ir) {
+			dev->model->update_dr(dev);
+			continue;
+		}
+		dev->ir = (dev->ir_reg[0] | dev->ir_reg[1] << 8 |
+			   dev->ir_reg[2] << 16 | (uint32_t)dev->ir_reg[3] << 24);
+		if (dev->model->ir_len < 32)
+			dev->ir &= (1U << dev->model->ir_len) - 1;
+		if (dev->model->update_ir)
+			dev->model->update_ir(dev);
+	}
+}
+
+/* Move the TAPs to a state the driver stops in, outside of a scan. */
+static void sim_goto(int state)
+{
+	if (state == g_sim.state)
+		return;
+
+	sim_clock(jtag_tap_path(sim_tap(g_sim.state), sim_tap(state)));
+	if (g_sim.state == JTAG_STATE_PAUSEIR)
+		sim_update(1);
+	else if (g_sim.state == JTAG_STATE_PAUSEDR)
+		sim_update(0);
+	if (state == JTAG_STATE_PAUSEIR)
+		sim_capture(1);
+	else if (state == JTAG_STATE_PAUSEDR)
+		sim_capture(0);
+	g_sim.state = state;
+}
+
+static unsigned char *sim_reg(jtag_sim_dev_t *dev, int ir, unsigned int *bits)
+{
+	if (ir) {
+		*bits = dev->model->ir_len;
+		return dev->ir_reg;
+	}
+	*bits = dev->dr_len;
+	return dev->dr;
+}
+
+/*
+ * Shift the xfer through the registers of the chain. The register of the
+ * device next to TDO comes out first, the bits shifted in follow and what
+ * is left in the chain at the end is loaded back into the devices.
+ */
+static int sim_shift(struct jtag_xfer *xfer)
+{
+	int ir = xfer->type == JTAG_SIR_XFER;
+	int pause = ir ? JTAG_STATE_PAUSEIR : JTAG_STATE_PAUSEDR;
+	unsigned char *tdio = (unsigned char *)(uintptr_t)xfer->tdio;
+	unsigned long total = 0;
+	unsigned long size, pos;
+	unsigned int bits;
+	unsigned char *reg;
+	void *chain;
+	int i;
+
+	if (g_sim.state == pause) {
+		/* Exit2, Shift */
+		sim_clock(2);
+	} else {
+		sim_clock(jtag_tap_path(sim_tap(g_sim.state), ir ? TAP_IRSHIFT : TAP_DRSHIFT));
+		if (g_sim.state != JTAG_STATE_IDLE)
+			sim_update(!ir);
+		sim_capture(ir);
+	}
+
+	for (i = 0; i < g_sim.devices; i++) {
+		sim_reg(&g_sim.dev[i], ir, &bits);
+		total += bits;
+	}
+	size = (total + xfer->length + 7) / 8;
+	if (size > g_sim.chain_size) {
+		chain = realloc(g_sim.chain, size);
+		if (!chain)
+			return -1;
+		g_sim.chain = chain;
+		g_sim.chain_size = size;
+	}
+
+	pos = 0;
+	for (i = g_sim.devices - 1; i >= 0; i--) {
+		reg = sim_reg(&g_sim.dev[i], ir, &bits);
+		bitstream_copy(g_sim.chain, pos, reg, 0, bits);
+		pos += bits;
+	}
+	bitstream_copy(g_sim.chain, pos, tdio, 0, xfer->length);
+	if (xfer->direction == JTAG_READ_XFER)
+		bitstream_copy(tdio, 0, g_sim.chain, 0, xfer->length);
+	pos = xfer->length;
+	for (i = g_sim.devices - 1; i >= 0; i--) {
+		reg = sim_reg(&g_sim.dev[i], ir, &bits);
+		bitstream_copy(reg, 0, g_sim.chain, pos, bits);
+		pos += bits;
+	}
+
+	/* the last bit takes the TAP to Exit1 */
+	sim_clock(xfer->length);
+	g_sim.scans++;
+	g_sim.bits += xfer->length;
+	if (xfer->endstate == pause) {
+		sim_clock(1);
+		g_sim.state = pause;
+		return 0;
+	}
+
+	sim_update(ir);
+	g_sim.state = JTAG_STATE_IDLE;
+	sim_clock(jtag_tap_path(ir ? TAP_IREXIT1 : TAP_DREXIT1, TAP_IDLE));
+	sim_goto(xfer->endstate);
+	return 0;
+}
+
+static int sim_run_test(int endstate, unsigned int tck)
+{
+	int i;
+
+	sim_goto(endstate);
+	sim_clock(tck);
+	g_sim.runtests++;
+	if (endstate != JTAG_STATE_IDLE)
+		return 0;
+	for (i = 0; i < g_sim.devices; i++) {
+		if (g_sim.dev[i].model->idle)
+			g_sim.dev[i].model->idle(&g_sim.dev[i], tck);
+	}
+	return 0;
+}
+
+static int sim_wait(unsigned long usec)
+{
+	g_sim.now_ns += usec * 1000ULL;
+	g_sim.wait_ns += usec * 1000ULL;
+	return 0;
+}
+
+static int sim_reset(int endstate)
+{
+	int i;
+
+	for (i = 0; i < g_sim.devices; i++)
+		g_sim.dev[i].model->reset(&g_sim.dev[i]);
+	sim_clock(SIM_RESET_TCK);
+	g_sim.resets++;
+	g_sim.state = JTAG_STATE_IDLE;
+	sim_goto(endstate);
+	return 0;
+}
+
+static int sim_set_freq(unsigned int hz)
+{
+	if (!hz)
+		return -1;
+	g_sim.freq = hz;
+	return 0;
+}
+
+static int sim_get_freq(unsigned int *hz)
+{
+	*hz = g_sim.freq;
+	return 0;
+}
+
+static int sim_batch_submit(jtag_backend_op_t *ops, unsigned int count)
+{
+	unsigned int i;
+	int rc = 0;
+
+	for (i = 0; i < count && !rc; i++) {
+		switch (ops[i].op) {
+		case JTAG_BACKEND_OP_XFER:
+			rc = sim_shift(&ops[i].xfer);
+			break;
+		case JTAG_BACKEND_OP_RUNTEST:
+			rc = sim_run_test(ops[i].endstate, ops[i].tck);
+			break;
+		case JTAG_BACKEND_OP_WAIT:
+			rc = sim_wait(ops[i].usec);
+			break;
+		default:
+			rc = -1;
+			break;
+		}
+	}
+	return rc;
+}
+
+static void sim_close(void)
+{
+	int i;
+
+	for (i = 0; i < g_sim.devices; i++) {
+		free(g_sim.dev[i].dr);
+		free(g_sim.dev[i].flash);
+	}
+	free(g_sim.chain);
+	memset(&g_sim, 0, sizeof(g_sim));
+}
+
+/* "erase=<us>" or "prog=<us>" after a device */
+static int sim_option(jtag_sim_dev_t *dev, const char *opt, size_t len)
+{
+	unsigned long *value = NULL;
+	char buf[32];
+	char *end;
+
+	if (len >= sizeof(buf))
+		len = sizeof(buf) - 1;
+	memcpy(buf, opt, len);
+	buf[len] = '\0';
+	if (!strncmp(buf, "erase=", 6))
+		value = &dev->erase_us;
+	else if (!strncmp(buf, "prog=", 5))
+		value = &dev->prog_us;
+	if (value) {
+		*value = strtoul(strchr(buf, '=') + 1, &end, 0);
+		if (end != strchr(buf, '=') + 1 && !*end)
+			return 0;
+	}
+	printf("Error: bad option %s of simulated device %s.\n", buf, dev->model->name);
+	return -1;
+}
+
+static int sim_add(const char *name, size_t len)
+{
+	const jtag_sim_model_t *model = NULL;
+	const char *opt = memchr(name, '/', len);
+	const char *end = name + len;
+	jtag_sim_dev_t *dev;
+	unsigned int i;
+
+	if (opt)
+		len = opt - name;
+	for (i = 0; i < SIM_MODELS; i++) {
+		if (strlen(g_sim_models[i]->name) == len &&
+		    !strncmp(g_sim_models[i]->name, name, len))
+			model = g_sim_models[i];
+	}
+	if (!model) {
+		printf("Error: no simulated device %.*s.\n", (int)len, name);
+		return -1;
+	}
+	if (g_sim.devices == JTAG_SIM_MAX_DEVICES) {
+		printf("Error: more than %d simulated devices.\n", JTAG_SIM_MAX_DEVICES);
+		return -1;
+	}
+
+	dev = &g_sim.dev[g_sim.devices++];
+	dev->model = model;
+	dev->dr_max = model->row_bits > 32 ? model->row_bits : 32;
+	dev->dr = calloc(1, (dev->dr_max + 7) / 8);
+	dev->row_bytes = (model->row_bits + 7) / 8;
+	dev->flash = calloc(model->rows ? model->rows : 1, dev->row_bytes ? dev->row_bytes : 1);
+	if (!dev->dr || !dev->flash)
+		return -1;
+	dev->erase_us = model->erase_us;
+	dev->prog_us = model->prog_us;
+	while (opt) {
+		name = opt + 1;
+		opt = memchr(name, '/', end - name);
+		if (sim_option(dev, name, (opt ? opt : end) - name))
+			return -1;
+	}
+	model->reset(dev);
+	return 0;
+}
+
+/* spec is the list of devices after "sim:", from TDI to TDO */
+static int sim_open(const char *spec)
+{
+	const char *end;
+
+	memset(&g_sim, 0, sizeof(g_sim));
+	g_sim.freq = JTAG_SIM_DEF_FREQ;
+	g_sim.state = JTAG_STATE_IDLE;
+	clock_gettime(CLOCK_MONOTONIC, &g_sim.opened);
+
+	if (!*spec)
+		spec = jtag_sim_generic.name;
+	for (;;) {
+		end = strchr(spec, ',');
+		if (!end)
+			end = spec + strlen(spec);
+		if (sim_add(spec, end - spec)) {
+			sim_close();
+			return -1;
+		}
+		if (!*end)
+			break;
+		spec = end + 1;
+	}
+	return 0;
+}
+
+static void sim_print_stats(void)
+{
+	struct timespec now;
+	double host;
+	int i;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	host = (now.tv_sec - g_sim.opened.tv_sec) + (now.tv_nsec - g_sim.opened.tv_nsec) / 1e9;
+	if (host <= 0)
+		host = 1e-9;
+
+	printf("Simulated chain: %d devices, scans: %lu, bits: %llu, RUNTESTs: %lu, resets: %lu\n",
+			g_sim.devices, g_sim.scans, g_sim.bits, g_sim.runtests, g_sim.resets);
+	printf("  simulated time %.3f s, %llu TCKs at %u Hz, waits %.3f s\n",
+			g_sim.now_ns / 1e9, g_sim.tck, g_sim.freq, g_sim.wait_ns / 1e9);
+	printf("  host time %.3f s, %.0f scans/s, %.1f Mbit/s\n",
+			host, g_sim.scans / host, g_sim.bits / host / 1e6);
+	for (i = 0; i < g_sim.devices; i++) {
+		if (g_sim.dev[i].model->print_stats)
+			g_sim.dev[i].model->print_stats(&g_sim.dev[i]);
+	}
+}
+
+const jtag_backend_t jtag_backend_sim = {
+	.name		= "sim",
+	.caps		= JTAG_BACKEND_CAP_FREQ | JTAG_BACKEND_CAP_BATCH | JTAG_BACKEND_CAP_SIM,
+	.open		= sim_open,
+	.close		= sim_close,
+	.set_freq	= sim_set_freq,
+	.get_freq	= sim_get_freq,
+	.shift_ir	= sim_shift,
+	.shift_dr	= sim_shift,
+	.run_test	= sim_run_test,
+	.wait		= sim_wait,
+	.reset		= sim_reset,
+	.batch_submit	= sim_batch_submit,
+	.print_stats	= sim_print_stats,
+};
+
+/*
+ * The generic device: IDCODE, BYPASS and a flash array that is erased as
+ * a whole and written and read row by row from an address counter. Any
+ * other instruction selects BYPASS.
+ */
+static void generic_reset(jtag_sim_dev_t *dev)
+{
+	dev->ir = SIM_IDCODE_PUB;
+}
+
+static unsigned int generic_dr_len(jtag_sim_dev_t *dev)
+{
+	switch (dev->ir) {
+	case SIM_IDCODE_PUB:
+		return 32;
+	case SIM_ISC_ERASE:
+	case SIM_LSC_INIT_ADDRESS:
+		return 8;
+	case SIM_LSC_PROG_INCR_NV:
+	case SIM_LSC_READ_INCR_NV:
+		return dev->model->row_bits;
+	default:
+		return 1;
+	}
+}
+
+static void generic_capture_dr(jtag_sim_dev_t *dev)
+{
+	switch (dev->ir) {
+	case SIM_IDCODE_PUB:
+		jtag_sim_dr_put(dev, dev->model->idcode);
+		break;
+	case SIM_LSC_READ_INCR_NV:
+		if (dev->addr < dev->model->rows)
+			memcpy(dev->dr, dev->flash + dev->addr++ * dev->row_bytes, dev->row_bytes);
+		break;
+	}
+}
+
+static void generic_update_dr(jtag_sim_dev_t *dev)
+{
+	switch (dev->ir) {
+	case SIM_ISC_ERASE:
+		memset(dev->flash, 0, dev->model->rows * dev->row_bytes);
+		break;
+	case SIM_LSC_INIT_ADDRESS:
+		dev->addr = 0;
+		break;
+	case SIM_LSC_PROG_INCR_NV:
+		if (dev->addr < dev->model->rows)
+			memcpy(dev->flash + dev->addr++ * dev->row_bytes, dev->dr, dev->row_bytes);
+		break;
+	}
+}
+
+const jtag_sim_model_t jtag_sim_generic = {
+	.name		= "generic",
+	.ir_len		= 8,
+	.idcode		= SIM_GENERIC_IDCODE,
+	.rows		= SIM_GENERIC_ROWS,
+	.row_bits	= SIM_GENERIC_ROW_BITS,
+	.reset		= generic_reset,
+	.dr_len		= generic_dr_len,
+	.capture_dr	= generic_capture_dr,
+	.update_dr	= generic_update_dr,
+};
@@ -0,0 +1,122 @@
+/*
+ * Copyright (c) 2017 Mellanox Technologies. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the names of the copyright holders nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * Alternatively, this software may be distributed under the terms of the
+ * GNU General Public License ("GPL") version 2 as published by the Free
+ * Software Foundation.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __JTAG_SIM_H__
+#define __JTAG_SIM_H__
+
+#include <stdint.h>
+
+/*
+ * Simulated JTAG chain of the "sim" backend, selected with
+ *	-prog sim[:<device>[,<device>...]]
+ * The devices are listed from TDI to TDO, without a list the chain is one
+ * "generic" device. A device may be followed by the erase and program
+ * latencies of its flash in microseconds, as in machxo2/erase=2000/prog=200.
+ * Each device has a TAP with an IR and the DR its instruction selects,
+ * BYPASS, IDCODE and a flash array. TCKs and waits advance a simulated
+ * clock instead of taking time, so the player runs as fast as the host
+ * does.
+ *
+ * How a device reacts to its instructions is its model. The TAP calls the
+ * model on Test-Logic-Reset, on Capture-DR, on Update-IR/DR and for TCKs
+ * in Run-Test/Idle, with the shift registers in the device. Models that
+ * take time to erase or program keep the device busy until the simulated
+ * clock reaches busy_ns.
+ */
+#define JTAG_SIM_MAX_DEVICES	8
+#define JTAG_SIM_DEF_FREQ	1000000	/* Hz until the TCK is set */
+
+/* instructions of the generic device, a subset of the Lattice ones */
+#define SIM_ISC_ERASE		0x0E
+#define SIM_LSC_INIT_ADDRESS	0x46
+#define SIM_LSC_PROG_INCR_NV	0x70
+#define SIM_LSC_READ_INCR_NV	0x73
+#define SIM_IDCODE_PUB		0xE0
+#define SIM_BYPASS		0xFF
+
+typedef struct jtag_sim_dev jtag_sim_dev_t;
+
+typedef struct {
+	const char *name;
+	unsigned int ir_len;		/* up to 32 bits */
+	uint32_t idcode;
+	unsigned int rows;		/* of the flash array */
+	unsigned int row_bits;
+	unsigned long erase_us;		/* default latencies */
+	unsigned long prog_us;
+	void (*reset)(jtag_sim_dev_t *dev);
+	unsigned int (*dr_len)(jtag_sim_dev_t *dev);
+	void (*capture_dr)(jtag_sim_dev_t *dev);
+	void (*update_dr)(jtag_sim_dev_t *dev);
+	void (*update_ir)(jtag_sim_dev_t *dev);	/* may be NULL */
+	void (*idle)(jtag_sim_dev_t *dev, unsigned int tck);	/* may be NULL */
+	void (*print_stats)(jtag_sim_dev_t *dev);		/* may be NULL */
+} jtag_sim_model_t;
+
+struct jtag_sim_dev {
+	const jtag_sim_model_t *model;
+	uint32_t ir;			/* instruction in effect */
+	unsigned char ir_reg[4];	/* IR shift register */
+	unsigned char *dr;		/* DR shift register, dr_len bits */
+	unsigned int dr_len;
+	unsigned int dr_max;		/* bits allocated for dr */
+	unsigned char *flash;		/* rows of row_bits, LSB first */
+	unsigned int row_bytes;
+	unsigned int addr;		/* flash row */
+	unsigned long erase_us;
+	unsigned long prog_us;
+	unsigned long long busy_ns;	/* busy until the simulated clock gets here */
+	uint32_t usercode;
+	uint32_t status;
+
+	/* printed with -d */
+	unsigned long erases;
+	unsigned long rows_written;
+	unsigned long rows_read;
+	unsigned long busy_cmds;	/* commands refused while busy */
+	unsigned long busy_polls;	/* busy flag reads that found it busy */
+};
+
+extern const jtag_sim_model_t jtag_sim_generic;
+extern const jtag_sim_model_t jtag_sim_machxo2;
+extern const jtag_sim_model_t jtag_sim_machxo3;
+
+int jtag_sim_devices(void);
+jtag_sim_dev_t *jtag_sim_device(int index);
+unsigned long long jtag_sim_now_ns(void);
+unsigned long long jtag_sim_tck(void);
+uint32_t jtag_sim_dr_get(const jtag_sim_dev_t *dev);
+void jtag_sim_dr_put(jtag_sim_dev_t *dev, uint32_t value);
+int jtag_sim_busy(const jtag_sim_dev_t *dev);
+void jtag_sim_set_busy(jtag_sim_dev_t *dev, unsigned long usec);
+
+#endif /*__JTAG_SIM_H__*/
@@ -0,0 +1,266 @@
+/*
+ * Copyright (c) 2017 Mellanox Technologies. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the names of the copyright holders nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * Alternatively, this software may be distributed under the terms of the
+ * GNU General Public License ("GPL") version 2 as published by the Free
+ * Software Foundation.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include "jtag_sim.h"
+
+/*
+ * Configuration engine of the Lattice MachXO2/MachXO3 as its SVF files
+ * drive it over JTAG: offline mode with ISC_ENABLE, erase, the CFG flash
+ * written and read row by row from an address counter, USERCODE and the
+ * DONE bit. Erase and program keep the device busy for the latencies of
+ * the device, what arrives meanwhile is refused and sets the Fail bit of
+ * the status register, so an SVF that does not wait or poll long enough
+ * fails its verify.
+ */
+#define XO2_ISC_ENABLE_X	0x74
+#define XO2_ISC_ENABLE		0xC6
+#define XO2_ISC_DISABLE		0x26
+#define XO2_ISC_ERASE		SIM_ISC_ERASE
+#define XO2_ISC_PROGRAM_DONE	0x5E
+#define XO2_ISC_PROGRAM_USERCODE 0xC2
+#define XO2_USERCODE		0xC0
+#define XO2_IDCODE_PUB		SIM_IDCODE_PUB
+#define XO2_LSC_INIT_ADDRESS	SIM_LSC_INIT_ADDRESS
+#define XO2_LSC_WRITE_ADDRESS	0xB4
+#define XO2_LSC_PROG_INCR_NV	SIM_LSC_PROG_INCR_NV
+#define XO2_LSC_READ_INCR_NV	SIM_LSC_READ_INCR_NV
+#define XO2_LSC_READ_STATUS	0x3C
+#define XO2_LSC_CHECK_BUSY	0xF0
+#define XO2_LSC_REFRESH		0x79
+
+/* operand of ISC_ERASE */
+#define XO2_ERASE_SRAM		0x01
+#define XO2_ERASE_FEATURE	0x02
+#define XO2_ERASE_CFG		0x04
+#define XO2_ERASE_UFM		0x08
+
+/* status register */
+#define XO2_STATUS_DONE		(1 << 8)
+#define XO2_STATUS_ISC_EN	(1 << 9)
+#define XO2_STATUS_BUSY		(1 << 12)
+#define XO2_STATUS_FAIL		(1 << 13)
+
+/* LSC_WRITE_ADDRESS: the row in the low 14 bits */
+#define XO2_ADDRESS_MASK	0x3FFF
+
+/* XO2-7000HC and XO3LF-6900C, 9212 CFG rows of 128 bits */
+#define XO2_7000_IDCODE		0x012BD043
+#define XO3_6900_IDCODE		0x612BD043
+#define XO2_CFG_ROWS		9212
+#define XO2_ROW_BITS		128
+
+/* typical erase of the CFG flash and program of a row */
+#define XO2_ERASE_US		1000000
+#define XO2_PROG_US		200
+
+static void xo2_reset(jtag_sim_dev_t *dev)
+{
+	dev->ir = XO2_IDCODE_PUB;
+}
+
+/*
+ * An erase or a program starts only in offline mode while the device is
+ * not busy, and keeps it busy for usec.
+ */
+static int xo2_start(jtag_sim_dev_t *dev, unsigned long usec)
+{
+	if (jtag_sim_busy(dev)) {
+		dev->busy_cmds++;
+		dev->status |= XO2_STATUS_FAIL;
+		return 0;
+	}
+	if (!(dev->status & XO2_STATUS_ISC_EN)) {
+		dev->status |= XO2_STATUS_FAIL;
+		return 0;
+	}
+	jtag_sim_set_busy(dev, usec);
+	return 1;
+}
+
+static unsigned int xo2_dr_len(jtag_sim_dev_t *dev)
+{
+	switch (dev->ir) {
+	case XO2_IDCODE_PUB:
+	case XO2_USERCODE:
+	case XO2_ISC_PROGRAM_USERCODE:
+	case XO2_LSC_READ_STATUS:
+	case XO2_LSC_WRITE_ADDRESS:
+		return 32;
+	case XO2_ISC_ENABLE:
+	case XO2_ISC_ENABLE_X:
+	case XO2_ISC_ERASE:
+	case XO2_LSC_INIT_ADDRESS:
+		return 8;
+	case XO2_LSC_PROG_INCR_NV:
+	case XO2_LSC_READ_INCR_NV:
+		return dev->model->row_bits;
+	default:
+		return 1;
+	}
+}
+
+static void xo2_capture_dr(jtag_sim_dev_t *dev)
+{
+	int busy = jtag_sim_busy(dev);
+
+	switch (dev->ir) {
+	case XO2_IDCODE_PUB:
+		jtag_sim_dr_put(dev, dev->model->idcode);
+		break;
+	case XO2_USERCODE:
+		jtag_sim_dr_put(dev, dev->usercode);
+		break;
+	case XO2_LSC_READ_STATUS:
+		dev->busy_polls += busy;
+		jtag_sim_dr_put(dev, dev->status | (busy ? XO2_STATUS_BUSY : 0));
+		break;
+	case XO2_LSC_CHECK_BUSY:
+		dev->busy_polls += busy;
+		dev->dr[0] = busy;
+		break;
+	case XO2_LSC_READ_INCR_NV:
+		if (busy) {
+			dev->busy_cmds++;
+			dev->status |= XO2_STATUS_FAIL;
+		} else if (dev->addr < dev->model->rows) {
+			memcpy(dev->dr, dev->flash + dev->addr++ * dev->row_bytes, dev->row_bytes);
+			dev->rows_read++;
+		}
+		break;
+	}
+}
+
+static void xo2_update_dr(jtag_sim_dev_t *dev)
+{
+	unsigned char *row;
+	unsigned int i;
+
+	switch (dev->ir) {
+	case XO2_ISC_ERASE:
+		if (!xo2_start(dev, dev->erase_us))
+			break;
+		dev->erases++;
+		if (dev->dr[0] & XO2_ERASE_CFG) {
+			memset(dev->flash, 0, dev->model->rows * dev->row_bytes);
+			dev->usercode = 0;
+			dev->status &= ~XO2_STATUS_DONE;
+		}
+		break;
+	case XO2_LSC_INIT_ADDRESS:
+		dev->addr = 0;
+		break;
+	case XO2_LSC_WRITE_ADDRESS:
+		dev->addr = jtag_sim_dr_get(dev) & XO2_ADDRESS_MASK;
+		break;
+	case XO2_LSC_PROG_INCR_NV:
+		if (dev->addr >= dev->model->rows || !xo2_start(dev, dev->prog_us))
+			break;
+		/* programming sets bits, only an erase clears them */
+		row = dev->flash + dev->addr++ * dev->row_bytes;
+		for (i = 0; i < dev->row_bytes; i++)
+			row[i] |= dev->dr[i];
+		dev->rows_written++;
+		break;
+	case XO2_ISC_PROGRAM_USERCODE:
+		if (xo2_start(dev, dev->prog_us))
+			dev->usercode |= jtag_sim_dr_get(dev);
+		break;
+	}
+}
+
+/* instructions that act without a DR scan */
+static void xo2_update_ir(jtag_sim_dev_t *dev)
+{
+	switch (dev->ir) {
+	case XO2_ISC_ENABLE:
+	case XO2_ISC_ENABLE_X:
+		dev->status |= XO2_STATUS_ISC_EN;
+		dev->status &= ~XO2_STATUS_FAIL;
+		break;
+	case XO2_ISC_DISABLE:
+	case XO2_LSC_REFRESH:
+		dev->status &= ~XO2_STATUS_ISC_EN;
+		break;
+	case XO2_LSC_INIT_ADDRESS:
+		dev->addr = 0;
+		break;
+	case XO2_ISC_PROGRAM_DONE:
+		if (xo2_start(dev, dev->prog_us))
+			dev->status |= XO2_STATUS_DONE;
+		break;
+	}
+}
+
+static void xo2_print_stats(jtag_sim_dev_t *dev)
+{
+	printf("  %s: USERCODE %08X, DONE %d, Fail %d, erases %lu, rows written %lu, read %lu\n",
+			dev->model->name, dev->usercode, !!(dev->status & XO2_STATUS_DONE),
+			!!(dev->status & XO2_STATUS_FAIL), dev->erases, dev->rows_written,
+			dev->rows_read);
+	printf("    erase %lu us, program %lu us, commands refused while busy: %lu, busy polls: %lu\n",
+			dev->erase_us, dev->prog_us, dev->busy_cmds, dev->busy_polls);
+}
+
+const jtag_sim_model_t jtag_sim_machxo2 = {
+	.name		= "machxo2",
+	.ir_len		= 8,
+	.idcode		= XO2_7000_IDCODE,
+	.rows		= XO2_CFG_ROWS,
+	.row_bits	= XO2_ROW_BITS,
+	.erase_us	= XO2_ERASE_US,
+	.prog_us	= XO2_PROG_US,
+	.reset		= xo2_reset,
+	.dr_len		= xo2_dr_len,
+	.capture_dr	= xo2_capture_dr,
+	.update_dr	= xo2_update_dr,
+	.update_ir	= xo2_update_ir,
+	.print_stats	= xo2_print_stats,
+};
+
+const jtag_sim_model_t jtag_sim_machxo3 = {
+	.name		= "machxo3",
+	.ir_len		= 8,
+	.idcode		= XO3_6900_IDCODE,
+	.rows		= XO2_CFG_ROWS,
+	.row_bits	= XO2_ROW_BITS,
+	.erase_us	= XO2_ERASE_US,
+	.prog_us	= XO2_PROG_US,
+	.reset		= xo2_reset,
+	.dr_len		= xo2_dr_len,
+	.capture_dr	= xo2_capture_dr,
+	.update_dr	= xo2_update_dr,
+	.update_ir	= xo2_update_ir,
+	.print_stats	= xo2_print_stats,
+};
@@ -0,0 +1,196 @@
+/*
+ * Copyright (c) 2017 Mellanox Technologies. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the names of the copyright holders nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * Alternatively, this software may be distributed under the terms of the
+ * GNU General Public License ("GPL") version 2 as published by the Free
+ * Software Foundation.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdlib.h>
+#include <pthread.h>
+#include "utilities.h"
+#include "vmopcode.h"
+#include "jtag_handlers.h"
+#include "jtag_stream.h"
+
+/*
+ * A streamed scan is decoded by a worker thread into a small ring of chunk
+ * buffers while the caller shifts the chunks decoded before. Decoding the
+ * hex text overlaps with the driver clocking out the previous chunk, and
+ * memory stays at JTAG_STREAM_SLOTS chunks however long the scan is.
+ */
+#define JTAG_STREAM_SLOTS	2
+#define JTAG_STREAM_CHUNK_BYTES	(JTAG_STREAM_CHUNK_BITS / 8)
+
+typedef struct {
+	char *tdi;
+	char *tdo;
+	char *mask;
+} jtag_stream_slot_t;
+
+typedef struct {
+	unsigned long bits;
+	unsigned long chunks;
+	svf_hex_reader_t tdi;
+	svf_hex_reader_t tdo;
+	svf_hex_reader_t mask;
+	int has_tdo;
+	int has_mask;
+	jtag_stream_slot_t slot[JTAG_STREAM_SLOTS];
+
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	unsigned long decoded;	/* chunks ready in the ring */
+	unsigned long shifted;	/* chunks done with, their slots are free */
+} jtag_stream_t;
+
+static unsigned int jtag_stream_chunk_bits(const jtag_stream_t *st,
+					   unsigned long chunk)
+{
+	unsigned long left = st->bits - chunk * JTAG_STREAM_CHUNK_BITS;
+
+	return left < JTAG_STREAM_CHUNK_BITS ? left : JTAG_STREAM_CHUNK_BITS;
+}
+
+static void *jtag_stream_decode(void *arg)
+{
+	jtag_stream_t *st = arg;
+	jtag_stream_slot_t *slot;
+	unsigned long chunk;
+	unsigned int bits;
+
+	for (chunk = 0; chunk < st->chunks; chunk++) {
+		pthread_mutex_lock(&st->lock);
+		while (chunk - st->shifted >= JTAG_STREAM_SLOTS)
+			pthread_cond_wait(&st->cond, &st->lock);
+		pthread_mutex_unlock(&st->lock);
+
+		slot = &st->slot[chunk % JTAG_STREAM_SLOTS];
+		bits = jtag_stream_chunk_bits(st, chunk);
+		svf_hex_read(&st->tdi, (unsigned char *)slot->tdi, bits);
+		if (st->has_tdo)
+			svf_hex_read(&st->tdo, (unsigned char *)slot->tdo, bits);
+		if (st->has_mask)
+			svf_hex_read(&st->mask, (unsigned char *)slot->mask, bits);
+
+		pthread_mutex_lock(&st->lock);
+		st->decoded++;
+		pthread_cond_broadcast(&st->cond);
+		pthread_mutex_unlock(&st->lock);
+	}
+	return NULL;
+}
+
+static void jtag_stream_free(jtag_stream_t *st)
+{
+	int i;
+
+	for (i = 0; i < JTAG_STREAM_SLOTS; i++) {
+		free(st->slot[i].tdi);
+		free(st->slot[i].tdo);
+		free(st->slot[i].mask);
+	}
+}
+
+/*
+ * Shift a SIR or SDR of any length straight from its hex data in the SVF
+ * file. tdo and mask may be NULL. All chunks are shifted even if one of
+ * them fails its TDO check, so the TAP always ends up in IDLE. Returns OK,
+ * OUT_OF_MEMORY, or 1 if the captured TDO of any chunk did not match.
+ */
+int jtag_stream_scan(unsigned char type, unsigned long bits,
+		     const svf_hex_span_t *tdi, const svf_hex_span_t *tdo,
+		     const svf_hex_span_t *mask)
+{
+	jtag_stream_t st = { 0 };
+	jtag_stream_slot_t *slot;
+	pthread_t thread;
+	unsigned long chunk;
+	int flags;
+	int ret = OK;
+	int i;
+
+	st.bits = bits;
+	st.chunks = (bits + JTAG_STREAM_CHUNK_BITS - 1) / JTAG_STREAM_CHUNK_BITS;
+	st.has_tdo = tdo != NULL;
+	st.has_mask = tdo && mask;
+	svf_hex_reader_init(&st.tdi, tdi);
+	if (st.has_tdo)
+		svf_hex_reader_init(&st.tdo, tdo);
+	if (st.has_mask)
+		svf_hex_reader_init(&st.mask, mask);
+
+	for (i = 0; i < JTAG_STREAM_SLOTS; i++) {
+		st.slot[i].tdi = malloc(JTAG_STREAM_CHUNK_BYTES);
+		if (st.has_tdo)
+			st.slot[i].tdo = malloc(JTAG_STREAM_CHUNK_BYTES);
+		if (st.has_mask)
+			st.slot[i].mask = malloc(JTAG_STREAM_CHUNK_BYTES);
+		if (!st.slot[i].tdi || (st.has_tdo && !st.slot[i].tdo) ||
+		    (st.has_mask && !st.slot[i].mask)) {
+			jtag_stream_free(&st);
+			return OUT_OF_MEMORY;
+		}
+	}
+
+	pthread_mutex_init(&st.lock, NULL);
+	pthread_cond_init(&st.cond, NULL);
+	if (pthread_create(&thread, NULL, jtag_stream_decode, &st)) {
+		pthread_cond_destroy(&st.cond);
+		pthread_mutex_destroy(&st.lock);
+		jtag_stream_free(&st);
+		return OUT_OF_MEMORY;
+	}
+
+	for (chunk = 0; chunk < st.chunks; chunk++) {
+		pthread_mutex_lock(&st.lock);
+		while (st.decoded <= chunk)
+			pthread_cond_wait(&st.cond, &st.lock);
+		pthread_mutex_unlock(&st.lock);
+
+		slot = &st.slot[chunk % JTAG_STREAM_SLOTS];
+		flags = 0;
+		if (chunk == 0)
+			flags |= JTAG_CHUNK_FIRST;
+		if (chunk == st.chunks - 1)
+			flags |= JTAG_CHUNK_LAST;
+		if (jtag_player_chunk(type, jtag_stream_chunk_bits(&st, chunk),
+				      slot->tdi, slot->tdo, slot->mask, flags))
+			ret = 1;
+
+		pthread_mutex_lock(&st.lock);
+		st.shifted++;
+		pthread_cond_broadcast(&st.cond);
+		pthread_mutex_unlock(&st.lock);
+	}
+
+	pthread_join(thread, NULL);
+	pthread_cond_destroy(&st.cond);
+	pthread_mutex_destroy(&st.lock);
+	jtag_stream_free(&st);
+	return ret;
+}
@@ -0,0 +1,207 @@
+/*
+ * Copyright (c) 2017 Mellanox Technologies. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the names of the copyright holders nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * Alternatively, this software may be distributed under the terms of the
+ * GNU General Public License ("GPL") version 2 as published by the Free
+ * Software Foundation.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <uapi/linux/jtag.h>
+#include "vmopcode.h"
+#include "jtag_tap.h"
+
+/* the next state of the TAP controller for TMS low and high */
+static const unsigned char g_tap_next[TAP_STATES][2] = {
+	[TAP_RESET]	= { TAP_IDLE,		TAP_RESET },
+	[TAP_IDLE]	= { TAP_IDLE,		TAP_DRSELECT },
+	[TAP_DRSELECT]	= { TAP_DRCAPTURE,	TAP_IRSELECT },
+	[TAP_DRCAPTURE]	= { TAP_DRSHIFT,	TAP_DREXIT1 },
+	[TAP_DRSHIFT]	= { TAP_DRSHIFT,	TAP_DREXIT1 },
+	[TAP_DREXIT1]	= { TAP_DRPAUSE,	TAP_DRUPDATE },
+	[TAP_DRPAUSE]	= { TAP_DRPAUSE,	TAP_DREXIT2 },
+	[TAP_DREXIT2]	= { TAP_DRSHIFT,	TAP_DRUPDATE },
+	[TAP_DRUPDATE]	= { TAP_IDLE,		TAP_DRSELECT },
+	[TAP_IRSELECT]	= { TAP_IRCAPTURE,	TAP_RESET },
+	[TAP_IRCAPTURE]	= { TAP_IRSHIFT,	TAP_IREXIT1 },
+	[TAP_IRSHIFT]	= { TAP_IRSHIFT,	TAP_IREXIT1 },
+	[TAP_IREXIT1]	= { TAP_IRPAUSE,	TAP_IRUPDATE },
+	[TAP_IRPAUSE]	= { TAP_IRPAUSE,	TAP_IREXIT2 },
+	[TAP_IREXIT2]	= { TAP_IRSHIFT,	TAP_IRUPDATE },
+	[TAP_IRUPDATE]	= { TAP_IDLE,		TAP_DRSELECT },
+};
+
+/* TMS high this often reaches Test-Logic-Reset from any state */
+#define TAP_RESET_TCK	5
+
+/* TCKs of the shortest TMS path between two states, filled on first use */
+static unsigned char g_tap_path[TAP_STATES][TAP_STATES];
+static int g_tap_path_done;
+
+static struct {
+	int state;
+	int end_ir;		/* where a SIR ends, set by ENDIR */
+	int end_dr;		/* where a SDR ends, set by ENDDR */
+
+	/* printed with -d */
+	unsigned long scans;
+	unsigned long moves;
+	unsigned long long tck;		/* spent moving between states */
+	unsigned long long idle_tck;	/* the same with every scan through Run-Test/Idle */
+} g_tap;
+
+static void jtag_tap_paths(void)
+{
+	unsigned char queue[TAP_STATES];
+	int from, head, tail, s, tms, next;
+
+	if (g_tap_path_done)
+		return;
+	memset(g_tap_path, 0xff, sizeof(g_tap_path));
+	for (from = 0; from < TAP_STATES; from++) {
+		g_tap_path[from][from] = 0;
+		queue[0] = from;
+		for (head = 0, tail = 1; head < tail; head++) {
+			s = queue[head];
+			for (tms = 0; tms < 2; tms++) {
+				next = g_tap_next[s][tms];
+				if (g_tap_path[from][next] != 0xff)
+					continue;
+				g_tap_path[from][next] = g_tap_path[from][s] + 1;
+				queue[tail++] = next;
+			}
+		}
+	}
+	g_tap_path_done = 1;
+}
+
+/*
+ * The TAP is in Run-Test/Idle when programming starts, main resets it
+ * after the device is opened. SIR and SDR end there as well until an
+ * ENDIR or ENDDR says otherwise.
+ */
+void jtag_tap_init(void)
+{
+	memset(&g_tap, 0, sizeof(g_tap));
+	g_tap.state = TAP_IDLE;
+	g_tap.end_ir = TAP_IDLE;
+	g_tap.end_dr = TAP_IDLE;
+	jtag_tap_paths();
+}
+
+int jtag_tap_next(int state, int tms)
+{
+	return g_tap_next[state][tms ? 1 : 0];
+}
+
+int jtag_tap_path(int from, int to)
+{
+	jtag_tap_paths();
+	return g_tap_path[from][to];
+}
+
+/* The state the TAP is left in for an SVF stable state of vmopcode.h. */
+int jtag_tap_stable(int svf_state)
+{
+	switch (svf_state) {
+	case IRPAUSE:
+		return TAP_IRPAUSE;
+	case DRPAUSE:
+	case DRCAPTURE:
+		return TAP_DRPAUSE;
+	default:
+		return TAP_IDLE;
+	}
+}
+
+/* The enum jtag_endstate of the driver for a state the TAP is left in. */
+int jtag_tap_endstate(int state)
+{
+	switch (state) {
+	case TAP_IRPAUSE:
+		return JTAG_STATE_PAUSEIR;
+	case TAP_DRPAUSE:
+		return JTAG_STATE_PAUSEDR;
+	default:
+		return JTAG_STATE_IDLE;
+	}
+}
+
+int jtag_tap_state(void)
+{
+	return g_tap.state;
+}
+
+void jtag_tap_set_end(int ir, int state)
+{
+	if (ir)
+		g_tap.end_ir = state;
+	else
+		g_tap.end_dr = state;
+}
+
+int jtag_tap_scan_end(int ir)
+{
+	return ir ? g_tap.end_ir : g_tap.end_dr;
+}
+
+/*
+ * Account one scan: from the current state into Shift-IR/DR, and from
+ * Exit1, where the last bit leaves the TAP, to end. A scan that stays in
+ * Pause is compared against the same scan going through Run-Test/Idle.
+ */
+void jtag_tap_scan(int ir, int end)
+{
+	int shift = ir ? TAP_IRSHIFT : TAP_DRSHIFT;
+	int exit1 = ir ? TAP_IREXIT1 : TAP_DREXIT1;
+
+	g_tap.scans++;
+	g_tap.tck += g_tap_path[g_tap.state][shift] + g_tap_path[exit1][end];
+	g_tap.idle_tck += g_tap_path[TAP_IDLE][shift] + g_tap_path[exit1][TAP_IDLE];
+	g_tap.state = end;
+}
+
+/* Account a move to state, through Test-Logic-Reset with reset. */
+void jtag_tap_move(int state, int reset)
+{
+	g_tap.moves++;
+	if (reset) {
+		g_tap.tck += TAP_RESET_TCK + g_tap_path[TAP_RESET][state];
+		g_tap.idle_tck += TAP_RESET_TCK + g_tap_path[TAP_RESET][state];
+	} else {
+		g_tap.tck += g_tap_path[g_tap.state][state];
+		g_tap.idle_tck += g_tap_path[TAP_IDLE][state];
+	}
+	g_tap.state = state;
+}
+
+void jtag_tap_print_stats(void)
+{
+	printf("TAP scans: %lu, state moves: %lu, TCKs between states: %llu (%llu through Run-Test/Idle)\n",
+			g_tap.scans, g_tap.moves, g_tap.tck, g_tap.idle_tck);
+}
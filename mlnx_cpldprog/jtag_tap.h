@@ -0,0 +1,76 @@
+/*
+ * Copyright (c) 2017 Mellanox Technologies. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the names of the copyright holders nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * Alternatively, this software may be distributed under the terms of the
+ * GNU General Public License ("GPL") version 2 as published by the Free
+ * Software Foundation.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __JTAG_TAP_H__
+#define __JTAG_TAP_H__
+
+/*
+ * The state of the TAP controller as the player leaves it. The driver moves
+ * the TAP itself and can only stop it in Run-Test/Idle, Pause-IR and
+ * Pause-DR, so only those are ever the current state. The SVF stable
+ * states are mapped onto them: RESET ends in Run-Test/Idle after the reset
+ * and DRCAPTURE in Pause-DR, which a following SDR shifts from without
+ * capturing again.
+ */
+enum jtag_tap_state {
+	TAP_RESET,
+	TAP_IDLE,
+	TAP_DRSELECT,
+	TAP_DRCAPTURE,
+	TAP_DRSHIFT,
+	TAP_DREXIT1,
+	TAP_DRPAUSE,
+	TAP_DREXIT2,
+	TAP_DRUPDATE,
+	TAP_IRSELECT,
+	TAP_IRCAPTURE,
+	TAP_IRSHIFT,
+	TAP_IREXIT1,
+	TAP_IRPAUSE,
+	TAP_IREXIT2,
+	TAP_IRUPDATE,
+	TAP_STATES
+};
+
+void jtag_tap_init(void);
+int jtag_tap_next(int state, int tms);
+int jtag_tap_path(int from, int to);
+int jtag_tap_stable(int svf_state);
+int jtag_tap_endstate(int state);
+int jtag_tap_state(void);
+void jtag_tap_set_end(int ir, int state);
+int jtag_tap_scan_end(int ir);
+void jtag_tap_scan(int ir, int end);
+void jtag_tap_move(int state, int reset);
+void jtag_tap_print_stats(void);
+
+#endif /*__JTAG_TAP_H__*/
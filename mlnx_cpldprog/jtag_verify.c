@@ -0,0 +1,161 @@
+/*
+ * Copyright (c) 2017 Mellanox Technologies. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the names of the copyright holders nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * Alternatively, this software may be distributed under the terms of the
+ * GNU General Public License ("GPL") version 2 as published by the Free
+ * Software Foundation.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include "jtag_verify.h"
+
+/*
+ * The check is ((actual ^ expected) & mask) over whole words, stopping at
+ * the first word that is not zero and locating the failing bit in it with
+ * a count of trailing zeros. Where SSE2 or NEON is available, 16 byte
+ * blocks are tested first and only a failing block is looked at by words.
+ */
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define JTAG_VERIFY_BLOCK	16
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define JTAG_VERIFY_BLOCK	16
+#endif
+
+/* little endian load of bytes (1..8) bytes, unaligned */
+static inline uint64_t load_le(const unsigned char *p, unsigned int bytes)
+{
+	uint64_t v = 0;
+
+	memcpy(&v, p, bytes);
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+	v = __builtin_bswap64(v);
+#endif
+	return v;
+}
+
+#ifdef JTAG_VERIFY_BLOCK
+/* returns non zero if a checked bit of the 16 byte block differs */
+static inline int block_differs(const unsigned char *a, const unsigned char *e,
+				const unsigned char *m)
+{
+#if defined(__SSE2__)
+	__m128i d = _mm_xor_si128(_mm_loadu_si128((const __m128i *)a),
+				  _mm_loadu_si128((const __m128i *)e));
+
+	if (m)
+		d = _mm_and_si128(d, _mm_loadu_si128((const __m128i *)m));
+	return _mm_movemask_epi8(_mm_cmpeq_epi8(d, _mm_setzero_si128())) != 0xffff;
+#else
+	uint8x16_t d = veorq_u8(vld1q_u8(a), vld1q_u8(e));
+	uint64x2_t w;
+
+	if (m)
+		d = vandq_u8(d, vld1q_u8(m));
+	w = vreinterpretq_u64_u8(d);
+	return (vgetq_lane_u64(w, 0) | vgetq_lane_u64(w, 1)) != 0;
+#endif
+}
+#endif
+
+long jtag_verify(const void *actual, const void *expected, const void *mask,
+		 unsigned long bits)
+{
+	const unsigned char *a = actual;
+	const unsigned char *e = expected;
+	const unsigned char *m = mask;
+	unsigned long bytes = bits / 8;
+	unsigned long i = 0;
+	unsigned int rem;
+	uint64_t diff;
+
+#ifdef JTAG_VERIFY_BLOCK
+	for (; i + JTAG_VERIFY_BLOCK <= bytes; i += JTAG_VERIFY_BLOCK) {
+		if (block_differs(a + i, e + i, m ? m + i : NULL))
+			break;
+	}
+#endif
+	for (; i + 8 <= bytes; i += 8) {
+		diff = load_le(a + i, 8) ^ load_le(e + i, 8);
+		if (m)
+			diff &= load_le(m + i, 8);
+		if (diff)
+			return i * 8 + __builtin_ctzll(diff);
+	}
+
+	/* less than 64 bits left, the last byte may be partial */
+	rem = bits - i * 8;
+	if (rem) {
+		diff = load_le(a + i, (rem + 7) / 8) ^ load_le(e + i, (rem + 7) / 8);
+		if (m)
+			diff &= load_le(m + i, (rem + 7) / 8);
+		diff &= ((uint64_t)1 << rem) - 1;
+		if (diff)
+			return i * 8 + __builtin_ctzll(diff);
+	}
+	return -1;
+}
+
+/*
+ * Classify a MASK of bits bits. For a partial MASK, [*begin, *end) is the
+ * smallest range holding all checked bits, only it needs to be captured
+ * and compared.
+ */
+int jtag_verify_span(const void *mask, unsigned long bits,
+		     unsigned long *begin, unsigned long *end)
+{
+	const unsigned char *m = mask;
+	unsigned long i, first = bits, last = 0;
+	unsigned int n;
+	uint64_t w, valid;
+	int full = 1;
+
+	for (i = 0; i < bits; i += 64) {
+		n = bits - i < 64 ? bits - i : 64;
+		valid = n < 64 ? ((uint64_t)1 << n) - 1 : ~(uint64_t)0;
+		w = load_le(m + i / 8, (n + 7) / 8) & valid;
+		if (w != valid)
+			full = 0;
+		if (!w)
+			continue;
+		if (first == bits)
+			first = i + __builtin_ctzll(w);
+		last = i + 64 - __builtin_clzll(w);
+	}
+
+	*begin = 0;
+	*end = bits;
+	if (full)
+		return JTAG_VERIFY_FULL;
+	if (first == bits)
+		return JTAG_VERIFY_NONE;
+	*begin = first;
+	*end = last;
+	return JTAG_VERIFY_PARTIAL;
+}
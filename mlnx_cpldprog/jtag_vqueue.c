@@ -0,0 +1,127 @@
+/*
+ * Copyright (c) 2017 Mellanox Technologies. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the names of the copyright holders nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * Alternatively, this software may be distributed under the terms of the
+ * GNU General Public License ("GPL") version 2 as published by the Free
+ * Software Foundation.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <stdio.h>
+#include <string.h>
+#include "utilities.h"
+#include "jtag_verify.h"
+#include "jtag_vqueue.h"
+
+/*
+ * The checks are compared as the scans are shifted, with the word-wide
+ * jtag_verify(), which costs less than handing the buffers to another
+ * thread. Only the first failure is kept until the next checkpoint.
+ *
+ * With -pipeline the scans are checked on the transport thread, and the
+ * checkpoints run on the parser after jtag_pipe_drain(), which orders
+ * the two.
+ */
+static struct {
+	int active;
+	int line;		/* SVF line of the scans checked next */
+
+	/* first failure since the last checkpoint */
+	int failed;
+	int fail_line;
+	unsigned long fail_bit;
+
+	/* printed with -d */
+	unsigned long checks;
+	unsigned long failures;
+	unsigned long long bits;
+} g_vqueue;
+
+int jtag_vqueue_start(void)
+{
+	memset(&g_vqueue, 0, sizeof(g_vqueue));
+	g_vqueue.active = 1;
+	return OK;
+}
+
+int jtag_vqueue_active(void)
+{
+	return g_vqueue.active;
+}
+
+/* Set the SVF line that the failures of the following scans are reported at. */
+void jtag_vqueue_set_line(int line)
+{
+	g_vqueue.line = line;
+}
+
+/*
+ * Check bits bits of captured TDO in actual against expected under mask
+ * (NULL checks all bits). first_bit is where the checked bits start in
+ * the scan. A mismatch is kept for jtag_vqueue_sync(), the run goes on.
+ */
+void jtag_vqueue_check(const char *actual, const char *expected, const char *mask,
+		       unsigned long bits, unsigned long first_bit)
+{
+	long bit = jtag_verify(actual, expected, mask, bits);
+
+	g_vqueue.checks++;
+	g_vqueue.bits += bits;
+	if (bit < 0)
+		return;
+	g_vqueue.failures++;
+	if (!g_vqueue.failed) {
+		g_vqueue.failed = 1;
+		g_vqueue.fail_line = g_vqueue.line;
+		g_vqueue.fail_bit = first_bit + bit;
+	}
+}
+
+/*
+ * Checkpoint: returns 0 if every check since the last one passed,
+ * otherwise -1 with the SVF line of the first failing scan and the first
+ * failing bit in it. The failure is cleared.
+ */
+int jtag_vqueue_sync(int *line, unsigned long *bit)
+{
+	if (!g_vqueue.active || !g_vqueue.failed)
+		return 0;
+
+	*line = g_vqueue.fail_line;
+	*bit = g_vqueue.fail_bit;
+	g_vqueue.failed = 0;
+	return -1;
+}
+
+void jtag_vqueue_stop(void)
+{
+	g_vqueue.active = 0;
+}
+
+void jtag_vqueue_print_stats(void)
+{
+	printf("TDO checks deferred to checkpoints: %lu, bits: %llu, failed: %lu\n",
+			g_vqueue.checks, g_vqueue.bits, g_vqueue.failures);
+}
@@ -0,0 +1,119 @@
+/*
+ * Copyright (c) 2017 Mellanox Technologies. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the names of the copyright holders nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * Alternatively, this software may be distributed under the terms of the
+ * GNU General Public License ("GPL") version 2 as published by the Free
+ * Software Foundation.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <errno.h>
+#include <time.h>
+#include "jtag_wait.h"
+
+/* requested against measured waits, printed with -d */
+static struct {
+	unsigned long waits;
+	unsigned long spun;
+	unsigned long long requested;	/* us */
+	unsigned long long measured;	/* us */
+	unsigned long max_late;		/* us */
+} g_wait_stats;
+
+static void jtag_wait_add_us(struct timespec *ts, unsigned long usec)
+{
+	ts->tv_sec += usec / 1000000;
+	ts->tv_nsec += (usec % 1000000) * 1000;
+	if (ts->tv_nsec >= 1000000000) {
+		ts->tv_sec++;
+		ts->tv_nsec -= 1000000000;
+	}
+}
+
+static long long jtag_wait_diff_ns(const struct timespec *a, const struct timespec *b)
+{
+	return (a->tv_sec - b->tv_sec) * 1000000000LL + (a->tv_nsec - b->tv_nsec);
+}
+
+/*
+ * Wait usec microseconds against CLOCK_MONOTONIC. The deadline is absolute,
+ * so a sleep interrupted by a signal is resumed without drifting.
+ */
+void jtag_wait_us(unsigned long usec)
+{
+	struct timespec start, deadline, now;
+	unsigned long measured;
+
+	if (!usec)
+		return;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	deadline = start;
+	jtag_wait_add_us(&deadline, usec);
+
+	if (usec < JTAG_WAIT_SPIN_US) {
+		do {
+			clock_gettime(CLOCK_MONOTONIC, &now);
+		} while (jtag_wait_diff_ns(&deadline, &now) > 0);
+		g_wait_stats.spun++;
+	} else {
+		while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL) == EINTR)
+			;
+		clock_gettime(CLOCK_MONOTONIC, &now);
+	}
+
+	measured = jtag_wait_diff_ns(&now, &start) / 1000;
+	g_wait_stats.waits++;
+	g_wait_stats.requested += usec;
+	g_wait_stats.measured += measured;
+	if (measured > usec && measured - usec > g_wait_stats.max_late)
+		g_wait_stats.max_late = measured - usec;
+}
+
+/*
+ * A wait of sec seconds in microseconds, rounded up so that it is never
+ * shorter than the SVF asks for. The decimal SVF value is not exact in
+ * binary, up to a nanosecond above a whole microsecond is taken as that
+ * microsecond.
+ */
+unsigned long jtag_wait_sec_to_us(double sec)
+{
+	double usec = sec * 1000000;
+	unsigned long whole;
+
+	if (usec <= 0)
+		return 0;
+	whole = (unsigned long)usec;
+	return (usec - whole > 0.001) ? whole + 1 : whole;
+}
+
+void jtag_wait_print_stats(void)
+{
+	printf("Waits: %lu (%lu spun), requested %llu us, measured %llu us, worst overshoot %lu us\n",
+			g_wait_stats.waits, g_wait_stats.spun, g_wait_stats.requested,
+			g_wait_stats.measured, g_wait_stats.max_late);
+}
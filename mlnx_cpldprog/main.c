@@ -77,11 +77,25 @@
 #include "utilities.h"
 #include "main.h"
 #include "jtag_handlers.h"
-
-FILE * g_pSVFFile, * g_pVMEFile;
-int g_JTAGFile = -1;
-char  buffer[strmax];   /*memory to store a string temporary          */
+#include "svf_lexer.h"
+#include "svf_keywords.h"
+#include "svf_index.h"
+#include "jtag_plan.h"
+#include "svf_hex.h"
+#include "jtag_stream.h"
+#include "jtag_vqueue.h"
+#include "jtag_pipe.h"
+#include "jtag_wait.h"
+#include "jtag_clock.h"
+#include "jtag_backend.h"
+#include "jtag_poll.h"
+
+FILE * g_pVMEFile;
 char  * g_pszSVFString;   /*pointer to current token string*/
+svf_lexer_t * g_pSVFLexer;       /*mapped SVF file being converted*/
+svf_token_t g_SVFToken;          /*current token, points into g_pSVFLexer*/
+char  * g_pszTokenBuffer = NULL; /*null terminated copy of g_SVFToken*/
+unsigned int g_uiTokenBufferSize = 0;
 long int g_iFrequency = 0; /* Stores the active frequency (in Hz) */
 int g_iSVFLineIndex = 0;            /*keeps the svfline number read*/
 int headIR = 0, tailIR = 0, headDR = 0, tailDR = 0;
@@ -128,7 +142,6 @@ void EncodeCRC( const char * a_pszVMEFilename );
 void LCOUNTCom();
 void writeIntelProgramData();
 
-int (*write_handler)(unsigned  char reset, char data) = null_handler;
 int g_errStatus = 0;
 char g_direct_prog = 0;
 
@@ -144,54 +157,6 @@ static struct stableState
 	{ "DRCAPTURE", DRCAPTURE} /*11/15/05 Nguyen changed to support DRCAPTURE*/
 };
 
-static struct scanToken 
-{
-	char * text;
-	int token;
-} scanTokens[] = 
-{
-	/*********************************************************************
-	*
-	* Supported SVF keywords.
-	*
-	*********************************************************************/
-
-	{ ";", ENDDATA },
-	{ "SIR", SIR }, { "SDR", SDR },
-	{ "TDI", TDI }, { "TDO", TDO }, { "MASK", MASK },
-	{ "STATE", STATE },
-	{ "TCK", TCK, }, { "WAIT", WAIT },
-	{ "XSDR", XSDR }, { "XTDI", XTDI }, { "XTDO", XTDO },
-	{ "ENDDR", ENDDR },
-	{ "ENDIR", ENDIR },
-	{ "HIR", HIR }, { "TIR", TIR }, { "HDR", HDR }, { "TDR", TDR },
-	{ "MEM", MEM },
-	{ "RUNTEST", RUNTEST },
-	{ "ENDSTATE", ENDSTATE },
-	{ "TRST", TRST },
-	{ "FREQUENCY", FREQUENCY },
-	{ "SEC", SEC },
-	{ "SMASK", SMASK },
-	{ "MAXIMUM", MAX },
-	{"ON", ON},{"OFF", OFF},{"ISPEN",ispEN}, {"HIGH", HIGH},{"LOW", LOW},
-	{ "SETFLOW", SETFLOW }, { "RESETFLOW", RESETFLOW },
-	{ "REPEAT", REPEAT }, { "ENDLOOP", ENDLOOP },
-	{ "(", LEFTPAREN }, 
-	{ "CRC", CRC },
-	{ "CMASK", CMASK },
-	{ "RMASK", RMASK },
-	{ "READ", READ },
-	{ "DMASK", DMASK },
-	{ "VUES",  VUES },
-	{ "LCOUNT", LCOUNT },
-	{ "LDELAY", LDELAY },
-	{ "LSDR", LSDR },
-	{ "LVDS", LVDS },
-	{ "LOOP", LOOP }
-};
-
-int ScanTokenMax = sizeof( scanTokens ) / sizeof( scanTokens[ 0 ] );
-
 /* 3 scan nodes is reserved:
    0 is for SIR, 1 is for SDR and 2 is to store previous SDR */ 
 /* 4/26/2001 ht Add 1 scan nodes to store the HIR,TIR,HDR and TDR info */
@@ -214,17 +179,18 @@ struct scanNode
 };
 
 CFG * cfgChain = NULL;
+int g_iCFGCount = 0;	/* number of entries allocated in cfgChain */
 
 
 
-void print_progress(unsigned int pos, unsigned int total)
+void print_progress(unsigned long pos, unsigned long total)
 {
 	static char last_progress = -1;
 	char progress = 0;
 
-	if (pos > total)
+	if ((pos > total) || (total == 0))
 		return;
-	progress = (char)((pos * 100) / total);
+	progress = (char)(((unsigned long long)pos * 100) / total);
 	if (progress != last_progress){
 		last_progress = progress;
 		printf("\b\b\b\b\b\b\b\b\b\b\b\b\b\bprogress %3d%%", progress);
@@ -290,6 +256,46 @@ void ConvNumber( long int number )
 	g_errStatus |= write( ( unsigned char ) number );
 }
 
+/*********************************************************************
+*                                                                    *
+* WriteComment                                                       *
+*                                                                    *
+* Called by the lexer for every SVF comment when the comment option  *
+* is passed in via command line.  Writes the comment into the VME    *
+* file.                                                              *
+*                                                                    *
+*********************************************************************/
+
+static void WriteComment( const char * a_pszComment, unsigned int a_uiLength )
+{
+	unsigned int uiIndex;
+
+	write( COMMENT );
+	ConvNumber( a_uiLength );
+	for ( uiIndex = 0; uiIndex < a_uiLength; uiIndex++ ) {
+		write( a_pszComment[ uiIndex ] );
+	}
+}
+
+/*********************************************************************
+*                                                                    *
+* TokenSpan                                                          *
+*                                                                    *
+* Stores the next token of the mapped SVF file in g_SVFToken without *
+* copying it.  Returns 1 when EOF or 0 when passing.                 *
+*                                                                    *
+*********************************************************************/
+
+static int TokenSpan( const char * delimiters )
+{
+	int iRetCode;
+
+	iRetCode = svf_lexer_next( g_pSVFLexer, delimiters, &g_SVFToken );
+	g_iSVFLineIndex = g_SVFToken.line;
+
+	return iRetCode;
+}
+
 /*********************************************************************
 *                                                                    *
 * Token                                                              *
@@ -301,141 +307,148 @@ void ConvNumber( long int number )
 
 int Token( const char * delimiters )
 {
-	int iStringIndex, iTempIndex, iStringLength, iCommentIndex;
+	int iRetCode;
+	char * pszBuffer;
 
-	if ( ( g_pszSVFString == NULL ) || ( ( g_pszSVFString = strtok( NULL, delimiters ) ) == NULL ) || ( g_pszSVFString[ 0 ] == '\n' ) || 
-		 ( g_pszSVFString[ 0 ] == '!' || ( g_pszSVFString[ 0 ] == '/' ) ) ) {
-		do {
+	iRetCode = TokenSpan( delimiters );
+	if ( iRetCode ) {
+		g_pszSVFString = "";
+		return iRetCode;
+	}
 
-			/*********************************************************************
-			*                                                                    *
-			* Get a string from the SVF file and increment the line index.       *
-			*                                                                    *
-			*********************************************************************/
+	/*********************************************************************
+	*                                                                    *
+	* Keywords and numbers are short.  Hex data is read through          *
+	* TokenSpan() and never copied here, so the buffer rarely grows.     *
+	*                                                                    *
+	*********************************************************************/
 
-			g_iSVFLineIndex++;
-			if ( fgets( buffer, strmax, g_pSVFFile ) == NULL ) {
+	if ( g_SVFToken.len >= g_uiTokenBufferSize ) {
+		if ( ( pszBuffer = ( char * ) realloc( g_pszTokenBuffer, g_SVFToken.len + 1 ) ) == NULL ) {
+			g_pszSVFString = "";
+			return OUT_OF_MEMORY;
+		}
+		g_pszTokenBuffer = pszBuffer;
+		g_uiTokenBufferSize = g_SVFToken.len + 1;
+	}
 
-				/*********************************************************************
-				*                                                                    *
-				* File has reached EOF, return 1.                                    *
-				*                                                                    *
-				*********************************************************************/
+	memcpy( g_pszTokenBuffer, g_SVFToken.ptr, g_SVFToken.len );
+	g_pszTokenBuffer[ g_SVFToken.len ] = '\0';
+	g_pszSVFString = g_pszTokenBuffer;
 
-				return ( 1 );
-			}
+	return ( 0 );
+}
 
-			iStringLength = strlen( buffer ) + 1;
-			if ( iStringLength > 2 ) {
-				for ( iStringIndex = 0; iStringIndex < iStringLength; iStringIndex++ ) {
-					switch ( buffer[ iStringIndex ] ) {
-					case '\t':
-						
-						/*********************************************************************
-						*                                                                    *
-						* Replace tab with space.                                            *
-						*                                                                    *
-						*********************************************************************/
 
-						buffer[ iStringIndex ] = ' ';
-						break;
-					case '\r':
-						
-						/*********************************************************************
-						*                                                                    *
-						* Replace return carriage with space.                                *
-						*                                                                    *
-						*********************************************************************/
+/*********************************************************************
+*
+* SetChainTrailer
+*
+* Sets a header or trailer of the direct programming player to the
+* given number of BYPASS bits: ones for HIR/TIR, zeros for HDR/TDR.
+*
+*********************************************************************/
 
-						buffer[ iStringIndex ] = ' ';
-						break;
-					case ';':
-					case '(':
-					case ')':
+static short int SetChainTrailer( unsigned char a_ucType, int a_iBits )
+{
+	char * pcData = NULL;
+	short int siRetCode;
 
-						/*********************************************************************
-						*                                                                    *
-						* Insert spaces before the characters ";()" to allow tokenizing.     *
-						*                                                                    *
-						*********************************************************************/
+	if ( a_iBits ) {
+		if ( ( pcData = ( char * ) malloc( ( a_iBits + 7 ) / 8 ) ) == NULL ) {
+			return OUT_OF_MEMORY;
+		}
+		memset( pcData, ( ( a_ucType == HIR ) || ( a_ucType == TIR ) ) ? 0xFF : 0x00, ( a_iBits + 7 ) / 8 );
+	}
 
-						for ( iTempIndex = iStringLength + 2; iTempIndex > iStringIndex + 2; iTempIndex-- ) {
-							buffer[ iTempIndex ] = buffer[ iTempIndex - 2 ];
-						}
+	siRetCode = jtag_pipe_set_trailer( a_ucType, a_iBits, pcData ) ? VERIFY_FAILURE : OK;
+	free( pcData );
+	return siRetCode;
+}
 
-						buffer[ iTempIndex-- ] = ' ';
-						buffer[ iTempIndex-- ] = buffer[ iStringIndex ];
-						buffer[ iStringIndex ] = ' ';
-						iStringLength += 2;
-						iStringIndex += 2;
-						break;
-					case '/':
-						if ( buffer[ iStringIndex + 1 ] != '/' ) {
-							return FILE_ERROR;
-						}
-					case '!':
-						if ( !g_ucComment ) {
+/*********************************************************************
+*
+* DirectCheckpoint
+*
+* Waits for the queued commands and TDO checks. Returns VERIFY_FAILURE with
+* g_iSVFLineIndex set to the line of the first failing scan, if any.
+*
+*********************************************************************/
 
-							/*********************************************************************
-							*                                                                    *
-							* Comment option not passed in via command line.  Skip the comment   *
-							* by setting iStringIndex = iStringLength.                           *
-							*                                                                    *
-							*********************************************************************/
+static short int DirectCheckpoint( void )
+{
+	unsigned long ulBit;
+	int iLine;
 
-							iStringIndex = iStringLength;
-							break;
-						}
+	if ( jtag_pipe_drain() != 0 ) {
+		return VERIFY_FAILURE;
+	}
+	if ( jtag_vqueue_sync( &iLine, &ulBit ) == 0 ) {
+		return 0;
+	}
 
-						/*********************************************************************
-						*                                                                    *
-						* Write the comment into the VME file.                               *
-						*                                                                    *
-						*********************************************************************/
-						
-						write( COMMENT );
-						ConvNumber( iStringLength - iStringIndex - 2 );
-						for ( iCommentIndex = iStringIndex; buffer[ iCommentIndex ] != '\n'; iCommentIndex++ ) {
-							write( buffer[ iCommentIndex ] );
+	printf( "\nTDO mismatch at bit %lu of the scan in SVF line %d\n", ulBit, iLine );
+	g_iSVFLineIndex = iLine;
+	return VERIFY_FAILURE;
+}
 
-							/*********************************************************************
-							*                                                                    *
-							* Replace the character with space.  This is done to prevent the     *
-							* comment from being written more than once.  For example, if the    *
-							* character is not replaced with a space, then the following legal   *
-							* SVF comments would be written more than once:                      *
-							*                                                                    *
-							* !! SVF Comment.                                                    *
-							* !!! SVF Comment.                                                   *
-							* /// SVF Comment.                                                   *
-							* //// SVF Comment.                                                  *
-							*                                                                    *
-							*********************************************************************/
+/*********************************************************************
+*
+* DirectLoop
+*
+* Runs the LOOP or LCOUNT loop just closed after the queued commands
+* and TDO checks. Returns VERIFY_FAILURE with g_iSVFLineIndex set to the
+* line of the scan that failed last if no run of the loop passed.
+*
+*********************************************************************/
 
-							buffer[ iCommentIndex ] = ' ';
-						}
-						break;
-					default:
-						break;
-					}
-				}
-			}
-			
-			/*********************************************************************
-			*                                                                    *
-			* Get the first token of g_pszSVFString.                                 *
-			*                                                                    *
-			*********************************************************************/
-			
-			g_pszSVFString = strtok( buffer, delimiters );
+static short int DirectLoop( void )
+{
+	short int rcode;
+	int iLine = 0;
 
-		} while ( ( g_pszSVFString == NULL ) || ( g_pszSVFString[ 0 ] == '\r' ) || ( g_pszSVFString[ 0 ] == '\n' ) ||
-			      ( g_pszSVFString[ 0 ] == '!' ) || ( g_pszSVFString[ 0 ] == '/' ) );
-    }
-	
-	return ( 0 );
+	if ( ( rcode = DirectCheckpoint() ) != 0 ) {
+		return rcode;
+	}
+
+	switch ( jtag_poll_loop_run( &iLine ) ) {
+	case 0:
+		return 0;
+	case 1:
+		printf( "\nTDO mismatch in every run of the loop, last at SVF line %d\n", iLine );
+		g_iSVFLineIndex = iLine;
+		return VERIFY_FAILURE;
+	default:
+		return VERIFY_FAILURE;
+	}
 }
 
+/*********************************************************************
+*
+* DirectFrequency
+*
+* Sets the TCK of direct programming to g_iFrequency, if there is one.
+* With a_bAuto the fastest TCK the chain reads back reliably at is
+* found first and stored in g_iFrequency, after the queued commands.
+*
+*********************************************************************/
+
+static short int DirectFrequency( bool a_bAuto )
+{
+	if ( a_bAuto ) {
+		if ( jtag_pipe_drain() != 0 ) {
+			return VERIFY_FAILURE;
+		}
+		g_iFrequency = jtag_clock_auto();
+		if ( g_iFrequency < 0 ) {
+			return ( short int ) g_iFrequency;
+		}
+	}
+	if ( g_iFrequency <= 0 ) {
+		return 0;
+	}
+	return jtag_pipe_set_frequency( g_iFrequency ) ? VERIFY_FAILURE : 0;
+}
 
 /*************************************************************************
 * ispsvf_convert()                                                       *
@@ -449,17 +462,15 @@ int Token( const char * delimiters )
 *************************************************************************/
 short int ispsvf_convert( int chips, CFG * chain, char * vmefilename, bool compress )
 {
-	short int  i, j, rcode = 0, rcode_prog = 0;
+	short int  i, j, rcode = 0;
 	int device;
 	char filler = 0;
 	long int scan_len;
 	char opcode;
+	int iToken;
 	int temp;
 	char xchar;
 	int iStringIndex,iStringLength;
-	unsigned long int SVFfile_size = 0;
-	unsigned long int SVFfile_pos = 0;
-	struct stat filestat;
 	static struct header 
 	{
 		unsigned char types;
@@ -600,15 +611,15 @@ short int ispsvf_convert( int chips, CFG * chain, char * vmefilename, bool compr
 		}
 		
 		if ( stricmp( chain[ device ].name, "SVF" ) == 0 ) {    
-			if ( ( g_pSVFFile = fopen( chain[ device ].Svffile, "r" ) ) == NULL ) {
-				if (g_direct_prog == 0)
-					fclose( g_pVMEFile );
-				return FILE_NOT_FOUND;
-			}
-			
-			stat(chain[ device ].Svffile, &filestat);
-			SVFfile_size = filestat.st_size;
-			SVFfile_pos = 0;
+			/*********************************************************************
+			*
+			* Reuse the mapping of the pre-scan instead of reading the file again.
+			*
+			*********************************************************************/
+
+			g_pSVFLexer = &chain[ device ].index->lex;
+			svf_lexer_rewind( g_pSVFLexer );
+			g_pSVFLexer->comment_cb = g_ucComment ? WriteComment : NULL;
 
 			/*********************************************************************
 			*
@@ -617,6 +628,12 @@ short int ispsvf_convert( int chips, CFG * chain, char * vmefilename, bool compr
 			*********************************************************************/
 
 			g_iFrequency = chain[ device ].Frequency;
+			if ( g_direct_prog ) {
+				rcode = DirectFrequency( g_iFrequency == CLOCK_AUTO );
+				if ( rcode ) {
+					return rcode;
+				}
+			}
 			
 			if ( chips > 1 ) {
 				for ( i = 0; i < 4; i++ ) {
@@ -655,6 +672,22 @@ short int ispsvf_convert( int chips, CFG * chain, char * vmefilename, bool compr
 				}
 
 				for ( i = 0; i < 4; i++ ) {
+					if ( g_direct_prog ) {
+
+						/*********************************************************************
+						*
+						* Pad the scans with the BYPASS instruction and register of the other
+						* devices.
+						*
+						*********************************************************************/
+
+						rcode = SetChainTrailer( headers[ i ].types, headers[ i ].value );
+						if ( rcode ) {
+							return rcode;
+						}
+						continue;
+					}
+
 					write( headers[ i ].types );
 					if ( headers[ i ].value ) {
 						write( ( unsigned char ) ( headers[ i ].value ) );
@@ -691,20 +724,15 @@ short int ispsvf_convert( int chips, CFG * chain, char * vmefilename, bool compr
 			*
 			*********************************************************************/
 			
-			g_pszSVFString = NULL;
-			while ( ( rcode == 0 ) /*&& (rcode_prog == 0)*/ && ( ( rcode = Token( " \n" ) ) == 0 ) ) {
+			while ( ( rcode == 0 ) && ( ( rcode = Token( " \n" ) ) == 0 ) ) {
 				
 				/*********************************************************************
 				*
 				* Check if there exists an opcode for the corresponding SVF token.
 				*
 				*********************************************************************/
-				for ( i = 0; i < ScanTokenMax; i++ ) {
-					if ( stricmp( scanTokens[ i ].text, g_pszSVFString ) == 0 ) {  
-						break;
-					}
-				}
-				if ( i >= ScanTokenMax ) {
+				iToken = svf_keyword_lookup( g_SVFToken.ptr, g_SVFToken.len );
+				if ( iToken == SVF_KEYWORD_NONE ) {
 
 					/*********************************************************************
 					*
@@ -715,30 +743,20 @@ short int ispsvf_convert( int chips, CFG * chain, char * vmefilename, bool compr
 						fclose( g_pVMEFile );
 					return FILE_ERROR;
 				}
-				SVFfile_pos = ftell(g_pSVFFile);
-				print_progress(SVFfile_pos, SVFfile_size);
-				opcode = scanTokens[ i ].token; 
+				print_progress(g_SVFToken.offset, g_pSVFLexer->size);
+				opcode = ( char ) iToken;
 				switch (opcode){
                 case SDR:
-                	write_handler = jtag_cmd_handler;
-                	write_handler(WRITE_HANDLER_INIT_CMD, SDR);
 					rcode = ScanCom( 1, compress );
-					rcode_prog = write_handler(WRITE_HANDLER_SEND_CMD, 0);
 					break;
                 case SIR:
-                	write_handler = jtag_cmd_handler;
-                	write_handler(WRITE_HANDLER_INIT_CMD, SIR);
                 	rcode = ScanCom( 0, compress );
-                	rcode_prog = write_handler(WRITE_HANDLER_SEND_CMD, 0);
 					break;
                 case STATE: 
 					rcode = STATECom(); 
 					break;
                 case RUNTEST:
-                	write_handler = runtest_handler;
-                	write_handler(WRITE_HANDLER_INIT_CMD, RUNTEST);
 					rcode = RUNTESTCom( chain[ device ].MaxTCK, chain[ device ].noMaxTCK ); 
-					rcode_prog = write_handler(WRITE_HANDLER_SEND_CMD, 0);
 					break;	
                 case ENDIR: 
 					rcode = Token( " " );
@@ -754,6 +772,9 @@ short int ispsvf_convert( int chips, CFG * chain, char * vmefilename, bool compr
 					else { 
 						write( ( char ) j );
 						CurEndIR = j;
+						if ( g_direct_prog && jtag_pipe_state( ENDIR, stableStates[ j ].state ) ) {
+							rcode = VERIFY_FAILURE;
+						}
 					}
 					break;
 				case ENDDR: 
@@ -770,18 +791,17 @@ short int ispsvf_convert( int chips, CFG * chain, char * vmefilename, bool compr
 					else {
 						write( ( char ) j );
 						CurEndDR = j;
+						if ( g_direct_prog && jtag_pipe_state( ENDDR, stableStates[ j ].state ) ) {
+							rcode = VERIFY_FAILURE;
+						}
 					}
 					break;
 				case HDR: 
                 case HIR:
                 case TIR:
                 case TDR:
-                	write_handler = jtag_cmd_handler;
-                	write_handler(WRITE_HANDLER_INIT_CMD, opcode);
-
 					if ( chips > 1 ) {
 						rcode = Token( ";" );
-						rcode_prog = write_handler(WRITE_HANDLER_SEND_CMD, 0);
 						break;
 					}
 					
@@ -790,6 +810,9 @@ short int ispsvf_convert( int chips, CFG * chain, char * vmefilename, bool compr
 					scan_len = atol( g_pszSVFString );
 					if ( scan_len == 0 ) {
 						ConvNumber( scan_len );
+						if ( g_direct_prog ) {
+							jtag_pipe_set_trailer( opcode, 0, NULL );
+						}
 					}
 					else {
 						if ( scan_len > ( long int ) g_iMaxBufferSize ) {
@@ -813,8 +836,10 @@ short int ispsvf_convert( int chips, CFG * chain, char * vmefilename, bool compr
 						*********************************************************************/
 
 						rcode = TDIToken( scan_len, 3, 0 );
+						if ( ( rcode == 0 ) && g_direct_prog ) {
+							rcode = jtag_pipe_set_trailer( opcode, scan_len, ( char * ) scanNodes[ 3 ].tdi ) ? VERIFY_FAILURE : 0;
+						}
 					}
-					rcode_prog = write_handler(WRITE_HANDLER_SEND_CMD, 0);
 					break;
 				case FREQUENCY:
 					rcode = FREQUENCYCom();
@@ -849,6 +874,9 @@ short int ispsvf_convert( int chips, CFG * chain, char * vmefilename, bool compr
 					*********************************************************************/
 
 					writeIntelProgramData();
+					if ( ( rcode == 0 ) && g_direct_prog ) {
+						rcode = DirectLoop();
+					}
 					break;
 				case LOOP:
 					LCOUNTCom();
@@ -870,6 +898,9 @@ short int ispsvf_convert( int chips, CFG * chain, char * vmefilename, bool compr
 					*********************************************************************/
 
 					writeIntelProgramData();
+					if ( g_direct_prog ) {
+						rcode = DirectLoop();
+					}
 					break;
 				case VUES:
 
@@ -925,6 +956,16 @@ short int ispsvf_convert( int chips, CFG * chain, char * vmefilename, bool compr
 				}
 			}
 			
+			/*********************************************************************
+			*
+			* The end of the SVF file is a checkpoint too.
+			*
+			*********************************************************************/
+
+			if ( g_direct_prog && ( rcode >= 0 ) && ( ( j = DirectCheckpoint() ) != 0 ) ) {
+				rcode = j;
+			}
+
 			if ( scanNodes[ 0 ].mask != NULL ) {
 				free( scanNodes[ 0 ].mask ); 
 				scanNodes[ 0 ].mask = NULL;
@@ -941,7 +982,8 @@ short int ispsvf_convert( int chips, CFG * chain, char * vmefilename, bool compr
 					scanNodes[ i ].tdi = NULL;
 				}
 			}
-			fclose( g_pSVFFile );
+			g_pSVFLexer->comment_cb = NULL;
+			g_pSVFLexer = NULL;
 		}
 		else if ( stricmp( chain[ device ].name, "JTAG" ) == 0 ) {
 		
@@ -999,6 +1041,14 @@ short int STATECom()
 		else {
 			write( STATE );
 			write( ( char ) i );
+			if ( g_direct_prog && ( g_usFlowControlRegister & INTEL_PRGM ) ) {
+				if ( jtag_poll_loop_state( stableStates[ i ].state ) ) {
+					return OUT_OF_MEMORY;
+				}
+			}
+			else if ( g_direct_prog && jtag_pipe_state( STATE, stableStates[ i ].state ) ) {
+				return VERIFY_FAILURE;
+			}
 		}
 		
 		rcode = Token(" ");
@@ -1006,6 +1056,38 @@ short int STATECom()
 	return rcode;
 }
 
+/*********************************************************************
+*                                                                    *
+* RunTestTCK / RunTestWait                                           *
+*                                                                    *
+* Write a TCK or WAIT operand of the current RUNTEST. TCK operands   *
+* are accumulated for direct programming. WAIT operands with the MSB *
+* set are in whole milliseconds, so direct programming takes the     *
+* wait from RunTestUsec() instead, in microseconds rounded up.       *
+*                                                                    *
+*********************************************************************/
+
+static unsigned long g_ulRunTestTCK = 0;
+static unsigned long g_ulRunTestUsec = 0;
+
+static void RunTestTCK( long int a_iTCK )
+{
+	write( TCK );
+	ConvNumber( a_iTCK );
+	g_ulRunTestTCK += a_iTCK;
+}
+
+static void RunTestWait( long int a_iWait )
+{
+	write( WAIT );
+	ConvNumber( a_iWait );
+}
+
+static void RunTestUsec( double a_dSec )
+{
+	g_ulRunTestUsec += jtag_wait_sec_to_us( a_dSec );
+}
+
 /*********************************************************************
 *                                                                    *
 * RUNTESTCom                                                         *
@@ -1019,8 +1101,13 @@ short int RUNTESTCom( unsigned int max_tck , short int noMaxTCK )
 	short int siRetCode = 0;
 	short int siIndex = 0;
 	float fTime = 0;
+	double dTime = 0;
 	unsigned long ulTime = 0;
 	int iState = -1;
+	int iEndState = -1;
+
+	g_ulRunTestTCK = 0;
+	g_ulRunTestUsec = 0;
 	
 	while ( ( siRetCode = Token( " " ) ) == 0 ) {
 
@@ -1067,6 +1154,7 @@ short int RUNTESTCom( unsigned int max_tck , short int noMaxTCK )
 
 				write( STATE );
 				write( ( unsigned char ) stableStates[ siIndex ].state );
+				iEndState = stableStates[ siIndex ].state;
 			}
 		}
 		else if ( ( strchr( g_pszSVFString, 'E' ) != NULL ) || ( strchr( g_pszSVFString, 'e' ) != NULL ) ) {
@@ -1078,7 +1166,8 @@ short int RUNTESTCom( unsigned int max_tck , short int noMaxTCK )
 			*                                                                    *
 			*********************************************************************/
 
-			fTime = ( float ) atof( g_pszSVFString );
+			dTime = atof( g_pszSVFString );
+			fTime = ( float ) dTime;
 
 			Token( " " );
 			if ( ( fTime > 0 ) && !stricmp( g_pszSVFString, "SEC" ) ) {
@@ -1086,15 +1175,15 @@ short int RUNTESTCom( unsigned int max_tck , short int noMaxTCK )
 				if(noMaxTCK){
 					fTime = fTime * g_iFrequency;
 					while(fTime > 0xFFFF){
-						write( TCK );
-						ConvNumber(0xFFFF);
+						RunTestTCK( 0xFFFF );
 						fTime -= 0xFFFF;
 					}
-					write( TCK );
-					ConvNumber( fTime );
+					RunTestTCK( fTime );
 				}
 
 				else{
+					RunTestUsec( dTime );
+
 					/*********************************************************************
 					*                                                                    *
 					* Convert delay from seconds to microseconds.                        *
@@ -1138,8 +1227,7 @@ short int RUNTESTCom( unsigned int max_tck , short int noMaxTCK )
 							*                                                                    *
 							*********************************************************************/
 
-							write( WAIT );
-							ConvNumber( 0x7FFF + 0x8000 );
+							RunTestWait( 0x7FFF + 0x8000 );
 
 							/*********************************************************************
 							*                                                                    *
@@ -1159,8 +1247,7 @@ short int RUNTESTCom( unsigned int max_tck , short int noMaxTCK )
 						fTime += 0x8000;
 					}
 					
-					write( WAIT );
-					ConvNumber( ( long ) fTime );
+					RunTestWait( ( long ) fTime );
 				}
 			}
 			else {
@@ -1207,8 +1294,7 @@ short int RUNTESTCom( unsigned int max_tck , short int noMaxTCK )
 						* Write the first chunk of 0xFFFF TCK toggles.                       *
 						*                                                                    *
 						*********************************************************************/
-						write( TCK );
-						ConvNumber( ( unsigned long ) 0xFFFF );
+						RunTestTCK( ( unsigned long ) 0xFFFF );
 						ulTime -= 0xFFFF;
 					}
 					/*********************************************************************
@@ -1216,8 +1302,7 @@ short int RUNTESTCom( unsigned int max_tck , short int noMaxTCK )
 					* Write the TCK toggles.                                             *
 					*                                                                    *
 					*********************************************************************/
-					write( TCK );
-					ConvNumber( ulTime );
+					RunTestTCK( ulTime );
 				}
 				else{
 					/*********************************************************************
@@ -1246,8 +1331,7 @@ short int RUNTESTCom( unsigned int max_tck , short int noMaxTCK )
 							*                                                                    *
 							*********************************************************************/
 
-							write( TCK );
-							ConvNumber( ( unsigned long ) 0xFFFF );
+							RunTestTCK( ( unsigned long ) 0xFFFF );
 							ulTime -= 0xFFFF;
 						}
 
@@ -1257,8 +1341,7 @@ short int RUNTESTCom( unsigned int max_tck , short int noMaxTCK )
 						*                                                                    *
 						*********************************************************************/
 
-						write( TCK );
-						ConvNumber( ulTime );
+						RunTestTCK( ulTime );
 						ulTime = max_tck;
 
 						// Rev. 12.2 Chuo remove writing wait time if TCK is not converted
@@ -1359,8 +1442,7 @@ short int RUNTESTCom( unsigned int max_tck , short int noMaxTCK )
 								*                                                                    *
 								*********************************************************************/
 
-								write( TCK );
-								ConvNumber( ( unsigned long ) 0xFFFF );
+								RunTestTCK( ( unsigned long ) 0xFFFF );
 								ulTime -= 0xFFFF;
 							}
 
@@ -1370,8 +1452,7 @@ short int RUNTESTCom( unsigned int max_tck , short int noMaxTCK )
 							*                                                                    *
 							*********************************************************************/
 
-							write( TCK );
-							ConvNumber( ulTime );
+							RunTestTCK( ulTime );
 						}
 						else {
 
@@ -1391,8 +1472,7 @@ short int RUNTESTCom( unsigned int max_tck , short int noMaxTCK )
 								*                                                                    *
 								*********************************************************************/
 
-								write( TCK );
-								ConvNumber( ( unsigned long ) 0xFFFF );
+								RunTestTCK( ( unsigned long ) 0xFFFF );
 								max_tck -= 0xFFFF;
 							}
 
@@ -1404,6 +1484,7 @@ short int RUNTESTCom( unsigned int max_tck , short int noMaxTCK )
 							
 							fTime = ( float ) ulTime / ( float ) g_iFrequency;
 							fTime = fTime * 1000000;
+							RunTestUsec( ( double ) ulTime / g_iFrequency );
 							
 							//Rev. 12.2 Chuo updated max_tck option to write remainder TCK instead of max tck
 							//if(g_iFrequency >= 1000000){
@@ -1419,8 +1500,7 @@ short int RUNTESTCom( unsigned int max_tck , short int noMaxTCK )
 							*                                                                    *
 							*********************************************************************/
 
-							write( TCK );
-							ConvNumber(max_tck);
+							RunTestTCK( max_tck );
 							//ConvNumber( temp );
 							//Rev. 12.2 Chuo updated max_tck option to write remainder TCK instead of max tck
 							//if(temp){
@@ -1464,8 +1544,7 @@ short int RUNTESTCom( unsigned int max_tck , short int noMaxTCK )
 									*                                                                    *
 									*********************************************************************/
 
-									write( WAIT );
-									ConvNumber( 0x7FFF + 0x8000 );
+									RunTestWait( 0x7FFF + 0x8000 );
 
 									/*********************************************************************
 									*                                                                    *
@@ -1485,8 +1564,7 @@ short int RUNTESTCom( unsigned int max_tck , short int noMaxTCK )
 								fTime += 0x8000;
 							}
 							
-							write( WAIT );
-							ConvNumber( ( long ) fTime );
+							RunTestWait( ( long ) fTime );
 						}
 					}
 				}
@@ -1496,15 +1574,15 @@ short int RUNTESTCom( unsigned int max_tck , short int noMaxTCK )
 				if(noMaxTCK){
 					ulTime = ulTime * g_iFrequency;
 					while(ulTime > 0xFFFF){
-						write( TCK );
-						ConvNumber(0xFFFF);
+						RunTestTCK( 0xFFFF );
 						ulTime -= 0xFFFF;
 					}
 
-					write( TCK );
-					ConvNumber( ulTime );
+					RunTestTCK( ulTime );
 				}
 				else{
+					RunTestUsec( ulTime );
+
 					/*********************************************************************
 					*                                                                    *
 					* Convert delay from seconds to microseconds.                        *
@@ -1548,8 +1626,7 @@ short int RUNTESTCom( unsigned int max_tck , short int noMaxTCK )
 							*                                                                    *
 							*********************************************************************/
 
-							write( WAIT );
-							ConvNumber( 0x7FFF + 0x8000 );
+							RunTestWait( 0x7FFF + 0x8000 );
 
 							/*********************************************************************
 							*                                                                    *
@@ -1569,8 +1646,7 @@ short int RUNTESTCom( unsigned int max_tck , short int noMaxTCK )
 						ulTime += 0x8000;
 					}
 					
-					write( WAIT );
-					ConvNumber( ulTime );
+					RunTestWait( ulTime );
 				}
 			}
 			else {
@@ -1617,6 +1693,30 @@ short int RUNTESTCom( unsigned int max_tck , short int noMaxTCK )
 		}
 	}
 
+	if ( g_direct_prog && ( siRetCode >= 0 ) && ( g_usFlowControlRegister & INTEL_PRGM ) ) {
+
+		/*********************************************************************
+		*                                                                    *
+		* LDELAY and the RUNTEST of a LOOP are run with the loop.            *
+		*                                                                    *
+		*********************************************************************/
+
+		if ( jtag_poll_loop_runtest( ( iState == -1 ) ? IDLE : iState, g_ulRunTestTCK, g_ulRunTestUsec ) ) {
+			siRetCode = OUT_OF_MEMORY;
+		}
+		else if ( ( iEndState != -1 ) && jtag_poll_loop_state( iEndState ) ) {
+			siRetCode = OUT_OF_MEMORY;
+		}
+	}
+	else if ( g_direct_prog && ( siRetCode >= 0 ) ) {
+		if ( jtag_pipe_runtest( ( iState == -1 ) ? IDLE : iState, g_ulRunTestTCK, g_ulRunTestUsec ) ) {
+			siRetCode = VERIFY_FAILURE;
+		}
+		else if ( ( iEndState != -1 ) && jtag_pipe_state( STATE, iEndState ) ) {
+			siRetCode = VERIFY_FAILURE;
+		}
+	}
+
 	return siRetCode;
 }  
  
@@ -1659,11 +1759,33 @@ short int FREQUENCYCom()
 	
 	write( FREQUENCY );
 	ConvNumber( g_iFrequency );
+
+	if ( g_direct_prog && ( iRetCode == 0 ) ) {
+		iRetCode = DirectFrequency( false );
+	}
 	
 	return iRetCode;
 }
 
  
+/*********************************************************************
+*
+* MaxScanChunk
+*
+* Returns the largest number of bits written as one SIR/SDR stream.
+* The VME player cascades longer scans, direct programming shifts the
+* whole scan at once from a buffer that grows on demand.
+*
+*********************************************************************/
+
+static long int MaxScanChunk( long int a_iNumBits )
+{
+	if ( g_direct_prog ) {
+		return a_iNumBits;
+	}
+	return g_iMaxBufferSize;
+}
+
 /******************************************************************************************
 *															*
 * Execute the Shift Data Register										*
@@ -1700,7 +1822,7 @@ short int ScanCom( char scan_type, bool compress )
 		return FILE_NOT_VALID;
 	}
 	
-	if ( DR_Length > ( long int ) g_iMaxBufferSize) {
+	if ( DR_Length > MaxScanChunk( DR_Length ) ) {
 		/* Put the device into DRPAUSE before processing cascading frames */
 		if ( scan_type ) {
 			write( STATE );
@@ -1712,7 +1834,7 @@ short int ScanCom( char scan_type, bool compress )
 	rcode = TDIToken( DR_Length, scan_type, compress );
 
 	/* TDO may exist and compression turns on */
-	if ( ( scan_type ) && ( DR_Length > ( long int ) g_iMaxBufferSize ) ) {
+	if ( ( scan_type ) && ( DR_Length > MaxScanChunk( DR_Length ) ) ) {
 		/* Put the device into ENDDR after processing cascading frames */
 		write( STATE );
 		write( ( char ) CurEndDR );
@@ -1722,34 +1844,207 @@ short int ScanCom( char scan_type, bool compress )
 }
  
 
-/***********************************************************************
-*                                                                      *
-* Generic routine to read data from the SVF file.                      *
-*                                                                      *
-* Parses the SVF command token "TDI(11223344)"                         *
-*                                                                      *
-* SDR 128 TDI(00302043003010430030304300308043);  Program             *
-*                                                                      *
-* SDR 128 TDI(ffffffffffffffffffffffffffffffff)                       *
-*         TDO(00302043003010430030304300308043);  Verify              *
-*                                                                      *
-* Var                                                                  *
-* numbits       The number of bits of data to be processed.            *
-* g_pszSVFString    The string contains the whole or part of the data read *
-*               from SVF                                               *
-* sdr           0 is sir. 1,2 is sdr 3 is hir,hdr,tir,tdr              *
-* compress      0 = no compress by default. e.g. SIR data                *
-*               1 = compress                                             *
-************************************************************************/
-
-short int TDIToken(long int  numbits, char sdr, bool compress )
+/*********************************************************************
+*
+* Direct programming shifts SIR/SDR straight out of the TDI buffer of
+* scanNodes, which then holds the captured TDO. Where the last TDI of
+* each was read is kept, so that a scan reusing it can decode it again.
+*
+*********************************************************************/
+
+static unsigned long g_ulTDIOffset[ 2 ];
+static unsigned int g_uiTDILine[ 2 ];
+static bool g_bTDIShifted[ 2 ];
+
+/*********************************************************************
+*
+* ReloadTDI
+*
+* Decodes the last TDI of SIR (sdr 0) or SDR (sdr 1) again from the
+* mapped SVF file and returns to the current token.
+*
+*********************************************************************/
+
+static short int ReloadTDI( int sdr, long int numbits )
+{
+	unsigned long ulPos = g_pSVFLexer->pos;
+	unsigned int uiLine = g_pSVFLexer->line;
+	svf_token_t token = g_SVFToken;
+	int iLineIndex = g_iSVFLineIndex;
+	short int rcode;
+
+	g_pSVFLexer->pos = g_ulTDIOffset[ sdr ];
+	g_pSVFLexer->line = g_uiTDILine[ sdr ];
+	rcode = ConvertFromHexString( numbits, scanNodes[ sdr ].tdi );
+
+	g_pSVFLexer->pos = ulPos;
+	g_pSVFLexer->line = uiLine;
+	g_SVFToken = token;
+	g_iSVFLineIndex = iLineIndex;
+	return rcode;
+}
+
+/*********************************************************************
+*
+* Scans too long to be converted as a whole are streamed from the SVF
+* file. Only where their TDI and MASK are is kept, for as long as the
+* scan length does not change, since a scan may reuse them.
+*
+*********************************************************************/
+
+static svf_hex_span_t g_TDISpan[ 2 ];
+static svf_hex_span_t g_MaskSpan[ 2 ];
+static long int g_iTDISpanBits[ 2 ];
+static long int g_iMaskSpanBits[ 2 ];
+
+/*********************************************************************
+*
+* SkipHexString
+*
+* Reads past the hex data of a streamed scan up to the closing ')'
+* and returns where in the mapped SVF file it is.
+*
+*********************************************************************/
+
+static short int SkipHexString( svf_hex_span_t * a_pSpan )
+{
+	const char * pcClose = NULL;
+	short int rcode = 0;
+
+	a_pSpan->begin = NULL;
+	while ( ( pcClose == NULL ) && ( ( rcode = TokenSpan( " (" ) ) == 0 ) ) {
+		if ( a_pSpan->begin == NULL ) {
+			a_pSpan->begin = g_SVFToken.ptr;
+		}
+		pcClose = memchr( g_SVFToken.ptr, ')', g_SVFToken.len );
+	}
+	a_pSpan->end = pcClose ? pcClose : a_pSpan->begin;
+
+	return rcode;
+}
+
+/*********************************************************************
+*
+* DirectStream
+*
+* Shifts a streamed SIR (sdr 0) or SDR (sdr 1) chunk by chunk. The
+* TDI and MASK are those last given for the same length, if any.
+*
+*********************************************************************/
+
+static short int DirectStream( int sdr, long int numbits, const svf_hex_span_t * a_pTDO )
+{
+	static const svf_hex_span_t zeros = { NULL, NULL };
+	const svf_hex_span_t * pTDI = &zeros;
+	const svf_hex_span_t * pMask = NULL;
+
+	if ( g_iTDISpanBits[ sdr ] == numbits ) {
+		pTDI = &g_TDISpan[ sdr ];
+	}
+	if ( g_iMaskSpanBits[ sdr ] == numbits ) {
+		pMask = &g_MaskSpan[ sdr ];
+	}
+
+	/* The chunks go to the player from here, after the queued commands */
+	if ( jtag_pipe_drain() != 0 ) {
+		return VERIFY_FAILURE;
+	}
+	jtag_vqueue_set_line( g_iSVFLineIndex );
+
+	switch ( jtag_stream_scan( sdr ? SDR : SIR, numbits, pTDI, a_pTDO, pMask ) ) {
+	case OK:
+		return 0;
+	case OUT_OF_MEMORY:
+		return OUT_OF_MEMORY;
+	default:
+		return VERIFY_FAILURE;
+	}
+}
+
+/*********************************************************************
+*
+* DirectScan
+*
+* Shifts the decoded SIR (sdr 0) or SDR (sdr 1) of scanNodes through
+* the JTAG player. TDO is only captured when the scan has a TDO, the
+* MASK applies to it. a_bNewTDI tells whether the scan had its own TDI.
+* The queued TDO checks must pass before an SIR that finishes
+* programming, see jtag_poll_checkpoint(). Inside a loop the scan is
+* recorded for DirectLoop().
+*
+*********************************************************************/
+
+static short int DirectScan( int sdr, long int numbits, bool a_bNewTDI )
+{
+	char * tdi = ( char * ) scanNodes[ sdr ].tdi;
+	const char * tdo = ( const char * ) scanNodes[ sdr ].tdo;
+	const char * mask = tdo ? ( const char * ) scanNodes[ sdr ].mask : NULL;
+	short int rcode;
+
+	if ( a_bNewTDI ) {
+		g_bTDIShifted[ sdr ] = false;
+	}
+	else if ( tdi && g_bTDIShifted[ sdr ] ) {
+		if ( ( rcode = ReloadTDI( sdr, numbits ) ) != 0 ) {
+			return rcode;
+		}
+	}
+
+	if ( g_usFlowControlRegister & INTEL_PRGM ) {
+		return jtag_poll_loop_scan( sdr ? SDR : SIR, numbits, tdi, tdo, mask, g_iSVFLineIndex ) ? OUT_OF_MEMORY : 0;
+	}
+
+	if ( ( sdr == 0 ) && jtag_poll_checkpoint( numbits, tdi ) &&
+		( ( rcode = DirectCheckpoint() ) != 0 ) ) {
+		return rcode;
+	}
+	rcode = jtag_pipe_scan( sdr ? SDR : SIR, numbits, tdi, tdo, mask, g_iSVFLineIndex );
+
+	/* The pipeline shifts a copy of TDI */
+	if ( !jtag_pipe_active() ) {
+		g_bTDIShifted[ sdr ] = true;
+	}
+
+	return rcode ? VERIFY_FAILURE : 0;
+}
+
+/***********************************************************************
+*                                                                      *
+* Generic routine to read data from the SVF file.                      *
+*                                                                      *
+* Parses the SVF command token "TDI(11223344)"                         *
+*                                                                      *
+* SDR 128 TDI(00302043003010430030304300308043);  Program             *
+*                                                                      *
+* SDR 128 TDI(ffffffffffffffffffffffffffffffff)                       *
+*         TDO(00302043003010430030304300308043);  Verify              *
+*                                                                      *
+* Var                                                                  *
+* numbits       The number of bits of data to be processed.            *
+* g_pszSVFString    The string contains the whole or part of the data read *
+*               from SVF                                               *
+* sdr           0 is sir. 1,2 is sdr 3 is hir,hdr,tir,tdr              *
+* compress      0 = no compress by default. e.g. SIR data                *
+*               1 = compress                                             *
+************************************************************************/
+
+short int TDIToken(long int  numbits, char sdr, bool compress )
 {
 	int            i;
 	int            rcode = 0;
 	int            bits, bit;
+	long int       chunk;               /*bits written per SIR/SDR stream*/
 	char           Nodes[4]= {SIR, SDR, XSDR, HIR};
 	char           option = 0, Done = 0;
 	char           ioshift = 0;         /*simutaneously shift in and out*/
+	bool           bNewTDI = false;     /*the scan has its own TDI*/
+	bool           bStream;             /*the scan is streamed from the file*/
+	bool           bTDO = false;
+	svf_hex_span_t TDOSpan;
+	int            iNode = sdr;         /*sdr as an index of the direct programming tables*/
+
+	bStream = g_direct_prog && ( sdr <= 1 ) && ( numbits > JTAG_STREAM_CHUNK_BITS ) &&
+		!( g_usFlowControlRegister & INTEL_PRGM );
 
 	if ( sdr == 0 ) {
 
@@ -1760,6 +2055,8 @@ short int TDIToken(long int  numbits, char sdr, bool compress )
 		*
 		*****************************************************************************/
 
+		g_iTDISpanBits[ 1 ] = 0;
+
 		if ( scanNodes[ 1 ].tdi ) {
 			free( scanNodes[ 1 ].tdi );
 			scanNodes[ 1 ].tdi = NULL;
@@ -1798,11 +2095,12 @@ short int TDIToken(long int  numbits, char sdr, bool compress )
 		}
 	}
 	
-	if ( ( sdr == 1 ) && ( scanNodes[ sdr ].tdi != NULL ) && ( scanNodes[ sdr ].numbits == numbits ) ) {
+	if ( !g_direct_prog && ( sdr == 1 ) && ( scanNodes[ sdr ].tdi != NULL ) && ( scanNodes[ sdr ].numbits == numbits ) ) {
 		
 		/****************************************************************************
 		*
-		* Copy over previous SDR-TDI to check for possible XTDO later.
+		* Copy over previous SDR-TDI to check for possible XTDO later. Direct
+		* programming does not use XTDO.
 		*
 		*****************************************************************************/
 
@@ -1831,20 +2129,14 @@ short int TDIToken(long int  numbits, char sdr, bool compress )
      
 	while ( ( !Done ) && ( rcode == 0 ) ) {
 		rcode = Token( " " );
-		
-		for ( i = 0; i < ScanTokenMax; i++ ) {
 
-			/****************************************************************************
-			*
-			* Check if g_pszSVFString is a valid token.
-			*
-			*****************************************************************************/
+		/****************************************************************************
+		*
+		* Check if g_pszSVFString is a valid token.
+		*
+		*****************************************************************************/
 
-			if ( stricmp( scanTokens[ i ].text, g_pszSVFString ) == 0 ) {
-				break;
-			}
-		}
-		switch ( scanTokens[i].token ) {
+		switch ( svf_keyword_lookup( g_SVFToken.ptr, g_SVFToken.len ) ) {
 		case TDI:
 
 			/****************************************************************************
@@ -1853,6 +2145,12 @@ short int TDIToken(long int  numbits, char sdr, bool compress )
 			*
 			*****************************************************************************/
 
+			if ( bStream ) {
+				rcode = SkipHexString( &g_TDISpan[ iNode ] );
+				g_iTDISpanBits[ iNode ] = numbits;
+				break;
+			}
+
 			if ( scanNodes[ sdr ].tdi != NULL ) {
 				free( scanNodes[ sdr ].tdi );
 			}
@@ -1860,6 +2158,12 @@ short int TDIToken(long int  numbits, char sdr, bool compress )
 			if ( ( scanNodes[ sdr ].tdi = ( unsigned char * ) malloc( numbits / 8 + 2 ) ) == NULL ) {
 				return OUT_OF_MEMORY;
 			}
+
+			if ( sdr <= 1 ) {
+				g_ulTDIOffset[ iNode ] = g_pSVFLexer->pos;
+				g_uiTDILine[ iNode ] = g_pSVFLexer->line;
+				bNewTDI = true;
+			}
 			
 			rcode = ConvertFromHexString( numbits, scanNodes[ sdr ].tdi );
 			break;
@@ -1881,6 +2185,12 @@ short int TDIToken(long int  numbits, char sdr, bool compress )
 			*
 			*****************************************************************************/
 
+			if ( bStream ) {
+				rcode = SkipHexString( &TDOSpan );
+				bTDO = true;
+				break;
+			}
+
 			if ( ( scanNodes[ sdr ].tdo = ( unsigned char * ) malloc( numbits / 8 + 2 ) ) == NULL ) {
 				return OUT_OF_MEMORY;
 			}
@@ -1897,13 +2207,14 @@ short int TDIToken(long int  numbits, char sdr, bool compress )
 				*
 				*****************************************************************************/
 
-				for ( i = 0; i < numbits / 8 + 1; i++ ) {
+				/* Only the bytes holding scan bits are converted, skip the spare one. */
+				for ( i = 0; i < ( numbits + 7 ) / 8; i++ ) {
 					if ( scanNodes[ 2 ].tdi[ i ] != scanNodes[ sdr ].tdo[ i ] ) {
 						break;
 					}
 				}
 				
-				if ( i == numbits / 8 + 1 ) {
+				if ( i == ( numbits + 7 ) / 8 ) {
 
 					/****************************************************************************
 					*
@@ -1924,6 +2235,12 @@ short int TDIToken(long int  numbits, char sdr, bool compress )
 			*
 			*****************************************************************************/
 
+			if ( bStream ) {
+				rcode = SkipHexString( &g_MaskSpan[ iNode ] );
+				g_iMaskSpanBits[ iNode ] = numbits;
+				break;
+			}
+
 			if ( scanNodes[ sdr ].mask == NULL ) {
 				if ( ( scanNodes[ sdr ].mask = ( unsigned char * ) malloc( numbits / 8 + 2 ) ) == NULL ) {
 					return OUT_OF_MEMORY;
@@ -2033,171 +2350,192 @@ short int TDIToken(long int  numbits, char sdr, bool compress )
 	*
 	*****************************************************************************/
 
-	/*TODO Put JTAG ioctl here */
-	bit = 0;
-	option = compress + 1; 
-	do {
-		if ( numbits > ( long int ) g_iMaxBufferSize ) {
-			
-			/****************************************************************************
-			*
-			* Enable cascading since data size exceeded allowable limit.
-			*
-			*****************************************************************************/
-
-			write( SETFLOW );
-			ConvNumber( CASCADE );
-			bits = ( int ) g_iMaxBufferSize; 
-		}
-		else {
-			bits = ( int ) numbits;
-		}
-		
-		if ( ioshift ) {
-
-			/****************************************************************************
-			*
-			* Write XSDR to indicate that TDO data is the same as previous TDI.
-			*
-			*****************************************************************************/
-
-			write( Nodes[ 2 ] );
-		}
-		else if ( sdr < 3 ) {
+	if ( g_direct_prog ) {
 
-			/****************************************************************************
-			*
-			* Write regular SIR/SDR.
-			*
-			*****************************************************************************/
-
-			write( Nodes[ sdr ] );
-		}
-		
 		/****************************************************************************
 		*
-		* Write data size.
+		* Direct programming shifts the decoded streams in place. Headers and
+		* trailers are handed over by the caller, scans inside intelligent
+		* programming loops are recorded and run when the loop is closed.
 		*
 		*****************************************************************************/
 
-		ConvNumber( bits );
+		if ( ( rcode == 0 ) && ( sdr <= 1 ) ) {
+			if ( bStream ) {
+				rcode = DirectStream( sdr, numbits, bTDO ? &TDOSpan : NULL );
+			}
+			else {
+				rcode = DirectScan( sdr, numbits, bNewTDI );
+			}
+		}
+	}
+	else {
+		bit = 0;
+		option = compress + 1; 
+		chunk = MaxScanChunk( numbits );
+		do {
+			if ( numbits > chunk ) {
+			
+				/****************************************************************************
+				*
+				* Enable cascading since data size exceeded allowable limit.
+				*
+				*****************************************************************************/
+
+				write( SETFLOW );
+				ConvNumber( CASCADE );
+				bits = ( int ) chunk;
+			}
+			else {
+				bits = ( int ) numbits;
+			}
 		
-		if ( scanNodes[ sdr ].tdi != NULL ) {
+			if ( ioshift ) {
+
+				/****************************************************************************
+				*
+				* Write XSDR to indicate that TDO data is the same as previous TDI.
+				*
+				*****************************************************************************/
+
+				write( Nodes[ 2 ] );
+			}
+			else if ( sdr < 3 ) {
+
+				/****************************************************************************
+				*
+				* Write regular SIR/SDR.
+				*
+				*****************************************************************************/
 
+				write( Nodes[ sdr ] );
+			}
+		
 			/****************************************************************************
 			*
-			* Write TDI.
+			* Write data size.
 			*
 			*****************************************************************************/
 
-			write( TDI );
-			rcode = convertToispSTREAM( bits, &scanNodes[ sdr ].tdi[ bit / 8 ], option );
-		}
+			ConvNumber( bits );
 		
-		if ( scanNodes[ sdr ].tdo != NULL ) {
+			if ( scanNodes[ sdr ].tdi != NULL ) {
 
-			/****************************************************************************
-			*
-			* Write TDO/XTDO.
-			*
-			*****************************************************************************/
+				/****************************************************************************
+				*
+				* Write TDI.
+				*
+				*****************************************************************************/
 
-			if ( ioshift ) {
-				write( XTDO );
+				write( TDI );
+				rcode = convertToispSTREAM( bits, &scanNodes[ sdr ].tdi[ bit / 8 ], option );
 			}
-			else {
-				write( TDO );
-				rcode =  convertToispSTREAM( bits, &scanNodes[ sdr ].tdo[ bit / 8 ], option );
+		
+			if ( scanNodes[ sdr ].tdo != NULL ) {
+
+				/****************************************************************************
+				*
+				* Write TDO/XTDO.
+				*
+				*****************************************************************************/
+
+				if ( ioshift ) {
+					write( XTDO );
+				}
+				else {
+					write( TDO );
+					rcode =  convertToispSTREAM( bits, &scanNodes[ sdr ].tdo[ bit / 8 ], option );
+				}
 			}
-		}
 		
-		if ( ( scanNodes[ sdr ].tdo != NULL ) && ( scanNodes[ sdr ].mask != NULL ) ) {
+			if ( ( scanNodes[ sdr ].tdo != NULL ) && ( scanNodes[ sdr ].mask != NULL ) ) {
 
-			/****************************************************************************
-			*
-			* Write MASK.
-			*
-			*****************************************************************************/
+				/****************************************************************************
+				*
+				* Write MASK.
+				*
+				*****************************************************************************/
 			
-			write( MASK );
-			rcode = convertToispSTREAM( bits, &scanNodes[ sdr ].mask[ bit / 8 ], option );
-		}
+				write( MASK );
+				rcode = convertToispSTREAM( bits, &scanNodes[ sdr ].mask[ bit / 8 ], option );
+			}
 		
-		if ( scanNodes[ sdr ].crc != NULL ) {
+			if ( scanNodes[ sdr ].crc != NULL ) {
 
-			/****************************************************************************
-			*
-			* Write CRC.
-			*
-			*****************************************************************************/
+				/****************************************************************************
+				*
+				* Write CRC.
+				*
+				*****************************************************************************/
 
-			write( CRC );
-			rcode = convertToispSTREAM( bits, &scanNodes[ sdr ].crc[ bit / 8 ], option );
-		}
+				write( CRC );
+				rcode = convertToispSTREAM( bits, &scanNodes[ sdr ].crc[ bit / 8 ], option );
+			}
 		
-		if ( scanNodes[ sdr ].cmask != NULL ) {
+			if ( scanNodes[ sdr ].cmask != NULL ) {
 
-			/****************************************************************************
-			*
-			* Write CMASK.
-			*
-			*****************************************************************************/
+				/****************************************************************************
+				*
+				* Write CMASK.
+				*
+				*****************************************************************************/
 
-			write( CMASK );
-			rcode = convertToispSTREAM( bits, &scanNodes[ sdr ].cmask[ bit / 8 ], option );
-		}
+				write( CMASK );
+				rcode = convertToispSTREAM( bits, &scanNodes[ sdr ].cmask[ bit / 8 ], option );
+			}
 		
-		if ( scanNodes[ sdr ].read != NULL ) {
+			if ( scanNodes[ sdr ].read != NULL ) {
 
-			/****************************************************************************
-			*
-			* Write READ.
-			*
-			*****************************************************************************/
+				/****************************************************************************
+				*
+				* Write READ.
+				*
+				*****************************************************************************/
 
-			write( READ );
-			rcode = convertToispSTREAM( bits, &scanNodes[ sdr ].read[ bit / 8], option );
-		}
+				write( READ );
+				rcode = convertToispSTREAM( bits, &scanNodes[ sdr ].read[ bit / 8], option );
+			}
 		
-		if ( scanNodes[ sdr ].rmask != NULL ) {
+			if ( scanNodes[ sdr ].rmask != NULL ) {
 
-			/****************************************************************************
-			*
-			* Write RMASK.
-			*
-			*****************************************************************************/
+				/****************************************************************************
+				*
+				* Write RMASK.
+				*
+				*****************************************************************************/
 
-			write( RMASK );
-			rcode = convertToispSTREAM( bits, &scanNodes[ sdr ].rmask[ bit / 8 ], option );
-		}
+				write( RMASK );
+				rcode = convertToispSTREAM( bits, &scanNodes[ sdr ].rmask[ bit / 8 ], option );
+			}
 		
-		if ( scanNodes[ sdr ].dmask != NULL ) {
+			if ( scanNodes[ sdr ].dmask != NULL ) {
 
-			/****************************************************************************
-			*
-			* Write DMASK.
-			*
-			*****************************************************************************/
+				/****************************************************************************
+				*
+				* Write DMASK.
+				*
+				*****************************************************************************/
 
-			write( DMASK );
-			rcode = convertToispSTREAM( bits, &scanNodes[ sdr ].dmask[ bit / 8 ], option );
-		}
+				write( DMASK );
+				rcode = convertToispSTREAM( bits, &scanNodes[ sdr ].dmask[ bit / 8 ], option );
+			}
 
-        write( CONTINUE );
-        bit += ( long int ) g_iMaxBufferSize;
+	        write( CONTINUE );
+	        bit += chunk;
 		
-		if ( numbits > (long int) g_iMaxBufferSize ) {
+			if ( numbits > chunk ) {
 			
-			/****************************************************************************
-			*
-			* Disable cascading.
-			*
-			*****************************************************************************/
+				/****************************************************************************
+				*
+				* Disable cascading.
+				*
+				*****************************************************************************/
 
-			write( RESETFLOW );
-			ConvNumber( CASCADE );
-		}
-	} while ( ( rcode == 0 ) && ( ( numbits -= ( long int ) g_iMaxBufferSize ) > 0 ) );
+				write( RESETFLOW );
+				ConvNumber( CASCADE );
+			}
+		} while ( ( rcode == 0 ) && ( ( numbits -= chunk ) > 0 ) );
+	}
 	
 	/****************************************************************************
 	*
@@ -2296,7 +2634,7 @@ short int  ConvertFromHexString(long int numbits, unsigned char *data_buf)
 	int          charcount;           /* counts during pass over the string */
 	int          dataIdx;             /* cursor into dataarray[]        */
 	int          i, j;                   /* hex value extract from the char         */
-	char           cur_char;
+	char           cur_char = 0;
 	unsigned char  char_val;
 	short int             rcode = 0;
 	char                  *work_buf = NULL;          /*working memory*/
@@ -2311,12 +2649,12 @@ short int  ConvertFromHexString(long int numbits, unsigned char *data_buf)
   
 	/*search for the open bracket then close bracket*/
 	while ( rcode == 0 ) {
-		/*read next string if necessary*/
-        rcode = Token( " (" );
+		/*read next string if necessary, the hex data is not copied*/
+		rcode = TokenSpan( " (" );
 
-		for ( i = 0; i < (int) strlen( g_pszSVFString ); i++ )
+		for ( i = 0; i < (int) g_SVFToken.len; i++ )
 		{
-            if ( ( cur_char = g_pszSVFString[ i ] ) == ')' ) {
+            if ( ( cur_char = g_SVFToken.ptr[ i ] ) == ')' ) {
 				break;  /*end of current stream*/
 			}
 
@@ -2349,7 +2687,18 @@ short int  ConvertFromHexString(long int numbits, unsigned char *data_buf)
 		
 		for ( i = charcount - 1; i >= 0; i-- ) {
 			char_val = ( unsigned char ) CharToHex( work_buf[ i ] );
-			if ( j % 2 == 0 ) {
+			if ( g_direct_prog ) {
+
+				/* The JTAG player takes the data LSB first, as it is shifted out */
+				if ( j % 2 == 0 ) {
+					data_buf[ dataIdx ] = char_val;
+				}
+				else {
+					data_buf[ dataIdx ] |= ( unsigned char ) ( char_val << 4 );
+					dataIdx++;
+				}
+			}
+			else if ( j % 2 == 0 ) {
 				data_buf[ dataIdx ] = 0x00;
 				data_buf[ dataIdx ] |= ( unsigned char )( reverse( char_val ) << 4 );
 			}
@@ -2360,6 +2709,12 @@ short int  ConvertFromHexString(long int numbits, unsigned char *data_buf)
 			}
 			j++;
 		}
+
+		if ( g_direct_prog && ( numbits % 8 ) ) {
+
+			/* Bits of the last hex digit beyond numbits are not shifted */
+			data_buf[ numbits / 8 ] &= ( unsigned char ) ( ( 1 << ( numbits % 8 ) ) - 1 );
+		}
 	}
 	
 	if (work_buf != NULL) {
@@ -2740,8 +3095,9 @@ short int CharToHex( char hexNibbleChar )
 ************************************************************************/
 int write(unsigned char data)
 {
-	if ((g_direct_prog) && (write_handler != NULL))
-		return write_handler(WRITE_HANDLER_BYTE_CMD, data);
+	/* Direct programming hands decoded data to the JTAG player, no VME is produced */
+	if ( g_direct_prog )
+		return 0;
 
 
 	if ( g_usFlowControlRegister & INTEL_PRGM ) {
@@ -2813,6 +3169,7 @@ int AllocateCFGMemory( int struct_size )
 		printf( "\nOut of Memory!\n" );
 		return false;               
 	}
+	g_iCFGCount = struct_size;
 	return true;
 }
 
@@ -2828,8 +3185,14 @@ int AllocateCFGMemory( int struct_size )
 
 void DeAllocateCFGMemory()
 {
+	int iIndex;
+
 	if ( cfgChain != NULL ) {
+		for ( iIndex = 0; iIndex < g_iCFGCount; iIndex++ ) {
+			svf_index_free( cfgChain[ iIndex ].index );
+		}
 		free( cfgChain );
+		cfgChain = NULL;
 	}
 }
 
@@ -2844,16 +3207,21 @@ void PrintHelp(void)
 {
 	printf( "Usage: svf2vme [ -help |\n" );
 	printf( "               [ -full ]\n" );
-	printf( "                 -infile  < input file path >  [ -clock < frequency > ]\n" );
+	printf( "                 -infile  < input file path >  [ -clock < frequency | auto > ]\n" );
 	printf( "                                               [ -vendor < altera | xilinx > ]\n" );
 	printf( "                                               [ -max_tck < max_tck > ]\n" );
-	printf( "               [ -infile  < input file path >  [ -clock < frequency > ]\n" );
+	printf( "               [ -infile  < input file path >  [ -clock < frequency | auto > ]\n" );
 	printf( "                                               [ -vendor < altera | xilinx > ]\n" );
 	printf( "                                               [ -max_tck < max_tck > ]\n" );
 	printf( "                                               [ -max_size < max_buffer_size > ]\n" );
 	printf( "               [ -bypass < instruction register length > ]\n" );
 	printf( "               [ -outfile < output file path > ]\n" );
 	printf( "               [ -prog  < jtag program interface path > ]\n" );
+	printf( "               [ -plan  < execution plan output path > ]\n" );
+	printf( "               [ -play  < execution plan path > ]\n" );
+	printf( "               [ -pipeline < depth > ]\n" );
+	printf( "               [ -batch < ops > ]\n" );
+	printf( "               [ -poll ]\n" );
 	printf( "               [ -comment ]\n" );
 	printf( "               [ -header < header string > ]\n" );
 	printf( "               ]\n" );
@@ -2864,6 +3232,7 @@ void PrintHelp(void)
 	printf( "    -infile:  Specifies the input SVF file.\n" );
 	printf( "    -clock:   Overwrite the frequency of the SVF file.\n" );
 	printf( "              Default: frequency based on SVF file or 1 MHz if not provided.\n" );
+	printf( "              auto: with -prog, the fastest TCK the chain reads back reliably at.\n" );
 	printf( "    -vendor:  Specifies the vendor of the SVF file.\n" );
 	printf( "              Default: JTAG standard.\n" );
 	printf( "    -max_tck: Specifies the maximum TCK. Any remaining TCK will be converted to delay.\n" );
@@ -2878,12 +3247,26 @@ void PrintHelp(void)
 	printf( "    -header:  Generates VME file with the specified header.\n" );
 	printf( "              Default: header are off.\n" );
 	printf( "    -prog:    Run direct device program instead of generate vme file.\n" );
+	printf( "              sim[:device,...]: a simulated chain, devices from TDI to TDO.\n" );
+	printf( "              Devices: generic, machxo2, machxo3, with /erase=<us>/prog=<us> latencies.\n" );
+	printf( "    -plan:    Compiles the SVF files into a JTAG execution plan instead of a VME file.\n" );
+	printf( "    -play:    Programs the device from a compiled execution plan, requires -prog.\n" );
+	printf( "    -pipeline: Parses the SVF files ahead of the JTAG transfers by up to depth commands.\n" );
+	printf( "              Default: 0, the commands are shifted as they are parsed.\n" );
+	printf( "    -batch:   Submits up to this many JTAG operations that read no TDO together.\n" );
+	printf( "              Default: 0, every operation is submitted on its own.\n" );
+	printf( "              No effect with the Aspeed driver, it takes one operation per call.\n" );
+	printf( "    -poll:    Ends long waits before a status check once the device is no longer busy.\n" );
+	printf( "              Default: off, the waits of the SVF files are kept.\n" );
 
 	printf( "Examples:               \n" );
 	printf( "    svf2vme -infile c:\\file.svf -clock 10K -max_tck 1000 -max_size 64\n" );
 	printf( "    svf2vme -infile c:\\file1.svf -clock 25M -infile c:\\file2.svf -vendor altera\n" );
 	printf( "    svf2vme -bypass 8 -infile c:\\file.svf -clock 10K -outfile c:\\file.vme \n" );
 	printf( "    svf2vme -infile c:\\file.svf -header \"CREATED BY:ispVM System Version 17.3\"\n" );
+	printf( "    svf2vme -infile file.svf -plan file.jplan\n" );
+	printf( "    svf2vme -play file.jplan -prog /dev/jtag0\n" );
+	printf( "    svf2vme -infile file.svf -prog sim:machxo2/erase=500000 -d\n" );
 	printf( "\n" );
 	printf( "See the readme.txt for more information.               \n\n" );
 	
@@ -2913,6 +3296,9 @@ int main( int argc, char *argv[] )
 	int iFullVMEOption = 0;
 	int iSVFCount = 0;
 	int iBypassCount = 0;
+	int iPipelineDepth = 0;
+	int iBatchOps = 0;
+	bool bPoll = false;
 	int iCurrentSVFCount = 0;
 	int iTemp = 0;
 	char * szTmp = NULL;
@@ -2920,9 +3306,9 @@ int main( int argc, char *argv[] )
 	char szCommandLineArg[1024] = { 0 };
 	char szErrorMessage[ 1024 ] = { 0 };
 	char JTAGpath[ 1024 ] = { 0 };
+	char szPlanFilename[ 1024 ] = { 0 };
+	char szPlayFilename[ 1024 ] = { 0 };
 	FILE * fptrVMEFile = NULL;
-	int JTAGfrq;
-	struct jtag_run_test_idle runtest;
 
 	printf( "              Mellanox Technologies Ltd.\n" );
 	printf( "     JTAG svf player Version %s Copyright 2017\n\n", VME_VERSION_NUMBER );
@@ -2933,8 +3319,6 @@ int main( int argc, char *argv[] )
 		exit( ERR_COMMAND_LINE_SYNTAX );
 	}
 
-	write_handler = null_handler;
-
 	/* Pre-process the command line arguments to count the number of SVF files and bypasses given */
 	for ( iCommandLineIndex = 1; iCommandLineIndex < argc; iCommandLineIndex++ ) {
 		strcpy( szCommandLineArg, argv[ iCommandLineIndex ] );
@@ -2944,9 +3328,21 @@ int main( int argc, char *argv[] )
 		else if ( !strcmp( szCommandLineArg, "-bypass" ) || !strcmp( szCommandLineArg, "-by" ) ) {
 			iBypassCount++;
 		}
+		else if ( !strcmp( szCommandLineArg, "-play" ) && ( iCommandLineIndex + 1 < argc ) ) {
+			strcpy( szPlayFilename, argv[ iCommandLineIndex + 1 ] );
+		}
 	}
 
-	if ( iSVFCount <= 0 ) {
+	if ( szPlayFilename[ 0 ] != '\0' ) {
+
+		/* A compiled plan replaces the SVF files */
+		if ( iSVFCount > 0 || iBypassCount > 0 ) {
+			sprintf( szErrorMessage, "Error: -play cannot be combined with -infile or -bypass.\n\n" );
+			printf( "%s", szErrorMessage );
+			exit( ERR_COMMAND_LINE_SYNTAX );
+		}
+	}
+	else if ( iSVFCount <= 0 ) {
 		sprintf( szErrorMessage, "Error: missing required argument -infile < input file >.\n\n" );
 		printf( "%s", szErrorMessage );
 		PrintHelp();
@@ -3040,8 +3436,7 @@ int main( int argc, char *argv[] )
 				exit( ERR_COMMAND_LINE_SYNTAX );
 			}
 			strcpy(JTAGpath, argv[ iCommandLineIndex ]);
-			g_JTAGFile = open(JTAGpath, O_RDWR);
-			if(g_JTAGFile == -1){
+			if ( jtag_backend_open( JTAGpath ) != 0 ) {
 				sprintf( szErrorMessage, "Error: can't open JTAG interface file.\n\n" );
 				printf( "%s", szErrorMessage );
 				exit( ERR_COMMAND_LINE_SYNTAX );
@@ -3049,6 +3444,59 @@ int main( int argc, char *argv[] )
 				g_direct_prog = 1;
 				iFullVMEOption = 1;
 			}
+		} else if(!strcmp( szCommandLineArg, "-plan" )){
+			if ( ++iCommandLineIndex >= argc ) {
+				sprintf( szErrorMessage, "Error: missing execution plan file name.\n\n" );
+				printf( "%s", szErrorMessage );
+				exit( ERR_COMMAND_LINE_SYNTAX );
+			}
+			strcpy( szPlanFilename, argv[ iCommandLineIndex ] );
+		} else if(!strcmp( szCommandLineArg, "-play" )){
+			if ( ++iCommandLineIndex >= argc ) {
+				sprintf( szErrorMessage, "Error: missing execution plan file name.\n\n" );
+				printf( "%s", szErrorMessage );
+				exit( ERR_COMMAND_LINE_SYNTAX );
+			}
+		} else if(!strcmp( szCommandLineArg, "-pipeline" )){
+			if ( ++iCommandLineIndex >= argc ) {
+				sprintf( szErrorMessage, "Error: missing pipeline depth.\n\n" );
+				printf( "%s", szErrorMessage );
+				exit( ERR_COMMAND_LINE_SYNTAX );
+			}
+
+			strcpy( szCommandLineArg, argv[ iCommandLineIndex ] );
+			for ( iTemp = 0; iTemp < ( signed int ) strlen( szCommandLineArg ); iTemp++ ) {
+				if ( !isdigit( szCommandLineArg[ iTemp ] ) ) {
+					break;
+				}
+			}
+			iPipelineDepth = atoi( szCommandLineArg );
+			if ( ( iTemp == 0 ) || szCommandLineArg[ iTemp ] || ( iPipelineDepth > JTAG_PIPE_MAX_DEPTH ) ) {
+				sprintf( szErrorMessage, "Error: pipeline depth %s is not a number up to %d.\n\n", szCommandLineArg, JTAG_PIPE_MAX_DEPTH );
+				printf( "%s", szErrorMessage );
+				exit( ERR_COMMAND_LINE_SYNTAX );
+			}
+		} else if(!strcmp( szCommandLineArg, "-batch" )){
+			if ( ++iCommandLineIndex >= argc ) {
+				sprintf( szErrorMessage, "Error: missing batch size.\n\n" );
+				printf( "%s", szErrorMessage );
+				exit( ERR_COMMAND_LINE_SYNTAX );
+			}
+
+			strcpy( szCommandLineArg, argv[ iCommandLineIndex ] );
+			for ( iTemp = 0; iTemp < ( signed int ) strlen( szCommandLineArg ); iTemp++ ) {
+				if ( !isdigit( szCommandLineArg[ iTemp ] ) ) {
+					break;
+				}
+			}
+			iBatchOps = atoi( szCommandLineArg );
+			if ( ( iTemp == 0 ) || szCommandLineArg[ iTemp ] || ( iBatchOps > JTAG_BACKEND_BATCH_MAX_OPS ) ) {
+				sprintf( szErrorMessage, "Error: batch size %s is not a number up to %d.\n\n", szCommandLineArg, JTAG_BACKEND_BATCH_MAX_OPS );
+				printf( "%s", szErrorMessage );
+				exit( ERR_COMMAND_LINE_SYNTAX );
+			}
+		} else if(!strcmp( szCommandLineArg, "-poll" )){
+			bPoll = true;
 		} else if(!strcmp( szCommandLineArg, "-d" )){
 			g_debug ++;
 		} else {
@@ -3059,7 +3507,38 @@ int main( int argc, char *argv[] )
 		}
 	}
 
-	if ( szVMEFilename[0] == '\0' ) {
+	if ( szPlanFilename[ 0 ] != '\0' ) {
+		if ( g_direct_prog ) {
+			sprintf( szErrorMessage, "Error: -plan cannot be combined with -prog.\n\n" );
+			printf( "%s", szErrorMessage );
+			exit( ERR_COMMAND_LINE_SYNTAX );
+		}
+
+		/* The plan records the transfers of direct programming, no device is opened */
+		if ( jtag_plan_create( szPlanFilename ) != OK ) {
+			sprintf( szErrorMessage, "Error: unable to write to execution plan file %s\n\n", szPlanFilename );
+			printf( "%s", szErrorMessage );
+			exit( FILE_NOT_VALID );
+		}
+		g_direct_prog = 1;
+		iFullVMEOption = 1;
+	}
+
+	for ( iTemp = 0; iTemp < iSVFCount; iTemp++ ) {
+		if ( ( cfgChain[ iTemp ].Frequency == CLOCK_AUTO ) && !jtag_backend_active() ) {
+			sprintf( szErrorMessage, "Error: -clock auto requires -prog < jtag program interface path >.\n\n" );
+			printf( "%s", szErrorMessage );
+			exit( ERR_COMMAND_LINE_SYNTAX );
+		}
+	}
+
+	if ( szPlayFilename[ 0 ] != '\0' && !jtag_backend_active() ) {
+		sprintf( szErrorMessage, "Error: -play requires -prog < jtag program interface path >.\n\n" );
+		printf( "%s", szErrorMessage );
+		exit( ERR_COMMAND_LINE_SYNTAX );
+	}
+
+	if ( szVMEFilename[0] == '\0' && iCurrentSVFCount > 0 ) {
 		/* If no output file then use the name of the first SVF file */
         for ( iTemp = 0; iTemp < iCurrentSVFCount; iTemp++ ) {
             if ( !stricmp( cfgChain[ iTemp ].name, "SVF" ) ) {
@@ -3078,66 +3557,91 @@ int main( int argc, char *argv[] )
 	for ( iTemp = 0; iTemp < iCurrentSVFCount; iTemp++ ) {
 		if ( !stricmp( cfgChain[ iTemp ].name, "SVF" ) ) {
 
-			if ( ( g_pSVFFile = fopen( cfgChain[ iTemp ].Svffile, "r" ) ) == NULL )
-			{
-				printf( szErrorMessage, "Error: svf file %s cannot be read.\n\n", cfgChain[ iTemp ].Svffile );
-				exit( FILE_NOT_FOUND );
-			}
-
-			/* Get instruction length */
-			while ( fgets( buffer, strmax, g_pSVFFile ) != NULL ) {
-				g_pszSVFString = strtok( buffer, "\t " );
-				if ( !stricmp( g_pszSVFString, "SIR" ) ) {
-					g_pszSVFString = strtok(NULL, "\t (");
-					cfgChain[ iTemp ].inst = atoi( g_pszSVFString );
-					break;
+			/* One pass collects the IR length and the working memory size */
+			iRetCode = svf_index_open( &cfgChain[ iTemp ].index, cfgChain[ iTemp ].Svffile );
+			if ( iRetCode == OK ) {
+
+				/*
+				 * Direct programming needs no working memory size, its buffers grow
+				 * on demand. The IR length is only needed to pad the other devices
+				 * of a chain, so a single device starts shifting without a pre-scan.
+				 */
+				if ( !g_direct_prog ) {
+					iRetCode = svf_index_scan( cfgChain[ iTemp ].index, 0 );
+				}
+				else if ( iSVFCount > 1 ) {
+					iRetCode = svf_index_scan( cfgChain[ iTemp ].index, SVF_INDEX_IR_ONLY );
 				}
 			}
-
-			/* Pre-process the file to find the working memory size */
-			rewind( g_pSVFFile );
-			while ( fgets( buffer, strmax, g_pSVFFile ) != NULL ) {
-				g_pszSVFString = strtok( buffer, " \t" );
-				if ( !stricmp( g_pszSVFString, "SDR" ) ) {
-					g_pszSVFString = strtok( NULL, "\t (" );
-			
-					if ( atol( g_pszSVFString ) > g_iMaxSize ) {
-						g_iMaxSize = atol(g_pszSVFString); /* Keep the largest */
-					}
+			if ( iRetCode != OK ) {
+				if ( iRetCode == FILE_ERROR ) {
+					printf( "Error: svf file %s cannot be parsed.\n\n", cfgChain[ iTemp ].Svffile );
 				}
-
-				// Rev. 12.2 Chuo add checking memory size for SIR
-				if ( !stricmp( g_pszSVFString, "SIR" ) ) {
-					g_pszSVFString = strtok( NULL, "\t (" );
-			
-					if ( atol( g_pszSVFString ) > g_iMaxSize ) {
-						g_iMaxSize = atol(g_pszSVFString); /* Keep the largest */
-					}
+				else {
+					printf( "Error: svf file %s cannot be read.\n\n", cfgChain[ iTemp ].Svffile );
 				}
+				DeAllocateCFGMemory();
+				exit( iRetCode == FILE_NOT_FOUND ? FILE_NOT_VALID : iRetCode );
+			}
+
+			if ( cfgChain[ iTemp ].index->ir_len >= 0 ) {
+				cfgChain[ iTemp ].inst = cfgChain[ iTemp ].index->ir_len;
 			}
-			if ( g_iMaxSize >( long int ) g_iMaxBufferSize ) {
-				g_iMaxSize =( long int ) g_iMaxBufferSize;   /* Maximum memory needed for a row of data */
+			if ( cfgChain[ iTemp ].index->max_scan > g_iMaxSize ) {
+				g_iMaxSize = cfgChain[ iTemp ].index->max_scan; /* Keep the largest */
+			}
+			if ( g_debug && !g_direct_prog ) {
+				svf_index_print( cfgChain[ iTemp ].index, cfgChain[ iTemp ].Svffile );
 			}
-			fclose( g_pSVFFile );
 		}
 	}
+	if ( g_iMaxSize >( long int ) g_iMaxBufferSize ) {
+		g_iMaxSize =( long int ) g_iMaxBufferSize;   /* Maximum memory needed for a row of data */
+	}
 
 	jtag_handlers_init();
+	jtag_poll_enable( bPoll && g_direct_prog );
 
-	if (g_direct_prog){
-		sleep(1);
+	if ( jtag_backend_active() && ( jtag_backend_set_batch( iBatchOps ) != 0 ) ) {
+		printf( "Error: out of memory for a batch of %d JTAG operations.\n\n", iBatchOps );
+		jtag_backend_close();
+		DeAllocateCFGMemory();
+		exit( OUT_OF_MEMORY );
+	}
 
-		JTAGfrq = 20000;
-		ioctl(g_JTAGFile, JTAG_SIOCFREQ, &JTAGfrq);
+	if ( jtag_backend_active() ) {
+		/* Until a -clock or FREQUENCY of the SVF file sets another one */
+		jtag_player_set_frequency( 20000 );
 
-		runtest.endstate = 0;
-		runtest.mode = JTAG_XFER_SW_MODE;
-		runtest.reset = 0;
-		runtest.tck = 0;
-		ioctl(g_JTAGFile, JTAG_IOCRUNTEST, &runtest);
+		if ( jtag_clock_ready() != 0 ) {
+			printf( "Warning: the JTAG chain did not answer within %d ms.\n", JTAG_READY_TIMEOUT_MS );
+		}
+
+		jtag_backend_run_test( JTAG_STATE_IDLE, 0 );
 	}
 
-	if ( iFullVMEOption ) {
+	if ( jtag_backend_active() && ( szPlayFilename[ 0 ] == '\0' ) && ( jtag_vqueue_start() != OK ) ) {
+		printf( "Error: cannot start the TDO verify thread.\n\n" );
+		jtag_backend_close();
+		DeAllocateCFGMemory();
+		exit( OUT_OF_MEMORY );
+	}
+	if ( jtag_backend_active() && ( szPlayFilename[ 0 ] == '\0' ) && iPipelineDepth &&
+		( jtag_pipe_start( iPipelineDepth ) != OK ) ) {
+		printf( "Error: cannot start the JTAG transport thread.\n\n" );
+		jtag_backend_close();
+		DeAllocateCFGMemory();
+		exit( OUT_OF_MEMORY );
+	}
+
+	if ( szPlayFilename[ 0 ] != '\0' ) {
+		printf( "Play execution plan %s\n", szPlayFilename );
+		iRetCode = jtag_plan_play( szPlayFilename );
+		if ( iRetCode == FILE_NOT_FOUND || iRetCode == FILE_NOT_VALID ) {
+			printf( "Error: execution plan %s cannot be read or is corrupted.\n\n", szPlayFilename );
+		}
+	}
+	else if ( iFullVMEOption ) {
 		if (!g_direct_prog){
 			printf( "Begin generating the full VME file \n(%s)......\n\n", szVMEFilename );
 		}
@@ -3148,7 +3652,34 @@ int main( int argc, char *argv[] )
 		printf( "Begin generating the compressed VME file \n(%s)......\n\n", szVMEFilename );
 		iRetCode = ispsvf_convert( iSVFCount, cfgChain, szVMEFilename, true ); 
 	}
-	close(g_JTAGFile);
+	jtag_pipe_stop();
+	if ( ( jtag_poll_flush() != 0 ) && ( iRetCode >= 0 ) ) {
+		iRetCode = FILE_ERROR;
+	}
+	if ( ( jtag_backend_flush() != 0 ) && ( iRetCode >= 0 ) ) {
+		iRetCode = FILE_ERROR;
+	}
+	jtag_vqueue_stop();
+	if ( g_debug && g_direct_prog ) {
+		jtag_player_print_stats();
+		jtag_poll_print_stats();
+		jtag_vqueue_print_stats();
+		jtag_pipe_print_stats();
+		jtag_wait_print_stats();
+		jtag_backend_print_stats();
+	}
+	if ( jtag_plan_active() ) {
+		if ( iRetCode >= 0 ) {
+			iRetCode = jtag_plan_close();
+		}
+		else {
+			jtag_plan_close();
+		}
+		if ( iRetCode < 0 ) {
+			remove( szPlanFilename );
+		}
+	}
+	jtag_backend_close();
 	/* Free chain memory */
 	DeAllocateCFGMemory();
 
@@ -3183,7 +3714,6 @@ int GetSVFInformation( int * a_piCommandLineIndex, int * a_piCurrentSVFCount, in
 	char szTmp[ 1024 ] = { 0 };
 	char szCommandLineArg[ 1024 ] = { 0 };
 	char szSVFFilename[ 1024 ] = { 0 };
-	FILE * fptrSVFFile = NULL;
 
 	if ( ++*a_piCommandLineIndex >= a_iArgc ) {
 		sprintf( a_szErrorMessage, "Error: missing input file name.\n\n" );
@@ -3197,12 +3727,7 @@ int GetSVFInformation( int * a_piCommandLineIndex, int * a_piCurrentSVFCount, in
 		return ( ERR_COMMAND_LINE_SYNTAX );
 	}
 
-	fptrSVFFile = fopen( szSVFFilename, "r" );
-	if ( fptrSVFFile == NULL ) {
-		sprintf( a_szErrorMessage, "Error: svf file %s cannot be read.\n\n", szSVFFilename );
-		return ( FILE_NOT_VALID );
-	}
-	fclose( fptrSVFFile );
+	/* The file is opened and checked once, by the pre-scan in main() */
 	strcpy( cfgChain[ *a_piCurrentSVFCount ].Svffile, szSVFFilename );
 
 	/* Set default SVF file name, frequency, vendor, and max tck */
@@ -3242,7 +3767,10 @@ int GetSVFInformation( int * a_piCommandLineIndex, int * a_piCurrentSVFCount, in
 			}
 			strcpy( szCommandLineArg, a_cArgv[ *a_piCommandLineIndex ] );
 			strlwr( szCommandLineArg );
-			if ( szCommandLineArg[ strlen( szCommandLineArg ) -1 ] == 'k' || szCommandLineArg[ strlen( szCommandLineArg ) -1 ] == 'm' ) {
+			if ( !strcmp( szCommandLineArg, "auto" ) ) {
+				cfgChain[ *a_piCurrentSVFCount ].Frequency = CLOCK_AUTO;
+			}
+			else if ( szCommandLineArg[ strlen( szCommandLineArg ) -1 ] == 'k' || szCommandLineArg[ strlen( szCommandLineArg ) -1 ] == 'm' ) {
 				for ( iTemp = 0; iTemp < ( signed int ) strlen( szCommandLineArg ) - 1; iTemp++ ) {
 					if ( !isdigit( szCommandLineArg[ iTemp ] ) ) {
 						sprintf( a_szErrorMessage, "Error: %s is an invalid frequency setting.\n\n", szCommandLineArg );
@@ -3445,7 +3973,8 @@ void EncodeCRC( const char * a_pszVMEFilename )
 *
 * LCOUNTCom
 *
-* Convert the SVF LCOUNT command into VME format.
+* Convert the SVF LCOUNT command into VME format. Direct programming
+* starts recording the loop.
 *
 *********************************************************************/
 
@@ -3457,6 +3986,9 @@ void LCOUNTCom()
 	Token( "" );
 	lCount = atol( g_pszSVFString );
 	ConvNumber( lCount );
+	if ( g_direct_prog ) {
+		jtag_poll_loop( lCount );
+	}
 }
 
 /*********************************************************************
@@ -3504,6 +4036,43 @@ void writeIntelProgramData()
 	g_usIntelBufferIndex = 0;
 }
 
+/*********************************************************************
+*
+* MarkLVDSIndex
+*
+* Marks an LVDS index as used. The table of flags grows on demand and
+* the new entries are false. Returns FILE_NOT_VALID if the index was
+* already used.
+*
+*********************************************************************/
+
+static short int MarkLVDSIndex( bool ** a_ppbIndices, long int * a_piSize, long int a_iIndex )
+{
+	bool * pbIndices;
+	long int iNewSize;
+
+	if ( a_iIndex >= *a_piSize ) {
+		iNewSize = *a_piSize * 2;
+		if ( iNewSize <= a_iIndex ) {
+			iNewSize = a_iIndex + 1;
+		}
+
+		pbIndices = ( bool * ) realloc( *a_ppbIndices, iNewSize );
+		if ( pbIndices == NULL ) {
+			return OUT_OF_MEMORY;
+		}
+		memset( &pbIndices[ *a_piSize ], false, iNewSize - *a_piSize );
+		*a_ppbIndices = pbIndices;
+		*a_piSize = iNewSize;
+	}
+
+	if ( ( *a_ppbIndices )[ a_iIndex ] ) {
+		return FILE_NOT_VALID;
+	}
+	( *a_ppbIndices )[ a_iIndex ] = true;
+	return OK;
+}
+
 /*********************************************************************
 *
 * LVDSCom
@@ -3519,7 +4088,7 @@ short int LVDSCom()
 	long int iLVDSIndex = 0;
 	bool bNumberConversion;
 	bool * pbLVDSIndices = NULL;
-	int iMaxSizeIndex = 0;
+	long int iLVDSIndicesSize = 0;
 
 	Token( "(" );
 	
@@ -3538,18 +4107,13 @@ short int LVDSCom()
 
 	/*********************************************************************
 	*
-	* Allocate memory to represent the LVDS indices. By default, initialize
-	* them all to false. Later when reading the LVDS indices, set the
-	* location to true. If the SVF tries to set the location more than
-	* once then report an error.
+	* The LVDS indices are represented by a table of flags, all false by
+	* default. Later when reading the LVDS indices, set the location to
+	* true. The table is allocated by MarkLVDSIndex() as the indices are
+	* read, g_iMaxSize is not known in direct programming mode.
 	*
 	*********************************************************************/
 
-	pbLVDSIndices = (bool*) malloc( g_iMaxSize );
-	for ( iMaxSizeIndex = 0; iMaxSizeIndex < g_iMaxSize; iMaxSizeIndex++ ) {
-		pbLVDSIndices[ iMaxSizeIndex ] = false;
-	}
-
 	/*********************************************************************
 	*
 	* Iterate through the LVDS pairs in the SVF file.
@@ -3578,23 +4142,15 @@ short int LVDSCom()
 
 		/*********************************************************************
 		*
-		* Check to make sure index location is unused.
+		* Set index location to used (true) and write the number to the VME
+		* file. The location must not have been used before.
 		*
 		*********************************************************************/
 
-		if ( pbLVDSIndices[ iLVDSIndex ] ) {
-			siRetCode = FILE_NOT_VALID;
+		siRetCode = MarkLVDSIndex( &pbLVDSIndices, &iLVDSIndicesSize, iLVDSIndex );
+		if ( siRetCode ) {
 			break;
 		}
-
-		/*********************************************************************
-		*
-		* Set index location to used (true) and write the number to the VME
-		* file.
-		*
-		*********************************************************************/
-
-		pbLVDSIndices[ iLVDSIndex ] = true;
 		ConvNumber( iLVDSIndex );
 		
 		if ( iLVDSPairCount > 1 ) {
@@ -3635,23 +4191,15 @@ short int LVDSCom()
 
 		/*********************************************************************
 		*
-		* Check to make sure index location is unused.
+		* Set index location to used (true) and write the number to the VME
+		* file. The location must not have been used before.
 		*
 		*********************************************************************/
 
-		if ( pbLVDSIndices[ iLVDSIndex ] ) {
-			siRetCode = FILE_NOT_VALID;
+		siRetCode = MarkLVDSIndex( &pbLVDSIndices, &iLVDSIndicesSize, iLVDSIndex );
+		if ( siRetCode ) {
 			break;
 		}
-
-		/*********************************************************************
-		*
-		* Set index location to used (true) and write the number to the VME
-		* file.
-		*
-		*********************************************************************/
-
-		pbLVDSIndices[ iLVDSIndex ] = true;
 		ConvNumber( iLVDSIndex );
 	}
 
@@ -10,8 +10,11 @@ typedef struct {
 	unsigned int MaxTCK;            /* Maximum TCK */
 	// Rev. 12.2 Chuo add isMaxTCK flag
 	unsigned char noMaxTCK;			/* Indicates Max TCK is set */
+	struct svf_index *index;		/* Pre-scan of the SVF file */
 } CFG;						/*Chain configuration setup structure*/
 
+#define CLOCK_AUTO	-1	/* -clock auto, TCK tuned in direct mode */
+
 short int ispsvf_convert(int chips, CFG * chain, char *vmefilename, bool compress );
 short int ENDIRCom();
 short int ENDDRCom();
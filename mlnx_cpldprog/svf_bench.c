@@ -0,0 +1,284 @@
+/*
+ * Copyright (c) 2017 Mellanox Technologies. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the names of the copyright holders nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * Alternatively, this software may be distributed under the terms of the
+ * GNU General Public License ("GPL") version 2 as published by the Free
+ * Software Foundation.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Microbenchmarks for the SVF front end. They are built with "make bench"
+ * and are not part of mlnx_cpldprog:
+ *	./svf_bench <file.svf> [passes]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "utilities.h"
+#include "vmopcode.h"
+#include "svf_lexer.h"
+#include "svf_keywords.h"
+
+#define BENCH_DEF_PASSES	1
+
+/* keeps the compiler from dropping results that are otherwise unused */
+static volatile int bench_sink;
+
+struct bench_token {
+	const char *ptr;
+	unsigned int len;
+};
+
+static double bench_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/*
+ * Keyword dispatch as it was done before svf_keyword_lookup(): every token
+ * was compared against the keyword table in order by a stricmp() that
+ * duplicated and lowercased both strings.
+ */
+static const struct {
+	const char *text;
+	int token;
+} legacy_tokens[] = {
+	{ ";", ENDDATA },
+	{ "SIR", SIR }, { "SDR", SDR },
+	{ "TDI", TDI }, { "TDO", TDO }, { "MASK", MASK },
+	{ "STATE", STATE },
+	{ "TCK", TCK, }, { "WAIT", WAIT },
+	{ "XSDR", XSDR }, { "XTDI", XTDI }, { "XTDO", XTDO },
+	{ "ENDDR", ENDDR },
+	{ "ENDIR", ENDIR },
+	{ "HIR", HIR }, { "TIR", TIR }, { "HDR", HDR }, { "TDR", TDR },
+	{ "MEM", MEM },
+	{ "RUNTEST", RUNTEST },
+	{ "ENDSTATE", ENDSTATE },
+	{ "TRST", TRST },
+	{ "FREQUENCY", FREQUENCY },
+	{ "SEC", SEC },
+	{ "SMASK", SMASK },
+	{ "MAXIMUM", MAX },
+	{ "ON", ON }, { "OFF", OFF }, { "ISPEN", ispEN }, { "HIGH", HIGH }, { "LOW", LOW },
+	{ "SETFLOW", SETFLOW }, { "RESETFLOW", RESETFLOW },
+	{ "REPEAT", REPEAT }, { "ENDLOOP", ENDLOOP },
+	{ "(", LEFTPAREN },
+	{ "CRC", CRC },
+	{ "CMASK", CMASK },
+	{ "RMASK", RMASK },
+	{ "READ", READ },
+	{ "DMASK", DMASK },
+	{ "VUES", VUES },
+	{ "LCOUNT", LCOUNT },
+	{ "LDELAY", LDELAY },
+	{ "LSDR", LSDR },
+	{ "LVDS", LVDS },
+	{ "LOOP", LOOP }
+};
+
+#define LEGACY_TOKENS_NUM	(sizeof(legacy_tokens) / sizeof(legacy_tokens[0]))
+
+static int legacy_stricmp(const char *first, const char *second)
+{
+	char *a, *b;
+	int ret;
+
+	a = malloc(strlen(first) + 1);
+	b = malloc(strlen(second) + 1);
+	if (!a || !b) {
+		free(a);
+		free(b);
+		return -1;
+	}
+	strlwr(strcpy(a, first));
+	strlwr(strcpy(b, second));
+	ret = strcmp(a, b);
+	free(a);
+	free(b);
+	return ret;
+}
+
+static int legacy_lookup(const char *text)
+{
+	unsigned int i;
+
+	for (i = 0; i < LEGACY_TOKENS_NUM; i++) {
+		if (legacy_stricmp(legacy_tokens[i].text, text) == 0)
+			return legacy_tokens[i].token;
+	}
+	return SVF_KEYWORD_NONE;
+}
+
+/*
+ * Collect the tokens the converter classifies: command names and the
+ * keywords inside a command. Hex data between parentheses is never looked
+ * up and is left out.
+ */
+static struct bench_token *collect_tokens(svf_lexer_t *lex,
+					  unsigned long *count,
+					  unsigned int *max_len)
+{
+	struct bench_token *tokens = NULL, *tmp;
+	unsigned long num = 0, size = 0;
+	svf_token_t tok;
+	int in_data = 0;
+	int rc;
+
+	*max_len = 0;
+	while ((rc = svf_lexer_next(lex, " ", &tok)) == 0) {
+		if (in_data) {
+			if (memchr(tok.ptr, ')', tok.len))
+				in_data = 0;
+			continue;
+		}
+		if (tok.len == 1 && tok.ptr[0] == '(') {
+			in_data = 1;
+			continue;
+		}
+		if (num == size) {
+			size = size ? size * 2 : 4096;
+			tmp = realloc(tokens, size * sizeof(*tokens));
+			if (!tmp) {
+				free(tokens);
+				return NULL;
+			}
+			tokens = tmp;
+		}
+		tokens[num].ptr = tok.ptr;
+		tokens[num].len = tok.len;
+		if (tok.len > *max_len)
+			*max_len = tok.len;
+		num++;
+	}
+	if (rc != 1) {
+		free(tokens);
+		return NULL;
+	}
+
+	*count = num;
+	return tokens;
+}
+
+static int bench_keywords(svf_lexer_t *lex, int passes)
+{
+	struct bench_token *tokens;
+	unsigned long count, i, matched = 0;
+	unsigned int max_len;
+	double start, legacy, lookup;
+	char *buf;
+	int pass;
+
+	tokens = collect_tokens(lex, &count, &max_len);
+	if (!tokens) {
+		fprintf(stderr, "keywords: failed to tokenize the file\n");
+		return FILE_ERROR;
+	}
+
+	buf = malloc(max_len + 1);
+	if (!buf) {
+		free(tokens);
+		return OUT_OF_MEMORY;
+	}
+
+	/* both classifiers must agree on every token */
+	for (i = 0; i < count; i++) {
+		memcpy(buf, tokens[i].ptr, tokens[i].len);
+		buf[tokens[i].len] = '\0';
+		if (legacy_lookup(buf) != svf_keyword_lookup(tokens[i].ptr,
+							     tokens[i].len)) {
+			fprintf(stderr, "keywords: mismatch on \"%s\"\n", buf);
+			free(buf);
+			free(tokens);
+			return FILE_ERROR;
+		}
+	}
+
+	/* the legacy path also had to copy every token out of the line */
+	start = bench_now();
+	for (pass = 0; pass < passes; pass++) {
+		for (i = 0; i < count; i++) {
+			memcpy(buf, tokens[i].ptr, tokens[i].len);
+			buf[tokens[i].len] = '\0';
+			bench_sink += legacy_lookup(buf);
+		}
+	}
+	legacy = bench_now() - start;
+
+	start = bench_now();
+	for (pass = 0; pass < passes; pass++) {
+		for (i = 0; i < count; i++) {
+			if (svf_keyword_lookup(tokens[i].ptr, tokens[i].len) !=
+			    SVF_KEYWORD_NONE)
+				matched++;
+		}
+	}
+	lookup = bench_now() - start;
+
+	printf("keywords: %lu tokens, %lu keywords per pass, %d passes\n",
+	       count, matched / passes, passes);
+	printf("  stricmp scan:   %10.3f s %12.0f tokens/s\n",
+	       legacy, count * (double)passes / legacy);
+	printf("  keyword switch: %10.3f s %12.0f tokens/s (x%.1f)\n",
+	       lookup, count * (double)passes / lookup, legacy / lookup);
+
+	free(buf);
+	free(tokens);
+	return OK;
+}
+
+int main(int argc, char *argv[])
+{
+	svf_lexer_t lex;
+	int passes = BENCH_DEF_PASSES;
+	int rc;
+
+	if (argc < 2) {
+		fprintf(stderr, "usage: %s <file.svf> [passes]\n", argv[0]);
+		return ERR_COMMAND_LINE_SYNTAX;
+	}
+	if (argc > 2)
+		passes = atoi(argv[2]);
+	if (passes <= 0)
+		passes = BENCH_DEF_PASSES;
+
+	rc = svf_lexer_open(&lex, argv[1]);
+	if (rc != OK) {
+		fprintf(stderr, "failed to open %s\n", argv[1]);
+		return rc;
+	}
+
+	rc = bench_keywords(&lex, passes);
+
+	svf_lexer_close(&lex);
+	return rc;
+}
@@ -0,0 +1,81 @@
+/*
+ * Copyright (c) 2017 Mellanox Technologies. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the names of the copyright holders nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * Alternatively, this software may be distributed under the terms of the
+ * GNU General Public License ("GPL") version 2 as published by the Free
+ * Software Foundation.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "svf_hex.h"
+
+/* value of a hex digit, -1 for any other character */
+static const signed char svf_hex_value[256] = {
+	[0 ... 255] = -1,
+	['0'] = 0, ['1'] = 1, ['2'] = 2, ['3'] = 3, ['4'] = 4,
+	['5'] = 5, ['6'] = 6, ['7'] = 7, ['8'] = 8, ['9'] = 9,
+	['a'] = 10, ['b'] = 11, ['c'] = 12, ['d'] = 13, ['e'] = 14, ['f'] = 15,
+	['A'] = 10, ['B'] = 11, ['C'] = 12, ['D'] = 13, ['E'] = 14, ['F'] = 15,
+};
+
+void svf_hex_reader_init(svf_hex_reader_t *rd, const svf_hex_span_t *span)
+{
+	rd->begin = span->begin;
+	rd->cur = span->end;
+}
+
+static inline unsigned char svf_hex_prev(svf_hex_reader_t *rd)
+{
+	signed char v;
+
+	while (rd->cur > rd->begin) {
+		v = svf_hex_value[(unsigned char)*--rd->cur];
+		if (v >= 0)
+			return v;
+	}
+	return 0;
+}
+
+/*
+ * Store the next bits bits of the span LSB-first in out. bits must be a
+ * multiple of 4 except for the last chunk of a scan, unused bits of the
+ * last byte are cleared.
+ */
+void svf_hex_read(svf_hex_reader_t *rd, unsigned char *out, unsigned long bits)
+{
+	unsigned long i;
+
+	for (i = 0; i + 8 <= bits; i += 8, out++) {
+		*out = svf_hex_prev(rd);
+		*out |= svf_hex_prev(rd) << 4;
+	}
+	if (bits % 8) {
+		*out = svf_hex_prev(rd);
+		if (bits % 8 > 4)
+			*out |= svf_hex_prev(rd) << 4;
+		*out &= (1 << (bits % 8)) - 1;
+	}
+}
@@ -0,0 +1,59 @@
+/*
+ * Copyright (c) 2017 Mellanox Technologies. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the names of the copyright holders nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * Alternatively, this software may be distributed under the terms of the
+ * GNU General Public License ("GPL") version 2 as published by the Free
+ * Software Foundation.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __SVF_HEX_H__
+#define __SVF_HEX_H__
+
+/*
+ * Hex data of an SVF scan as found in the mapped file: the text between
+ * '(' and ')', which may span several lines. The last hex digit holds the
+ * bits that are shifted first.
+ */
+typedef struct {
+	const char *begin;
+	const char *end;	/* the closing ')' */
+} svf_hex_span_t;
+
+/*
+ * Decodes a span back to front, a chunk of bits at a time, so a scan can
+ * be shifted without converting all of its data first. Characters other
+ * than hex digits are skipped, missing leading digits read as zeros.
+ */
+typedef struct {
+	const char *begin;
+	const char *cur;
+} svf_hex_reader_t;
+
+void svf_hex_reader_init(svf_hex_reader_t *rd, const svf_hex_span_t *span);
+void svf_hex_read(svf_hex_reader_t *rd, unsigned char *out, unsigned long bits);
+
+#endif /*__SVF_HEX_H__*/
@@ -0,0 +1,159 @@
+/*
+ * Copyright (c) 2017 Mellanox Technologies. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the names of the copyright holders nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * Alternatively, this software may be distributed under the terms of the
+ * GNU General Public License ("GPL") version 2 as published by the Free
+ * Software Foundation.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "vmopcode.h"
+#include "utilities.h"
+#include "svf_lexer.h"
+#include "svf_keywords.h"
+#include "svf_index.h"
+
+#define SVF_INDEX_NUM_LEN	32
+
+/* copy a numeric token out of the mapping so it can be converted */
+static double svf_index_number(const svf_token_t *tok)
+{
+	char buf[SVF_INDEX_NUM_LEN];
+	unsigned int len = tok->len;
+
+	if (len >= sizeof(buf))
+		len = sizeof(buf) - 1;
+	memcpy(buf, tok->ptr, len);
+	buf[len] = '\0';
+	return strtod(buf, NULL);
+}
+
+/*
+ * Walk the arguments of a command up to the terminating ';'. Hex data in
+ * parentheses is skipped without being tokenized. The length of a scan
+ * is taken on the way.
+ */
+static int svf_index_args(svf_index_t *index, int opcode)
+{
+	svf_lexer_t *lex = &index->lex;
+	svf_token_t tok;
+	long value;
+	int first = 1;
+	int rc;
+
+	while ((rc = svf_lexer_next(lex, " ", &tok)) == 0) {
+		if (tok.len == 1 && tok.ptr[0] == ';')
+			return 0;
+		if (tok.len == 1 && tok.ptr[0] == '(') {
+			rc = svf_lexer_skip_past(lex, ')');
+			if (rc)
+				return rc;
+			continue;
+		}
+
+		if (first && (opcode == SIR || opcode == SDR)) {
+			value = (long)svf_index_number(&tok);
+			if (opcode == SIR && index->ir_len < 0)
+				index->ir_len = (int)value;
+			if (value > index->max_scan)
+				index->max_scan = value;
+		}
+		first = 0;
+	}
+	return rc;
+}
+
+/*
+ * Map an SVF file. The index is empty until svf_index_scan() fills it, the
+ * mapping can be used by the converter right away.
+ */
+int svf_index_open(svf_index_t **index, const char *path)
+{
+	svf_index_t *idx;
+	int rc;
+
+	idx = calloc(1, sizeof(*idx));
+	if (!idx)
+		return OUT_OF_MEMORY;
+
+	rc = svf_lexer_open(&idx->lex, path);
+	if (rc != OK) {
+		free(idx);
+		return rc;
+	}
+
+	idx->ir_len = -1;
+	*index = idx;
+	return OK;
+}
+
+/*
+ * Index the file in a single pass. With SVF_INDEX_IR_ONLY the pass stops
+ * at the first SIR and only the IR length is known afterwards. The lexer
+ * is rewound in both cases.
+ */
+int svf_index_scan(svf_index_t *index, int flags)
+{
+	svf_token_t tok;
+	int opcode;
+	int rc;
+
+	while ((rc = svf_lexer_next(&index->lex, " ", &tok)) == 0) {
+		opcode = svf_keyword_lookup(tok.ptr, tok.len);
+
+		/* stray separators between commands */
+		if (opcode == ENDDATA)
+			continue;
+
+		rc = svf_index_args(index, opcode);
+		if (rc)
+			break;
+
+		if ((flags & SVF_INDEX_IR_ONLY) && index->ir_len >= 0)
+			break;
+	}
+
+	svf_lexer_rewind(&index->lex);
+	return rc < 0 ? rc : OK;
+}
+
+void svf_index_free(svf_index_t *index)
+{
+	if (!index)
+		return;
+	svf_lexer_close(&index->lex);
+	free(index);
+}
+
+void svf_index_print(const svf_index_t *index, const char *path)
+{
+	printf("SVF index of %s:\n", path);
+	printf("  size %lu bytes, IR length %d, max scan %ld bits\n",
+	       index->lex.size, index->ir_len, index->max_scan);
+}
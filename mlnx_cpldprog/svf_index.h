@@ -0,0 +1,58 @@
+/*
+ * Copyright (c) 2017 Mellanox Technologies. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the names of the copyright holders nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * Alternatively, this software may be distributed under the terms of the
+ * GNU General Public License ("GPL") version 2 as published by the Free
+ * Software Foundation.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __SVF_INDEX_H__
+#define __SVF_INDEX_H__
+
+#include "svf_lexer.h"
+
+/* svf_index_scan() flags */
+#define SVF_INDEX_IR_ONLY	0x01	/* stop at the first SIR */
+
+/*
+ * Metadata collected by a single pass over an SVF file. The index owns the
+ * mapping of the file, the converter rewinds and reuses it instead of
+ * reading the file again. In direct programming mode the pass is skipped
+ * or cut short, so only ir_len may be valid.
+ */
+typedef struct svf_index {
+	svf_lexer_t lex;
+	int ir_len;			/* length of the first SIR, -1 if none */
+	long max_scan;			/* longest SIR/SDR in bits */
+} svf_index_t;
+
+int svf_index_open(svf_index_t **index, const char *path);
+int svf_index_scan(svf_index_t *index, int flags);
+void svf_index_free(svf_index_t *index);
+void svf_index_print(const svf_index_t *index, const char *path);
+
+#endif /*__SVF_INDEX_H__*/
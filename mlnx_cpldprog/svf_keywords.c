@@ -0,0 +1,269 @@
+/*
+ * Copyright (c) 2017 Mellanox Technologies. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the names of the copyright holders nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * Alternatively, this software may be distributed under the terms of the
+ * GNU General Public License ("GPL") version 2 as published by the Free
+ * Software Foundation.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "vmopcode.h"
+#include "svf_keywords.h"
+
+/*
+ * Supported SVF keywords. This is the only keyword table in the program,
+ * both the SVF converter and the JTAG handlers use it.
+ */
+static const struct svf_keyword {
+	const char *text;
+	int token;
+} svf_keywords[] = {
+	{ ";", ENDDATA },
+	{ "SIR", SIR }, { "SDR", SDR },
+	{ "TDI", TDI }, { "TDO", TDO }, { "MASK", MASK },
+	{ "STATE", STATE },
+	{ "TCK", TCK, }, { "WAIT", WAIT },
+	{ "XSDR", XSDR }, { "XTDI", XTDI }, { "XTDO", XTDO },
+	{ "ENDDR", ENDDR },
+	{ "ENDIR", ENDIR },
+	{ "HIR", HIR }, { "TIR", TIR }, { "HDR", HDR }, { "TDR", TDR },
+	{ "MEM", MEM },
+	{ "RUNTEST", RUNTEST },
+	{ "ENDSTATE", ENDSTATE },
+	{ "TRST", TRST },
+	{ "FREQUENCY", FREQUENCY },
+	{ "SEC", SEC },
+	{ "SMASK", SMASK },
+	{ "MAXIMUM", MAX },
+	{ "ON", ON }, { "OFF", OFF }, { "ISPEN", ispEN }, { "HIGH", HIGH }, { "LOW", LOW },
+	{ "SETFLOW", SETFLOW }, { "RESETFLOW", RESETFLOW },
+	{ "REPEAT", REPEAT }, { "ENDLOOP", ENDLOOP },
+	{ "(", LEFTPAREN },
+	{ "CRC", CRC },
+	{ "CMASK", CMASK },
+	{ "RMASK", RMASK },
+	{ "READ", READ },
+	{ "DMASK", DMASK },
+	{ "VUES", VUES },
+	{ "LCOUNT", LCOUNT },
+	{ "LDELAY", LDELAY },
+	{ "LSDR", LSDR },
+	{ "LVDS", LVDS },
+	{ "LOOP", LOOP }
+};
+
+#define SVF_KEYWORDS_NUM	(sizeof(svf_keywords) / sizeof(svf_keywords[0]))
+
+/*
+ * Upper case for ASCII letters. Keywords consist of letters only, so
+ * clearing bit 5 never makes a non-letter compare equal to a keyword.
+ */
+#define SVF_KW_UPPER(c)	((unsigned char)(c) & ~0x20)
+
+/* compare the remaining characters of a keyword, the first one is known */
+static int svf_kw_tail(const char *text, const char *kw, unsigned int len)
+{
+	unsigned int i;
+
+	for (i = 1; i < len; i++) {
+		if (SVF_KW_UPPER(text[i]) != (unsigned char)kw[i])
+			return 0;
+	}
+	return 1;
+}
+
+#define SVF_KW(kw, token)					\
+	do {							\
+		if (svf_kw_tail(text, kw, len))			\
+			return token;				\
+	} while (0)
+
+/*
+ * Classify a token as an SVF keyword. The token does not have to be
+ * null terminated and is matched case insensitively. The candidates are
+ * selected by a switch on the token length and on its first character,
+ * so only a few keywords are ever compared and nothing is allocated.
+ * Returns the VME opcode of the keyword or SVF_KEYWORD_NONE.
+ */
+int svf_keyword_lookup(const char *text, unsigned int len)
+{
+	if (len == 1) {
+		if (text[0] == ';')
+			return ENDDATA;
+		if (text[0] == '(')
+			return LEFTPAREN;
+		return SVF_KEYWORD_NONE;
+	}
+
+	switch (len) {
+	case 2:
+		if (SVF_KW_UPPER(text[0]) == 'O')
+			SVF_KW("ON", ON);
+		break;
+	case 3:
+		switch (SVF_KW_UPPER(text[0])) {
+		case 'S':
+			SVF_KW("SIR", SIR);
+			SVF_KW("SDR", SDR);
+			SVF_KW("SEC", SEC);
+			break;
+		case 'T':
+			SVF_KW("TDI", TDI);
+			SVF_KW("TDO", TDO);
+			SVF_KW("TCK", TCK);
+			SVF_KW("TIR", TIR);
+			SVF_KW("TDR", TDR);
+			break;
+		case 'H':
+			SVF_KW("HIR", HIR);
+			SVF_KW("HDR", HDR);
+			break;
+		case 'M':
+			SVF_KW("MEM", MEM);
+			break;
+		case 'O':
+			SVF_KW("OFF", OFF);
+			break;
+		case 'L':
+			SVF_KW("LOW", LOW);
+			break;
+		case 'C':
+			SVF_KW("CRC", CRC);
+			break;
+		}
+		break;
+	case 4:
+		switch (SVF_KW_UPPER(text[0])) {
+		case 'M':
+			SVF_KW("MASK", MASK);
+			break;
+		case 'W':
+			SVF_KW("WAIT", WAIT);
+			break;
+		case 'X':
+			SVF_KW("XSDR", XSDR);
+			SVF_KW("XTDI", XTDI);
+			SVF_KW("XTDO", XTDO);
+			break;
+		case 'T':
+			SVF_KW("TRST", TRST);
+			break;
+		case 'H':
+			SVF_KW("HIGH", HIGH);
+			break;
+		case 'R':
+			SVF_KW("READ", READ);
+			break;
+		case 'V':
+			SVF_KW("VUES", VUES);
+			break;
+		case 'L':
+			SVF_KW("LSDR", LSDR);
+			SVF_KW("LVDS", LVDS);
+			SVF_KW("LOOP", LOOP);
+			break;
+		}
+		break;
+	case 5:
+		switch (SVF_KW_UPPER(text[0])) {
+		case 'S':
+			SVF_KW("STATE", STATE);
+			SVF_KW("SMASK", SMASK);
+			break;
+		case 'E':
+			SVF_KW("ENDDR", ENDDR);
+			SVF_KW("ENDIR", ENDIR);
+			break;
+		case 'I':
+			SVF_KW("ISPEN", ispEN);
+			break;
+		case 'C':
+			SVF_KW("CMASK", CMASK);
+			break;
+		case 'R':
+			SVF_KW("RMASK", RMASK);
+			break;
+		case 'D':
+			SVF_KW("DMASK", DMASK);
+			break;
+		}
+		break;
+	case 6:
+		switch (SVF_KW_UPPER(text[0])) {
+		case 'R':
+			SVF_KW("REPEAT", REPEAT);
+			break;
+		case 'L':
+			SVF_KW("LCOUNT", LCOUNT);
+			SVF_KW("LDELAY", LDELAY);
+			break;
+		}
+		break;
+	case 7:
+		switch (SVF_KW_UPPER(text[0])) {
+		case 'R':
+			SVF_KW("RUNTEST", RUNTEST);
+			break;
+		case 'S':
+			SVF_KW("SETFLOW", SETFLOW);
+			break;
+		case 'E':
+			SVF_KW("ENDLOOP", ENDLOOP);
+			break;
+		case 'M':
+			SVF_KW("MAXIMUM", MAX);
+			break;
+		}
+		break;
+	case 8:
+		if (SVF_KW_UPPER(text[0]) == 'E')
+			SVF_KW("ENDSTATE", ENDSTATE);
+		break;
+	case 9:
+		switch (SVF_KW_UPPER(text[0])) {
+		case 'F':
+			SVF_KW("FREQUENCY", FREQUENCY);
+			break;
+		case 'R':
+			SVF_KW("RESETFLOW", RESETFLOW);
+			break;
+		}
+		break;
+	}
+
+	return SVF_KEYWORD_NONE;
+}
+
+const char *svf_keyword_name(int token)
+{
+	unsigned int i;
+
+	for (i = 0; i < SVF_KEYWORDS_NUM; i++) {
+		if (svf_keywords[i].token == token)
+			return svf_keywords[i].text;
+	}
+	return "Unknown Token";
+}
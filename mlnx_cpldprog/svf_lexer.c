@@ -0,0 +1,266 @@
+/*
+ * Copyright (c) 2017 Mellanox Technologies. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the names of the copyright holders nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * Alternatively, this software may be distributed under the terms of the
+ * GNU General Public License ("GPL") version 2 as published by the Free
+ * Software Foundation.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "utilities.h"
+#include "svf_lexer.h"
+
+/*
+ * The lexer walks a read-only mapping of the SVF file and hands out tokens
+ * as (pointer, length) pairs. It keeps the splitting rules of the former
+ * fgets()/strtok() based Token():
+ *  - TAB and CR are treated as blanks;
+ *  - ';', '(' and ')' are tokens of their own whenever blank is a delimiter;
+ *  - '!' and '//' start a comment that runs up to the end of line;
+ *  - a single '/' is a syntax error.
+ * Tokens never cross a line boundary.
+ */
+
+#define SVF_CH_BLANK(c)		((c) == ' ' || (c) == '\t' || (c) == '\r')
+#define SVF_CH_SPECIAL(c)	((c) == ';' || (c) == '(' || (c) == ')')
+
+int svf_lexer_open(svf_lexer_t *lex, const char *path)
+{
+	struct stat st;
+	void *map;
+	int fd;
+
+	memset(lex, 0, sizeof(*lex));
+	lex->line = 1;
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return FILE_NOT_FOUND;
+
+	if (fstat(fd, &st) < 0) {
+		close(fd);
+		return FILE_NOT_VALID;
+	}
+
+	if (st.st_size > 0) {
+		map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (map == MAP_FAILED) {
+			close(fd);
+			return FILE_NOT_VALID;
+		}
+		/* the file is consumed front to back, let the kernel read ahead */
+		madvise(map, st.st_size, MADV_SEQUENTIAL);
+		lex->base = map;
+		lex->size = st.st_size;
+	}
+
+	/* the mapping stays valid after the descriptor is closed */
+	close(fd);
+	return OK;
+}
+
+void svf_lexer_close(svf_lexer_t *lex)
+{
+	if (lex->base)
+		munmap((void *)lex->base, lex->size);
+	memset(lex, 0, sizeof(*lex));
+}
+
+void svf_lexer_rewind(svf_lexer_t *lex)
+{
+	lex->pos = 0;
+	lex->line = 1;
+	lex->comment_end = 0;
+}
+
+/*
+ * Hand the comment of the line at pos to comment_cb before any token of
+ * the line, the former Token() wrote it to the VME file as soon as it
+ * read the line.
+ */
+static void svf_lexer_line_comment(svf_lexer_t *lex, unsigned long pos)
+{
+	const char *base = lex->base;
+	const char *eol;
+	unsigned long end;
+
+	eol = memchr(base + pos, '\n', lex->size - pos);
+	end = eol ? (unsigned long)(eol - base) : lex->size;
+	lex->comment_end = end + 1;
+
+	for (; pos < end; pos++) {
+		if (base[pos] == '!' ||
+		    (base[pos] == '/' && pos + 1 < end && base[pos + 1] == '/')) {
+			lex->comment_cb(base + pos, end - pos);
+			return;
+		}
+	}
+}
+
+static void svf_lexer_set_delims(svf_lexer_t *lex, const char *delims)
+{
+	const unsigned char *p;
+
+	if (lex->delims == delims)
+		return;
+
+	memset(lex->delim_tbl, 0, sizeof(lex->delim_tbl));
+	for (p = (const unsigned char *)delims; *p; p++)
+		lex->delim_tbl[*p] = 1;
+
+	/* TAB and CR are handled as blanks */
+	if (lex->delim_tbl[' ']) {
+		lex->delim_tbl['\t'] = 1;
+		lex->delim_tbl['\r'] = 1;
+	}
+	/* a token never runs past the end of line */
+	lex->delim_tbl['\n'] = 0;
+	lex->delims = delims;
+}
+
+/*
+ * Fetch the next token separated by any of the characters in delims.
+ * Returns 0 when a token was found, 1 at the end of file or FILE_ERROR
+ * for malformed input.
+ */
+int svf_lexer_next(svf_lexer_t *lex, const char *delims, svf_token_t *tok)
+{
+	const char *base = lex->base;
+	unsigned long size = lex->size;
+	unsigned long pos = lex->pos;
+	unsigned long start;
+	const char *eol;
+	char blank_delim;
+	char c;
+
+	svf_lexer_set_delims(lex, delims);
+	blank_delim = lex->delim_tbl[' '];
+
+	for (;;) {
+		if (pos >= size) {
+			lex->pos = pos;
+			tok->ptr = base + pos;
+			tok->len = 0;
+			tok->offset = pos;
+			tok->line = lex->line;
+			return 1;
+		}
+
+		if (lex->comment_cb && pos >= lex->comment_end)
+			svf_lexer_line_comment(lex, pos);
+
+		c = base[pos];
+		if (c == '\n') {
+			lex->line++;
+			pos++;
+			continue;
+		}
+
+		if (c == '/' && (pos + 1 >= size || base[pos + 1] != '/')) {
+			lex->pos = pos;
+			return FILE_ERROR;
+		}
+
+		if (c == '!' || c == '/') {
+			eol = memchr(base + pos, '\n', size - pos);
+			pos = eol ? (unsigned long)(eol - base) : size;
+			continue;
+		}
+
+		if (lex->delim_tbl[(unsigned char)c] || SVF_CH_BLANK(c)) {
+			pos++;
+			continue;
+		}
+		break;
+	}
+
+	start = pos;
+	if (blank_delim && SVF_CH_SPECIAL(c)) {
+		pos++;
+	} else {
+		while (pos < size) {
+			c = base[pos];
+			if (c == '\n' || c == '!' || lex->delim_tbl[(unsigned char)c])
+				break;
+			if (blank_delim && SVF_CH_SPECIAL(c))
+				break;
+			if (c == '/') {
+				if (pos + 1 < size && base[pos + 1] == '/')
+					break;
+				lex->pos = pos;
+				return FILE_ERROR;
+			}
+			pos++;
+		}
+	}
+	lex->pos = pos;
+
+	/* without blank in the delimiter set the token may end with blanks */
+	while (pos > start && SVF_CH_BLANK(base[pos - 1]))
+		pos--;
+
+	tok->ptr = base + start;
+	tok->len = pos - start;
+	tok->offset = start;
+	tok->line = lex->line;
+	return 0;
+}
+
+/*
+ * Skip everything up to and including the next 'c', e.g. the hex data of
+ * a scan up to its closing parenthesis. Comments are not recognized in the
+ * skipped text. Returns 0 or 1 when the end of file was reached first.
+ */
+int svf_lexer_skip_past(svf_lexer_t *lex, char c)
+{
+	const char *base = lex->base;
+	const char *end, *nl;
+	unsigned long pos = lex->pos;
+
+	if (pos >= lex->size)
+		return 1;
+
+	end = memchr(base + pos, c, lex->size - pos);
+
+	/* keep the line number in sync with the skipped text */
+	nl = base + pos;
+	while ((nl = memchr(nl, '\n', (end ? end : base + lex->size) - nl))) {
+		lex->line++;
+		nl++;
+	}
+
+	if (!end) {
+		lex->pos = lex->size;
+		return 1;
+	}
+	lex->pos = end - base + 1;
+	return 0;
+}
@@ -0,0 +1,72 @@
+/*
+ * Copyright (c) 2017 Mellanox Technologies. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the names of the copyright holders nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * Alternatively, this software may be distributed under the terms of the
+ * GNU General Public License ("GPL") version 2 as published by the Free
+ * Software Foundation.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __SVF_LEXER_H__
+#define __SVF_LEXER_H__
+
+/*
+ * Token returned by the lexer. The token points straight into the mapped
+ * SVF file and is NOT null terminated.
+ */
+typedef struct {
+	const char *ptr;
+	unsigned int len;
+	unsigned long offset;	/* byte offset of the token in the file */
+	unsigned int line;	/* 1-based line number of the token */
+} svf_token_t;
+
+typedef void (*svf_comment_cb_t)(const char *text, unsigned int len);
+
+typedef struct {
+	const char *base;	/* read-only mapping of the whole file */
+	unsigned long size;
+	unsigned long pos;
+	unsigned int line;
+
+	/*
+	 * called with the '!' or '//' comment of a line, up to the end of
+	 * line, before the first token of the line is returned
+	 */
+	svf_comment_cb_t comment_cb;
+	unsigned long comment_end;	/* the lines before were looked at */
+
+	const char *delims;	/* delimiter set the table was built for */
+	unsigned char delim_tbl[256];
+} svf_lexer_t;
+
+int svf_lexer_open(svf_lexer_t *lex, const char *path);
+void svf_lexer_close(svf_lexer_t *lex);
+void svf_lexer_rewind(svf_lexer_t *lex);
+int svf_lexer_next(svf_lexer_t *lex, const char *delims, svf_token_t *tok);
+int svf_lexer_skip_past(svf_lexer_t *lex, char c);
+
+#endif /*__SVF_LEXER_H__*/
@@ -6,33 +6,20 @@
 
 int stricmp( const char * a_szFirst, const char * a_szSecond )
 {
-	int iRetCode;
-	char * pszFirst = NULL;
-	char * pszSecond = NULL;
+	int iFirst;
+	int iSecond;
 
 	if ( !a_szFirst || !a_szSecond ) {
 		return -1;
 	}
 
-	pszFirst = ( char * ) malloc( strlen( a_szFirst ) + 1 );
-	pszSecond = ( char * ) malloc( strlen( a_szSecond ) + 1 );
-	
-	if ( !pszFirst || !pszSecond ) {
-		return -1;
-	}
-
-	strcpy( pszFirst, a_szFirst );
-	strcpy( pszSecond, a_szSecond );
-	strlwr( pszFirst );
-	strlwr( pszSecond );
-
-	iRetCode = strcmp( pszFirst, pszSecond );
+	/* Compare in place, the strings are neither copied nor modified. */
+	do {
+		iFirst = tolower( ( unsigned char ) *a_szFirst++ );
+		iSecond = tolower( ( unsigned char ) *a_szSecond++ );
+	} while ( ( iFirst == iSecond ) && ( iFirst != '\0' ) );
 
-	free( pszFirst );
-	free( pszSecond );
-	pszFirst = NULL;
-	pszSecond = NULL;
-	return ( iRetCode );
+	return ( iFirst - iSecond );
 }
 
 char * strlwr( char * a_pszString )
@@ -26,5 +26,6 @@ unsigned char reverse_bits(unsigned char n);
 #define		FILE_NOT_VALID             -9
 #define		FILE_ERROR                -18
 #define		ERR_COMMAND_LINE_SYNTAX	  -20
+#define		VERIFY_FAILURE            -21
 
 #endif /*__UTILITIES_H__*/